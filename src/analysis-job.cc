@@ -0,0 +1,287 @@
+/*
+ * analysis-job.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+
+#include "analysis-job.h"
+#include "GRefPtr.h"
+#include "task.h"
+
+namespace SC {
+
+struct AnalysisJob::Priv {
+    std::tr1::shared_ptr<Repository> repository;
+    std::tr1::shared_ptr<Analysis> analysis;
+    GThreadPool* pool;
+    volatile gint cancelled;
+    bool running;
+    guint done;
+    guint total;
+    sigc::signal<void, guint, guint> signal_progress;
+    sigc::signal<void> signal_finished;
+
+    Priv(const std::tr1::shared_ptr<Repository>& repository,
+         const std::tr1::shared_ptr<Analysis>& analysis);
+    ~Priv();
+
+    void finish();
+};
+
+// a recording that waits for, or is being processed by, the thread pool
+struct WorkItem {
+    std::tr1::shared_ptr<AnalysisJob::Priv> job;
+    gint64 recording_id;
+    std::string path;
+    AnalysisResult* result;
+
+    WorkItem(const std::tr1::shared_ptr<AnalysisJob::Priv>& job,
+             gint64 recording_id,
+             const std::string& path)
+        : job(job)
+        , recording_id(recording_id)
+        , path(path)
+        , result(0)
+    {
+    }
+
+    ~WorkItem()
+    {
+        delete result;
+    }
+};
+
+struct PendingTask : public Task {
+    std::tr1::shared_ptr<AnalysisJob::Priv> job;
+    std::vector<std::pair<gint64, std::string> > pending;
+
+    PendingTask(const std::tr1::shared_ptr<AnalysisJob::Priv>& job,
+                const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , job(job)
+    {
+    }
+};
+
+// runs in the main thread
+static gboolean item_done_proxy(gpointer user_data)
+{
+    WorkItem* item = reinterpret_cast<WorkItem*>(user_data);
+    std::tr1::shared_ptr<AnalysisJob::Priv> job = item->job;
+    delete item;
+
+    job->done++;
+    job->signal_progress.emit(job->done, job->total);
+    if (job->done == job->total)
+        job->finish();
+    return G_SOURCE_REMOVE;
+}
+
+static bool store_run(GomAdapter* adapter, WorkItem* item, GError** error)
+{
+    const Analysis& analysis = *item->job->analysis;
+    if (!analysis.store(adapter, item->recording_id, item->result, error))
+        return false;
+
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "INSERT OR REPLACE INTO \"analysis_runs\" "
+                            "(\"recording_id\", \"analysis\", \"version\") VALUES (?, ?, ?)",
+                     NULL)));
+    gom_command_set_param_int64(command.get(), 0, item->recording_id);
+    gom_command_set_param_string(command.get(), 1, analysis.name());
+    gom_command_set_param_int(command.get(), 2, analysis.version());
+    return gom_command_execute(command.get(), NULL, error);
+}
+
+// runs in the adapter thread
+static void store_result_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    WorkItem* item = reinterpret_cast<WorkItem*>(user_data);
+    GError* error = 0;
+    bool stored = true;
+    if (!gom_adapter_execute_sql(adapter, "BEGIN", &error)
+        || !store_run(adapter, item, &error)
+        || !gom_adapter_execute_sql(adapter, "COMMIT", &error)) {
+        gom_adapter_execute_sql(adapter, "ROLLBACK", NULL);
+        g_warning("Unable to store %s results for recording %" G_GINT64_FORMAT ": %s",
+                  item->job->analysis->name(), item->recording_id, error->message);
+        g_error_free(error);
+        stored = false;
+    }
+    item->job->analysis->finish(item->result, stored);
+    g_main_context_invoke(NULL, item_done_proxy, item);
+}
+
+// runs in a pool thread
+static void analyze_item(gpointer data, gpointer user_data)
+{
+    WorkItem* item = reinterpret_cast<WorkItem*>(data);
+    if (g_atomic_int_get(&item->job->cancelled)) {
+        g_main_context_invoke(NULL, item_done_proxy, item);
+        return;
+    }
+
+    GError* error = 0;
+    item->result = item->job->analysis->analyze(item->path, &error);
+    if (!item->result) {
+        // not recorded as a run, so it is retried the next time
+        g_warning("Unable to analyze '%s': %s", item->path.c_str(), error->message);
+        g_error_free(error);
+        g_main_context_invoke(NULL, item_done_proxy, item);
+        return;
+    }
+
+    GomAdapter* adapter = gom_repository_get_adapter(item->job->repository->cobj());
+    gom_adapter_queue_write(adapter, store_result_proxy, item);
+}
+
+// runs in the adapter thread
+static void query_pending_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    PendingTask* task = reinterpret_cast<PendingTask*>(user_data);
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "SELECT \"recordings\".\"id\", \"recordings\".\"file\" "
+                            "FROM \"recordings\" LEFT JOIN \"analysis_runs\" "
+                            "ON \"analysis_runs\".\"recording_id\" = \"recordings\".\"id\" "
+                            "AND \"analysis_runs\".\"analysis\" = ? "
+                            "WHERE \"analysis_runs\".\"version\" IS NULL "
+                            "OR \"analysis_runs\".\"version\" < ?",
+                     NULL)));
+    gom_command_set_param_string(command.get(), 0, task->job->analysis->name());
+    gom_command_set_param_int(command.get(), 1, task->job->analysis->version());
+
+    GomCursor* cursor = 0;
+    GError* error = 0;
+    if (!gom_command_execute(command.get(), &cursor, &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    while (gom_cursor_next(cursor)) {
+        const gchar* file = gom_cursor_get_column_string(cursor, 1);
+        if (file)
+            task->pending.push_back(std::make_pair(gom_cursor_get_column_int64(cursor, 0),
+                                                   std::string(file)));
+    }
+    g_object_unref(cursor);
+    g_task_return_boolean(task->task(), true);
+}
+
+static void on_pending_queried(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    PendingTask* task = reinterpret_cast<PendingTask*>(g_task_get_task_data(G_TASK(result->gobj())));
+    std::tr1::shared_ptr<AnalysisJob::Priv> job = task->job;
+    GError* error = 0;
+    if (!g_task_propagate_boolean(G_TASK(result->gobj()), &error)) {
+        g_warning("Unable to find recordings to analyze: %s", error->message);
+        g_error_free(error);
+        job->finish();
+        return;
+    }
+
+    job->total = task->pending.size();
+    if (!job->total || g_atomic_int_get(&job->cancelled)) {
+        job->finish();
+        return;
+    }
+    g_debug("%s: analyzing %u recordings", job->analysis->name(), job->total);
+    for (guint i = 0; i < task->pending.size(); ++i) {
+        WorkItem* item = new WorkItem(job, task->pending[i].first, task->pending[i].second);
+        g_thread_pool_push(job->pool, item, NULL);
+    }
+}
+
+static void start_query(std::tr1::shared_ptr<AnalysisJob::Priv> job)
+{
+    PendingTask* task = new PendingTask(job, sigc::ptr_fun(&on_pending_queried));
+    gom_adapter_queue_read(gom_repository_get_adapter(job->repository->cobj()),
+                           query_pending_proxy,
+                           task);
+}
+
+AnalysisJob::Priv::Priv(const std::tr1::shared_ptr<Repository>& repository,
+                        const std::tr1::shared_ptr<Analysis>& analysis)
+    : repository(repository)
+    , analysis(analysis)
+    , pool(g_thread_pool_new(analyze_item, NULL, g_get_num_processors(), FALSE, NULL))
+    , cancelled(0)
+    , running(false)
+    , done(0)
+    , total(0)
+{
+}
+
+AnalysisJob::Priv::~Priv()
+{
+    // work items keep the job alive, so the pool is idle by now
+    g_thread_pool_free(pool, TRUE, TRUE);
+}
+
+void AnalysisJob::Priv::finish()
+{
+    running = false;
+    if (done && analysis->resource_type() != G_TYPE_NONE)
+        repository->signal_resources_changed().emit(analysis->resource_type());
+    signal_finished.emit();
+}
+
+AnalysisJob::AnalysisJob(const std::tr1::shared_ptr<Repository>& repository,
+                         const std::tr1::shared_ptr<Analysis>& analysis)
+    : m_priv(new Priv(repository, analysis))
+{
+}
+
+AnalysisJob::~AnalysisJob()
+{
+    cancel();
+}
+
+void AnalysisJob::start()
+{
+    g_return_if_fail(!m_priv->running);
+    m_priv->running = true;
+    m_priv->done = 0;
+    m_priv->total = 0;
+    g_atomic_int_set(&m_priv->cancelled, 0);
+    m_priv->repository->run_when_ready(sigc::bind(sigc::ptr_fun(&start_query), m_priv));
+}
+
+void AnalysisJob::cancel()
+{
+    g_atomic_int_set(&m_priv->cancelled, 1);
+}
+
+bool AnalysisJob::is_running() const
+{
+    return m_priv->running;
+}
+
+sigc::signal<void, guint, guint>& AnalysisJob::signal_progress()
+{
+    return m_priv->signal_progress;
+}
+
+sigc::signal<void>& AnalysisJob::signal_finished()
+{
+    return m_priv->signal_finished;
+}
+}
@@ -0,0 +1,55 @@
+/*
+ * analysis-job.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ANALYSIS_JOB_H
+#define _ANALYSIS_JOB_H
+
+#include <glibmm.h>
+#include <tr1/memory>
+
+#include "analysis.h"
+#include "repository.h"
+
+namespace SC {
+// Runs an Analysis over every recording that wasn't analyzed with its current
+// version yet. Files are decoded and analyzed on a pool with one thread per
+// processor; the results are written through the adapter's write queue.
+class AnalysisJob {
+public:
+    AnalysisJob(const std::tr1::shared_ptr<Repository>& repository,
+                const std::tr1::shared_ptr<Analysis>& analysis);
+    ~AnalysisJob();
+
+    void start();
+    // Recordings that are being analyzed are still finished, the remaining
+    // ones are skipped. signal_finished() is still emitted.
+    void cancel();
+    bool is_running() const;
+    // (done, total), emitted in the main thread after each recording
+    sigc::signal<void, guint, guint>& signal_progress();
+    sigc::signal<void>& signal_finished();
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _ANALYSIS_JOB_H */
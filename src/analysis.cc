@@ -0,0 +1,107 @@
+/*
+ * analysis.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "analysis.h"
+#include "archive-analysis.h"
+#include "embedding-analysis.h"
+#include "event-analysis.h"
+#include "fingerprint-analysis.h"
+#include "loudness-analysis.h"
+
+namespace SC {
+
+AnalysisVector collection_analyses()
+{
+    AnalysisVector analyses;
+    analyses.push_back(std::tr1::shared_ptr<Analysis>(new LoudnessAnalysis()));
+    analyses.push_back(std::tr1::shared_ptr<Analysis>(new EventAnalysis()));
+    analyses.push_back(std::tr1::shared_ptr<Analysis>(new FingerprintAnalysis()));
+    analyses.push_back(std::tr1::shared_ptr<Analysis>(new EmbeddingAnalysis()));
+    // last, so that the other analyses are done with the original files
+    if (ArchiveAnalysis::enabled())
+        analyses.push_back(std::tr1::shared_ptr<Analysis>(new ArchiveAnalysis()));
+    return analyses;
+}
+
+AnalysisVector import_analyses()
+{
+    AnalysisVector analyses;
+    analyses.push_back(std::tr1::shared_ptr<Analysis>(new EmbeddingAnalysis()));
+    if (ArchiveAnalysis::enabled())
+        analyses.push_back(std::tr1::shared_ptr<Analysis>(new ArchiveAnalysis()));
+    return analyses;
+}
+
+bool install_analysis_schema(GomAdapter* adapter, GError** error)
+{
+    static const char* statements[] = {
+        "CREATE TABLE IF NOT EXISTS \"analysis_runs\" ("
+        "\"recording_id\" INTEGER NOT NULL, "
+        "\"analysis\" TEXT NOT NULL, "
+        "\"version\" INTEGER NOT NULL, "
+        "PRIMARY KEY (\"recording_id\", \"analysis\"))",
+        "CREATE INDEX IF NOT EXISTS \"annotations_recording_idx\" "
+        "ON \"annotations\" (\"recording-id\")",
+        "CREATE TABLE IF NOT EXISTS \"fingerprints\" ("
+        "\"hash\" INTEGER NOT NULL, "
+        "\"recording_id\" INTEGER NOT NULL, "
+        "\"offset\" INTEGER NOT NULL)",
+        // the inverted index: covers the duplicate query, so matching
+        // landmarks are found without touching the table
+        "CREATE INDEX IF NOT EXISTS \"fingerprints_hash_idx\" "
+        "ON \"fingerprints\" (\"hash\", \"recording_id\", \"offset\")",
+        "CREATE INDEX IF NOT EXISTS \"fingerprints_recording_idx\" "
+        "ON \"fingerprints\" (\"recording_id\")",
+        // posting counts per hash, for stop-listing the frequent ones in
+        // query_duplicates(); kept up to date by the triggers below
+        "CREATE TABLE IF NOT EXISTS \"fingerprint_hashes\" ("
+        "\"hash\" INTEGER PRIMARY KEY, "
+        "\"postings\" INTEGER NOT NULL)",
+        "INSERT OR IGNORE INTO \"fingerprint_hashes\" (\"hash\", \"postings\") "
+        "SELECT \"hash\", COUNT(*) FROM \"fingerprints\" GROUP BY \"hash\"",
+        "DELETE FROM \"fingerprint_hashes\" WHERE \"postings\" = 0",
+        "CREATE TRIGGER IF NOT EXISTS \"fingerprints_postings_insert\" "
+        "AFTER INSERT ON \"fingerprints\" BEGIN "
+        "INSERT OR IGNORE INTO \"fingerprint_hashes\" (\"hash\", \"postings\") VALUES (NEW.\"hash\", 0); "
+        "UPDATE \"fingerprint_hashes\" SET \"postings\" = \"postings\" + 1 WHERE \"hash\" = NEW.\"hash\"; "
+        "END",
+        "CREATE TRIGGER IF NOT EXISTS \"fingerprints_postings_delete\" "
+        "AFTER DELETE ON \"fingerprints\" BEGIN "
+        "UPDATE \"fingerprint_hashes\" SET \"postings\" = \"postings\" - 1 WHERE \"hash\" = OLD.\"hash\"; "
+        "END",
+        // not a rowid alias: replacing an embedding must change its rowid so
+        // that the similarity index notices
+        "CREATE TABLE IF NOT EXISTS \"embeddings\" ("
+        "\"recording_id\" INTEGER NOT NULL UNIQUE, "
+        "\"vector\" BLOB NOT NULL)",
+        // for sorting and screening by the loudness analysis' levels
+        "CREATE INDEX IF NOT EXISTS \"recordings_peak_idx\" ON \"recordings\" (\"peak\")",
+        "CREATE INDEX IF NOT EXISTS \"recordings_loudness_idx\" ON \"recordings\" (\"loudness\")",
+        "CREATE INDEX IF NOT EXISTS \"recordings_clipped_idx\" ON \"recordings\" (\"clipped-samples\")",
+        "CREATE INDEX IF NOT EXISTS \"recordings_noise_floor_idx\" ON \"recordings\" (\"noise-floor\")"
+    };
+
+    for (guint i = 0; i < G_N_ELEMENTS(statements); ++i) {
+        if (!gom_adapter_execute_sql(adapter, statements[i], error))
+            return false;
+    }
+    return true;
+}
+}
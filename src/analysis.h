@@ -0,0 +1,83 @@
+/*
+ * analysis.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ANALYSIS_H
+#define _ANALYSIS_H
+
+#include <gom/gom.h>
+#include <string>
+#include <tr1/memory>
+#include <vector>
+
+namespace SC {
+
+// bump whenever the tables created by install_analysis_schema() change
+static const int ANALYSIS_SCHEMA_VERSION = 5;
+
+struct AnalysisResult {
+    virtual ~AnalysisResult() {}
+};
+
+// One kind of analysis that is run over the audio of every recording by an
+// AnalysisJob. Which recordings were analyzed with which version is kept in
+// the analysis_runs table, so re-runs only process new recordings, or all of
+// them after the version changed.
+class Analysis {
+public:
+    virtual ~Analysis() {}
+
+    virtual const char* name() const = 0;
+    virtual int version() const = 0;
+    // the type of resources whose stored data the analysis changes, if any;
+    // Repository::signal_resources_changed() is emitted for it once a job ends
+    virtual GType resource_type() const
+    {
+        return G_TYPE_NONE;
+    }
+    // Analyzes the audio file at @path. Called from several worker threads
+    // at once, so it must not modify the object.
+    virtual AnalysisResult* analyze(const std::string& path, GError** error) const = 0;
+    // Stores @result for @recording_id, replacing the results of an earlier
+    // run. Called in the adapter thread, inside a transaction.
+    virtual bool store(GomAdapter* adapter,
+                       gint64 recording_id,
+                       const AnalysisResult* result,
+                       GError** error) const = 0;
+    // Called in the adapter thread once the transaction that store() ran in
+    // was committed (@stored) or rolled back, e.g. to clean up files that
+    // only have to be kept if the database refers to them
+    virtual void finish(const AnalysisResult* result, bool stored) const
+    {
+    }
+};
+
+typedef std::vector<std::tr1::shared_ptr<Analysis> > AnalysisVector;
+
+// all of the analyses that are run over the collection
+AnalysisVector collection_analyses();
+// the analyses that are run right after an import: the one that similarity
+// search needs and, if it is enabled, archiving
+AnalysisVector import_analyses();
+
+// Must be called from the adapter thread
+bool install_analysis_schema(GomAdapter* adapter, GError** error);
+}
+
+#endif /* _ANALYSIS_H */
@@ -0,0 +1,251 @@
+/*
+ * annotation-resource.c
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "annotation-resource.h"
+#include "resource-dirty.h"
+
+/* annotations were added in this version of the repository schema */
+#define ANNOTATIONS_VERSION 3
+
+#define SC_ANNOTATION_RESOURCE_GET_PRIVATE(object)            \
+    (G_TYPE_INSTANCE_GET_PRIVATE((object),                    \
+                                 SC_TYPE_ANNOTATION_RESOURCE, \
+                                 ScAnnotationResourcePrivate))
+
+struct _ScAnnotationResourcePrivate {
+    gint64 id;
+    gint64 recording_id;
+    gdouble start;
+    gdouble end;
+    gdouble low_freq;
+    gdouble high_freq;
+    gdouble score;
+    char* source;
+    char* label;
+};
+
+enum {
+    PROP_0,
+    PROP_ID,
+    PROP_RECORDING_ID,
+    PROP_START,
+    PROP_END,
+    PROP_LOW_FREQ,
+    PROP_HIGH_FREQ,
+    PROP_SCORE,
+    PROP_SOURCE,
+    PROP_LABEL
+};
+
+G_DEFINE_TYPE(ScAnnotationResource,
+              sc_annotation_resource,
+              GOM_TYPE_RESOURCE)
+
+static void sc_annotation_resource_finalize(GObject* object)
+{
+    ScAnnotationResource* self = (ScAnnotationResource*)object;
+    g_free(self->priv->source);
+    g_free(self->priv->label);
+
+    G_OBJECT_CLASS(sc_annotation_resource_parent_class)->finalize(object);
+}
+
+static void sc_annotation_resource_set_property(GObject* obj,
+                                                guint property_id,
+                                                const GValue* value,
+                                                GParamSpec* pspec)
+{
+    ScAnnotationResource* self = SC_ANNOTATION_RESOURCE(obj);
+
+    sc_resource_track_change(obj, pspec, value);
+
+    switch (property_id) {
+    case PROP_ID:
+        self->priv->id = g_value_get_int64(value);
+        break;
+    case PROP_RECORDING_ID:
+        self->priv->recording_id = g_value_get_int64(value);
+        break;
+    case PROP_START:
+        self->priv->start = g_value_get_double(value);
+        break;
+    case PROP_END:
+        self->priv->end = g_value_get_double(value);
+        break;
+    case PROP_LOW_FREQ:
+        self->priv->low_freq = g_value_get_double(value);
+        break;
+    case PROP_HIGH_FREQ:
+        self->priv->high_freq = g_value_get_double(value);
+        break;
+    case PROP_SCORE:
+        self->priv->score = g_value_get_double(value);
+        break;
+    case PROP_SOURCE:
+        g_free(self->priv->source);
+        self->priv->source = g_value_dup_string(value);
+        break;
+    case PROP_LABEL:
+        g_free(self->priv->label);
+        self->priv->label = g_value_dup_string(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, property_id, pspec);
+    }
+}
+
+static void sc_annotation_resource_get_property(GObject* obj,
+                                                guint property_id,
+                                                GValue* value,
+                                                GParamSpec* pspec)
+{
+    ScAnnotationResource* self = SC_ANNOTATION_RESOURCE(obj);
+
+    switch (property_id) {
+    case PROP_ID:
+        g_value_set_int64(value, self->priv->id);
+        break;
+    case PROP_RECORDING_ID:
+        g_value_set_int64(value, self->priv->recording_id);
+        break;
+    case PROP_START:
+        g_value_set_double(value, self->priv->start);
+        break;
+    case PROP_END:
+        g_value_set_double(value, self->priv->end);
+        break;
+    case PROP_LOW_FREQ:
+        g_value_set_double(value, self->priv->low_freq);
+        break;
+    case PROP_HIGH_FREQ:
+        g_value_set_double(value, self->priv->high_freq);
+        break;
+    case PROP_SCORE:
+        g_value_set_double(value, self->priv->score);
+        break;
+    case PROP_SOURCE:
+        g_value_set_string(value, self->priv->source);
+        break;
+    case PROP_LABEL:
+        g_value_set_string(value, self->priv->label);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, property_id, pspec);
+    }
+}
+
+static void install_double_property(GObjectClass* object_class,
+                                    guint property_id,
+                                    const char* name)
+{
+    g_object_class_install_property(
+        object_class,
+        property_id,
+        g_param_spec_double(
+            name, NULL, NULL, -G_MAXDOUBLE, G_MAXDOUBLE, 0, G_PARAM_READWRITE));
+    gom_resource_class_set_property_new_in_version(
+        GOM_RESOURCE_CLASS(object_class), name, ANNOTATIONS_VERSION);
+}
+
+static void sc_annotation_resource_class_init(ScAnnotationResourceClass* klass)
+{
+    GObjectClass* object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = sc_annotation_resource_finalize;
+    object_class->get_property = sc_annotation_resource_get_property;
+    object_class->set_property = sc_annotation_resource_set_property;
+
+    g_type_class_add_private(object_class,
+                             sizeof(ScAnnotationResourcePrivate));
+
+    GomResourceClass* resource_class = GOM_RESOURCE_CLASS(klass);
+
+    g_object_class_install_property(
+        object_class,
+        PROP_ID,
+        g_param_spec_int64(
+            "id", NULL, NULL, 0, G_MAXINT64, 0, G_PARAM_READWRITE));
+    gom_resource_class_set_property_new_in_version(
+        resource_class, "id", ANNOTATIONS_VERSION);
+
+    g_object_class_install_property(
+        object_class,
+        PROP_RECORDING_ID,
+        g_param_spec_int64(
+            "recording-id", NULL, NULL, -1, G_MAXINT64, -1, G_PARAM_READWRITE));
+    gom_resource_class_set_reference(
+        resource_class, "recording-id", "recordings", "id");
+    gom_resource_class_set_property_new_in_version(
+        resource_class, "recording-id", ANNOTATIONS_VERSION);
+
+    /* times in seconds from the start of the recording */
+    install_double_property(object_class, PROP_START, "start");
+    install_double_property(object_class, PROP_END, "end");
+    /* frequency band in Hz */
+    install_double_property(object_class, PROP_LOW_FREQ, "low-freq");
+    install_double_property(object_class, PROP_HIGH_FREQ, "high-freq");
+    /* detector specific confidence, e.g. dB above the noise floor */
+    install_double_property(object_class, PROP_SCORE, "score");
+
+    /* what created the annotation, e.g. "energy-detector" or "user" */
+    g_object_class_install_property(
+        object_class,
+        PROP_SOURCE,
+        g_param_spec_string("source", NULL, NULL, NULL, G_PARAM_READWRITE));
+    gom_resource_class_set_property_new_in_version(
+        resource_class, "source", ANNOTATIONS_VERSION);
+
+    g_object_class_install_property(
+        object_class,
+        PROP_LABEL,
+        g_param_spec_string("label", NULL, NULL, NULL, G_PARAM_READWRITE));
+    gom_resource_class_set_property_new_in_version(
+        resource_class, "label", ANNOTATIONS_VERSION);
+
+    gom_resource_class_set_table(resource_class, "annotations");
+    gom_resource_class_set_primary_key(resource_class, "id");
+}
+
+static void sc_annotation_resource_init(ScAnnotationResource* self)
+{
+    self->priv = SC_ANNOTATION_RESOURCE_GET_PRIVATE(self);
+}
+
+gint64 sc_annotation_resource_get_id(const ScAnnotationResource* self)
+{
+    return self->priv->id;
+}
+
+gint64 sc_annotation_resource_get_recording_id(const ScAnnotationResource* self)
+{
+    return self->priv->recording_id;
+}
+
+gdouble sc_annotation_resource_get_start(const ScAnnotationResource* self)
+{
+    return self->priv->start;
+}
+
+gdouble sc_annotation_resource_get_end(const ScAnnotationResource* self)
+{
+    return self->priv->end;
+}
@@ -0,0 +1,69 @@
+/*
+ * annotation-resource.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SC_ANNOTATION_RESOURCE_H
+#define _SC_ANNOTATION_RESOURCE_H
+
+#include <gom/gom.h>
+
+G_BEGIN_DECLS
+
+#define SC_TYPE_ANNOTATION_RESOURCE (sc_annotation_resource_get_type())
+#define SC_ANNOTATION_RESOURCE(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST(        \
+        (obj), SC_TYPE_ANNOTATION_RESOURCE, ScAnnotationResource))
+#define SC_ANNOTATION_RESOURCE_CONST(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST(              \
+        (obj), SC_TYPE_ANNOTATION_RESOURCE, ScAnnotationResource const))
+#define SC_ANNOTATION_RESOURCE_CLASS(klass)               \
+    (G_TYPE_CHECK_CLASS_CAST((klass),                         \
+                             SC_TYPE_ANNOTATION_RESOURCE, \
+                             ScAnnotationResourceClass))
+#define SC_IS_ANNOTATION_RESOURCE(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE((obj), SC_TYPE_ANNOTATION_RESOURCE))
+#define SC_IS_ANNOTATION_RESOURCE_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_TYPE((klass), SC_TYPE_ANNOTATION_RESOURCE))
+#define SC_ANNOTATION_RESOURCE_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS(                   \
+        (obj), SC_TYPE_ANNOTATION_RESOURCE, ScAnnotationResourceClass))
+typedef struct _ScAnnotationResource ScAnnotationResource;
+typedef struct _ScAnnotationResourceClass ScAnnotationResourceClass;
+typedef struct _ScAnnotationResourcePrivate ScAnnotationResourcePrivate;
+
+struct _ScAnnotationResource {
+    GomResource parent;
+
+    ScAnnotationResourcePrivate* priv;
+};
+
+struct _ScAnnotationResourceClass {
+    GomResourceClass parent_class;
+};
+
+GType sc_annotation_resource_get_type(void) G_GNUC_CONST;
+
+gint64 sc_annotation_resource_get_id(const ScAnnotationResource* self);
+gint64 sc_annotation_resource_get_recording_id(const ScAnnotationResource* self);
+gdouble sc_annotation_resource_get_start(const ScAnnotationResource* self);
+gdouble sc_annotation_resource_get_end(const ScAnnotationResource* self);
+
+G_END_DECLS
+
+#endif /* _SC_ANNOTATION_RESOURCE_H */
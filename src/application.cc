@@ -20,7 +20,6 @@
 
 #include <gio/gio.h>
 #include <gom/gom.h>
-#include <gst/gst.h>
 
 #include "application.h"
 #include "equipment-resource.h"
@@ -28,13 +27,18 @@
 #include "identification-resource.h"
 #include "location-resource.h"
 #include "main-window.h"
+#include "media-init.h"
+#include "read-pool.h"
 #include "species-resource.h"
+#include "startup-trace.h"
 #include "task.h"
 
 namespace SC {
 
 const char* DB_NAME = "sound-collection.sqlite";
 const char* AUDIO_DIR = "audio";
+// read-only connections for list and search queries
+const guint READ_CONNECTIONS = 2;
 
 struct Application::Priv {
     int status;
@@ -64,6 +68,15 @@ struct Application::Priv {
         if (base->query_file_type() != Gio::FILE_TYPE_DIRECTORY)
             g_error("Collection path %s is not a directory", base->get_path().c_str());
     }
+
+    void on_write_startup_trace()
+    {
+        std::string path = Glib::getenv("SC_STARTUP_TRACE");
+        if (path.empty())
+            path = base->get_child("startup-trace.ini")->get_path();
+        if (startup_trace_write(path))
+            g_message("Wrote startup trace to %s", path.c_str());
+    }
 };
 
 Glib::RefPtr<Application> Application::create()
@@ -80,7 +93,24 @@ Application::Application()
 
 Application::~Application()
 {
+    startup_trace_write_default();
+
+    if (m_priv->repository)
+        m_priv->repository->signal_closing().emit();
+
     GError* error = 0;
+    if (m_priv->repository
+        && !m_priv->repository->save_queue()->flush_sync(&error)) {
+        g_warning("Unable to save pending changes: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    if (m_priv->repository
+        && !ReadPool::get(m_priv->repository->cobj())->close_sync(&error)) {
+        g_warning("Unable to close read connections: %s", error->message);
+        g_clear_error(&error);
+    }
+
     if (!gom_adapter_close_sync(m_priv->adapter.get(), &error)) {
         g_warning("Unable to close adapter: %s", error->message);
         g_clear_error(&error);
@@ -90,16 +120,32 @@ Application::~Application()
 
 void Application::on_startup()
 {
+    startup_trace_begin("gtk-init");
     Gio::Application::on_startup();
-    gst_init(NULL, NULL);
+    startup_trace_end("gtk-init");
+    startup_trace_begin("collection-directory");
     std::string collection_path = Glib::getenv("COLLECTION_BASE");
     if (collection_path.empty())
         collection_path = Glib::build_filename(Glib::get_user_data_dir(), "SoundCollection");
     m_priv->setup_collection_directory(collection_path);
+    startup_trace_end("collection-directory");
+
+    // GStreamer isn't needed until something is played or imported, so don't
+    // make startup wait for it. SC_PREWARM_DECODERS also loads the decoders
+    // for the formats in the collection ahead of time.
+    std::string prewarm_dir;
+    if (!Glib::getenv("SC_PREWARM_DECODERS").empty())
+        prewarm_dir = m_priv->base->get_child(AUDIO_DIR)->get_path();
+    media_init_start(prewarm_dir);
+
+    // can be triggered with `gapplication action org.quotidian.SoundCollection write-startup-trace`
+    add_action("write-startup-trace",
+               sigc::mem_fun(m_priv.get(), &Priv::on_write_startup_trace));
 
     std::string uri = database()->get_uri();
     g_debug("Opening db %s...", uri.c_str());
 
+    startup_trace_begin("adapter-open");
     m_priv->adapter = adoptGRef(gom_adapter_new());
     gom_adapter_open_async(m_priv->adapter.get(),
                            uri.c_str(),
@@ -115,6 +161,7 @@ void Application::on_activate()
 void Application::adapter_open_ready(GomAdapter* adapter, GAsyncResult* res)
 {
     g_debug("%s", G_STRFUNC);
+    startup_trace_end("adapter-open");
     GError* error = 0;
     if (!gom_adapter_open_finish(adapter, res, &error)) {
         g_warning("failed to open adapter: %s", error->message);
@@ -126,6 +173,9 @@ void Application::adapter_open_ready(GomAdapter* adapter, GAsyncResult* res)
 
     m_priv->repository.reset(new Repository(m_priv->adapter.get(),
                                             m_priv->base->get_child(AUDIO_DIR)->get_path()));
+    // list and search queries move off the adapter opened above once these
+    // connections are open
+    ReadPool::get(m_priv->repository->cobj())->open(database()->get_uri(), READ_CONNECTIONS);
     show();
     release();
 }
@@ -143,9 +193,11 @@ void Application::adapter_open_ready_proxy(GObject* source_object,
 
 void Application::show()
 {
+    startup_trace_begin("main-window");
     MainWindow* win = new MainWindow(m_priv->repository);
     add_window(*win);
     win->show();
+    startup_trace_end("main-window");
 }
 
 Glib::RefPtr<const Gio::File> Application::base() const
@@ -0,0 +1,132 @@
+/*
+ * archive-analysis.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <glibmm.h>
+
+#include "archive-analysis.h"
+#include "flac-archive.h"
+#include "GRefPtr.h"
+#include "recording-resource.h"
+
+namespace SC {
+
+struct ArchiveResult : public AnalysisResult {
+    std::string source;
+    // empty if the recording was left alone
+    std::string dest;
+};
+
+bool ArchiveAnalysis::enabled()
+{
+    return Glib::getenv("SC_ARCHIVE_POLICY") == "flac";
+}
+
+const char* ArchiveAnalysis::name() const
+{
+    return "flac-archive";
+}
+
+int ArchiveAnalysis::version() const
+{
+    return 1;
+}
+
+GType ArchiveAnalysis::resource_type() const
+{
+    return SC_TYPE_RECORDING_RESOURCE;
+}
+
+AnalysisResult* ArchiveAnalysis::analyze(const std::string& path, GError** error) const
+{
+    ArchiveResult* result = new ArchiveResult();
+    result->source = path;
+    if (!flac_can_archive(path))
+        return result;
+
+    std::string dest = flac_archive_path(path);
+    GError* archive_error = 0;
+    if (flac_archive(path, dest, &archive_error)) {
+        result->dest = dest;
+    } else if (g_error_matches(archive_error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA)) {
+        // e.g. floating point samples; recorded as done so it isn't retried
+        g_debug("not archiving: %s", archive_error->message);
+        g_error_free(archive_error);
+    } else {
+        g_propagate_error(error, archive_error);
+        delete result;
+        return 0;
+    }
+    return result;
+}
+
+bool ArchiveAnalysis::store(GomAdapter* adapter,
+                            gint64 recording_id,
+                            const AnalysisResult* result,
+                            GError** error) const
+{
+    const ArchiveResult* archive = static_cast<const ArchiveResult*>(result);
+    if (archive->dest.empty())
+        return true;
+
+    // only if the recording still refers to the file that was archived
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "UPDATE \"recordings\" SET \"file\" = ? WHERE \"id\" = ? AND \"file\" = ?",
+                     NULL)));
+    gom_command_set_param_string(command.get(), 0, archive->dest.c_str());
+    gom_command_set_param_int64(command.get(), 1, recording_id);
+    gom_command_set_param_string(command.get(), 2, archive->source.c_str());
+    if (!gom_command_execute(command.get(), NULL, error))
+        return false;
+
+    command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND, "adapter", adapter, "sql", "SELECT changes()", NULL)));
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+    bool updated = gom_cursor_next(cursor) && gom_cursor_get_column_int64(cursor, 0) > 0;
+    g_object_unref(cursor);
+    if (!updated) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                    "Recording %" G_GINT64_FORMAT " no longer refers to %s",
+                    recording_id, archive->source.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ArchiveAnalysis::finish(const AnalysisResult* result, bool stored) const
+{
+    const ArchiveResult* archive = static_cast<const ArchiveResult*>(result);
+    if (archive->dest.empty())
+        return;
+
+    // whichever copy the database doesn't refer to goes
+    const std::string& unused = stored ? archive->source : archive->dest;
+    if (g_unlink(unused.c_str()) != 0)
+        g_warning("Unable to remove %s: %s", unused.c_str(), g_strerror(errno));
+    else if (stored)
+        g_debug("archived %s as %s", archive->source.c_str(), archive->dest.c_str());
+}
+}
@@ -0,0 +1,292 @@
+/*
+ * audio-decoder.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gst/gst.h>
+
+#include "audio-decoder.h"
+#include "media-init.h"
+
+namespace SC {
+
+static gsize sample_size(AudioDecoder::SampleFormat format)
+{
+    return format == AudioDecoder::FORMAT_S16 ? sizeof(gint16) : sizeof(gint32);
+}
+
+static const char* format_name(AudioDecoder::SampleFormat format)
+{
+    switch (format) {
+    case AudioDecoder::FORMAT_S16:
+        return "S16LE";
+    case AudioDecoder::FORMAT_S32:
+        return "S32LE";
+    case AudioDecoder::FORMAT_F32:
+        return "F32LE";
+    default:
+        // audioconvert picks the one closest to what the decoder produces
+        return "{ S16LE, S32LE, F32LE }";
+    }
+}
+
+static AudioDecoder::SampleFormat format_from_name(const gchar* name)
+{
+    if (!g_strcmp0(name, "S16LE"))
+        return AudioDecoder::FORMAT_S16;
+    if (!g_strcmp0(name, "S32LE"))
+        return AudioDecoder::FORMAT_S32;
+    return AudioDecoder::FORMAT_F32;
+}
+
+struct AudioDecoder::Priv {
+    std::string path;
+    SampleFormat format;
+    // the negotiated format
+    SampleFormat output_format;
+    int requested_channels;
+    int requested_rate;
+    int channels;
+    int rate;
+    gsize frame_size;
+    double start;
+    double end;
+    guint64 start_frame;
+    guint64 end_frame;
+    ConsumeSlot consume;
+    GstElement* pipeline;
+    GstElement* convert;
+    volatile gint stopped;
+
+    Priv(const std::string& path, SampleFormat format, int channels, int rate)
+        : path(path)
+        , format(format)
+        , output_format(format)
+        , requested_channels(channels)
+        , requested_rate(rate)
+        , channels(0)
+        , rate(0)
+        , frame_size(0)
+        , start(0)
+        , end(-1)
+        , start_frame(0)
+        , end_frame(G_MAXUINT64)
+        , pipeline(0)
+        , convert(0)
+        , stopped(0)
+    {
+    }
+
+    static void pad_added_proxy(GstElement* decodebin, GstPad* pad, gpointer user_data)
+    {
+        Priv* self = reinterpret_cast<Priv*>(user_data);
+        GstPad* sink = gst_element_get_static_pad(self->convert, "sink");
+        GstCaps* caps = gst_pad_query_caps(pad, NULL);
+        const gchar* name = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+        // only the first audio stream is decoded
+        if (g_str_has_prefix(name, "audio/") && !gst_pad_is_linked(sink))
+            gst_pad_link(pad, sink);
+        gst_caps_unref(caps);
+        gst_object_unref(sink);
+    }
+
+    static void handoff_proxy(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+    {
+        reinterpret_cast<Priv*>(user_data)->handoff(buffer, pad);
+    }
+
+    void handoff(GstBuffer* buffer, GstPad* pad)
+    {
+        if (g_atomic_int_get(&stopped))
+            return;
+
+        if (!frame_size) {
+            GstCaps* caps = gst_pad_get_current_caps(pad);
+            GstStructure* structure = gst_caps_get_structure(caps, 0);
+            gst_structure_get_int(structure, "channels", &channels);
+            gst_structure_get_int(structure, "rate", &rate);
+            output_format = format_from_name(gst_structure_get_string(structure, "format"));
+            gst_caps_unref(caps);
+            frame_size = channels * sample_size(output_format);
+            start_frame = static_cast<guint64>(start * rate + 0.5);
+            end_frame = end >= 0 ? static_cast<guint64>(end * rate + 0.5) : G_MAXUINT64;
+        }
+
+        GstMapInfo map;
+        if (!frame_size || !gst_buffer_map(buffer, &map, GST_MAP_READ))
+            return;
+
+        // decoders work in whole packets, so cut the buffers to the
+        // requested range ourselves
+        gsize frames = map.size / frame_size;
+        guint64 first = GST_BUFFER_PTS_IS_VALID(buffer)
+            ? gst_util_uint64_scale_round(GST_BUFFER_PTS(buffer), rate, GST_SECOND)
+            : start_frame;
+        guint64 begin = MAX(first, start_frame);
+        guint64 end = MIN(first + frames, end_frame);
+        if (begin < end) {
+            const guint8* data = map.data + (begin - first) * frame_size;
+            if (!consume(data, end - begin))
+                stop();
+        }
+        if (first + frames >= end_frame)
+            stop();
+        gst_buffer_unmap(buffer, &map);
+    }
+
+    void stop()
+    {
+        if (g_atomic_int_compare_and_exchange(&stopped, 0, 1)) {
+            // wake up decode(), which is waiting on the bus
+            gst_element_post_message(pipeline,
+                                     gst_message_new_application(GST_OBJECT(pipeline), NULL));
+        }
+    }
+
+    GstElement* create_pipeline()
+    {
+        GstElement* bin = gst_pipeline_new(NULL);
+        GstElement* decode = gst_element_factory_make("uridecodebin", NULL);
+        convert = gst_element_factory_make("audioconvert", NULL);
+        GstElement* resample = gst_element_factory_make("audioresample", NULL);
+        GstElement* filter = gst_element_factory_make("capsfilter", NULL);
+        GstElement* sink = gst_element_factory_make("fakesink", NULL);
+        if (!decode || !convert || !resample || !filter || !sink) {
+            // only possible with a broken GStreamer installation
+            g_warning("Unable to create decoding pipeline");
+            gst_object_unref(bin);
+            return 0;
+        }
+
+        gchar* uri = g_filename_to_uri(path.c_str(), NULL, NULL);
+        g_object_set(decode, "uri", uri, NULL);
+        g_free(uri);
+
+        gchar* description = g_strdup_printf("audio/x-raw, format=(string)%s, layout=(string)interleaved",
+                                             format_name(format));
+        GstCaps* caps = gst_caps_from_string(description);
+        g_free(description);
+        if (requested_channels)
+            gst_caps_set_simple(caps, "channels", G_TYPE_INT, requested_channels, NULL);
+        if (requested_rate)
+            gst_caps_set_simple(caps, "rate", G_TYPE_INT, requested_rate, NULL);
+        g_object_set(filter, "caps", caps, NULL);
+        gst_caps_unref(caps);
+
+        g_object_set(sink, "signal-handoffs", TRUE, "sync", FALSE, NULL);
+        g_signal_connect(decode, "pad-added", G_CALLBACK(pad_added_proxy), this);
+        g_signal_connect(sink, "handoff", G_CALLBACK(handoff_proxy), this);
+
+        gst_bin_add_many(GST_BIN(bin), decode, convert, resample, filter, sink, NULL);
+        gst_element_link_many(convert, resample, filter, sink, NULL);
+        return bin;
+    }
+};
+
+AudioDecoder::AudioDecoder(const std::string& path,
+                           SampleFormat format,
+                           int channels,
+                           int rate)
+    : m_priv(new Priv(path, format, channels, rate))
+{
+}
+
+int AudioDecoder::channels() const
+{
+    return m_priv->channels;
+}
+
+int AudioDecoder::rate() const
+{
+    return m_priv->rate;
+}
+
+AudioDecoder::SampleFormat AudioDecoder::format() const
+{
+    return m_priv->output_format;
+}
+
+bool AudioDecoder::decode(double start, double end, const ConsumeSlot& consume, GError** error)
+{
+    media_ensure_initialized();
+    m_priv->consume = consume;
+    m_priv->stopped = 0;
+    m_priv->frame_size = 0;
+    m_priv->start = start;
+    m_priv->end = end;
+    m_priv->pipeline = m_priv->create_pipeline();
+    if (!m_priv->pipeline) {
+        g_set_error(error, GST_CORE_ERROR, GST_CORE_ERROR_MISSING_PLUGIN,
+                    "Unable to create decoding pipeline");
+        return false;
+    }
+
+    bool success = true;
+    GstBus* bus = gst_element_get_bus(m_priv->pipeline);
+    // preroll first, seeking only works once the decoder is set up
+    gst_element_set_state(m_priv->pipeline, GST_STATE_PAUSED);
+    if (gst_element_get_state(m_priv->pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_FAILURE) {
+        GstMessage* message = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+        if (message) {
+            GError* gst_error = 0;
+            gst_message_parse_error(message, &gst_error, NULL);
+            g_propagate_error(error, gst_error);
+            gst_message_unref(message);
+        }
+        success = false;
+    }
+
+    if (success && (start > 0 || end >= 0)) {
+        // the prerolled buffer is discarded by the flushing seek; fakesink
+        // only emits handoffs for rendered buffers anyway
+        gint64 start_time = static_cast<gint64>(start * GST_SECOND);
+        gint64 end_time = end >= 0 ? static_cast<gint64>(end * GST_SECOND) : -1;
+        gst_element_seek(m_priv->pipeline, 1.0, GST_FORMAT_TIME,
+                         GstSeekFlags(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE),
+                         GST_SEEK_TYPE_SET, start_time,
+                         end_time >= 0 ? GST_SEEK_TYPE_SET : GST_SEEK_TYPE_NONE, end_time);
+    }
+
+    if (success) {
+        gst_element_set_state(m_priv->pipeline, GST_STATE_PLAYING);
+        // an application message means that decoding was stopped early
+        GstMessage* message = gst_bus_timed_pop_filtered(
+            bus,
+            GST_CLOCK_TIME_NONE,
+            GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_APPLICATION));
+        if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR) {
+            GError* gst_error = 0;
+            gst_message_parse_error(message, &gst_error, NULL);
+            g_propagate_error(error, gst_error);
+            success = false;
+        }
+        gst_message_unref(message);
+    }
+
+    if (!success && error && !*error)
+        g_set_error(error, GST_STREAM_ERROR, GST_STREAM_ERROR_DECODE,
+                    "Unable to decode %s", m_priv->path.c_str());
+
+    gst_element_set_state(m_priv->pipeline, GST_STATE_NULL);
+    gst_object_unref(bus);
+    gst_object_unref(m_priv->pipeline);
+    m_priv->pipeline = 0;
+    m_priv->convert = 0;
+    return success;
+}
+}
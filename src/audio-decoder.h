@@ -0,0 +1,67 @@
+/*
+ * audio-decoder.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AUDIO_DECODER_H
+#define _AUDIO_DECODER_H
+
+#include <glibmm.h>
+#include <tr1/memory>
+
+namespace SC {
+// Decodes (part of) an audio file to raw interleaved samples with
+// GStreamer. Decoding is synchronous and blocks until it is done, so it is
+// meant to be used from a worker thread.
+class AudioDecoder {
+public:
+    enum SampleFormat {
+        FORMAT_S16,
+        FORMAT_S32,
+        FORMAT_F32,
+        // whichever of the above holds the samples of the file without
+        // loss, see format()
+        FORMAT_SOURCE
+    };
+
+    // Called with blocks of interleaved samples in the requested format;
+    // return false to stop decoding. Called from a GStreamer thread.
+    typedef sigc::slot<bool, const void*, gsize> ConsumeSlot;
+
+    // @channels and @rate of 0 keep the values of the file
+    AudioDecoder(const std::string& path,
+                 SampleFormat format,
+                 int channels = 0,
+                 int rate = 0);
+
+    // Decodes the samples between @start and @end seconds, or up to the end
+    // of the file if @end is negative. The range is sample accurate.
+    bool decode(double start, double end, const ConsumeSlot& consume, GError** error);
+
+    // the actual output format; valid once the first block was consumed
+    int channels() const;
+    int rate() const;
+    SampleFormat format() const;
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _AUDIO_DECODER_H */
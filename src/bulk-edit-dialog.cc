@@ -0,0 +1,94 @@
+/*
+ * bulk-edit-dialog.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bulk-edit-dialog.h"
+#include "location-entry.h"
+
+namespace SC {
+struct BulkEditDialog::Priv {
+    std::tr1::shared_ptr<Repository> repository;
+    Gtk::Grid grid;
+    Gtk::CheckButton recordist_check;
+    Gtk::Entry recordist_entry;
+    Gtk::CheckButton location_check;
+    LocationEntry location_entry;
+
+    Priv(const std::tr1::shared_ptr<Repository>& repository)
+        : repository(repository)
+        , recordist_check("Recordist", true)
+        , location_check("Location", true)
+        , location_entry(repository)
+    {
+        grid.set_row_spacing(6);
+        grid.set_column_spacing(12);
+        grid.set_border_width(12);
+        grid.attach(recordist_check, 0, 0, 1, 1);
+        grid.attach(recordist_entry, 1, 0, 1, 1);
+        grid.attach(location_check, 0, 1, 1, 1);
+        grid.attach(location_entry, 1, 1, 1, 1);
+        recordist_entry.set_hexpand(true);
+        location_entry.set_hexpand(true);
+        grid.show_all();
+
+        recordist_entry.set_sensitive(false);
+        location_entry.set_sensitive(false);
+        recordist_check.signal_toggled().connect(sigc::mem_fun(this, &Priv::update_sensitivity));
+        location_check.signal_toggled().connect(sigc::mem_fun(this, &Priv::update_sensitivity));
+    }
+
+    void update_sensitivity()
+    {
+        recordist_entry.set_sensitive(recordist_check.get_active());
+        location_entry.set_sensitive(location_check.get_active());
+    }
+};
+
+BulkEditDialog::BulkEditDialog(Gtk::Window& parent,
+                               const std::tr1::shared_ptr<Repository>& repository,
+                               int n_recordings)
+    : Gtk::Dialog(Glib::ustring::compose("Edit %1 Recordings", n_recordings), parent, true)
+    , m_priv(new Priv(repository))
+{
+    get_content_area()->pack_start(m_priv->grid, true, true);
+    add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+    add_button(Gtk::Stock::APPLY, Gtk::RESPONSE_APPLY);
+    set_default_response(Gtk::RESPONSE_APPLY);
+}
+
+PropertyMap BulkEditDialog::get_changes() const
+{
+    PropertyMap changes;
+    if (m_priv->recordist_check.get_active()) {
+        Glib::Value<Glib::ustring> recordist;
+        recordist.init(recordist.value_type());
+        recordist.set(m_priv->recordist_entry.get_text());
+        changes["recordist"] = recordist;
+    }
+
+    gint64 location = m_priv->location_entry.location_id();
+    if (m_priv->location_check.get_active() && location) {
+        Glib::Value<gint64> location_id;
+        location_id.init(location_id.value_type());
+        location_id.set(location);
+        changes["location-id"] = location_id;
+    }
+    return changes;
+}
+}
@@ -0,0 +1,319 @@
+/*
+ * clip-extract.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <vector>
+
+#include "audio-decoder.h"
+#include "clip-extract.h"
+#include "GRefPtr.h"
+
+namespace SC {
+
+static const gsize COPY_BUFFER_SIZE = 64 * 1024;
+
+enum CopyResult {
+    COPY_DONE,
+    COPY_UNSUPPORTED,
+    COPY_FAILED
+};
+
+static guint16 read_le16(const guint8* data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static guint32 read_le32(const guint8* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<guint32>(data[3]) << 24);
+}
+
+static void write_le32(guint8* data, guint32 value)
+{
+    data[0] = value & 0xff;
+    data[1] = (value >> 8) & 0xff;
+    data[2] = (value >> 16) & 0xff;
+    data[3] = (value >> 24) & 0xff;
+}
+
+// Writes the RIFF header for a WAV file with the given format chunk contents
+// and @data_size bytes of samples
+static bool write_wav_header(GOutputStream* out,
+                             const std::string& fmt,
+                             guint32 data_size,
+                             GError** error)
+{
+    guint32 fmt_padded = fmt.size() + (fmt.size() & 1);
+    guint8 header[12];
+    memcpy(header, "RIFF", 4);
+    write_le32(header + 4, 4 + 8 + fmt_padded + 8 + data_size + (data_size & 1));
+    memcpy(header + 8, "WAVE", 4);
+
+    guint8 chunk[8];
+    memcpy(chunk, "fmt ", 4);
+    write_le32(chunk + 4, fmt.size());
+    if (!g_output_stream_write_all(out, header, sizeof(header), NULL, NULL, error)
+        || !g_output_stream_write_all(out, chunk, sizeof(chunk), NULL, NULL, error)
+        || !g_output_stream_write_all(out, fmt.data(), fmt.size(), NULL, NULL, error))
+        return false;
+    if (fmt.size() & 1 && !g_output_stream_write_all(out, "", 1, NULL, NULL, error))
+        return false;
+
+    memcpy(chunk, "data", 4);
+    write_le32(chunk + 4, data_size);
+    return g_output_stream_write_all(out, chunk, sizeof(chunk), NULL, NULL, error);
+}
+
+static bool is_pcm_format(const std::string& fmt)
+{
+    if (fmt.size() < 16)
+        return false;
+    const guint8* data = reinterpret_cast<const guint8*>(fmt.data());
+    guint16 tag = read_le16(data);
+    // WAVE_FORMAT_EXTENSIBLE keeps the real format in its sub format GUID
+    if (tag == 0xfffe && fmt.size() >= 40)
+        tag = read_le16(data + 24);
+    // integer or floating point PCM
+    return tag == 1 || tag == 3;
+}
+
+static CopyResult copy_pcm_wav(const std::string& source,
+                               const std::string& dest,
+                               double start,
+                               double end,
+                               double* duration,
+                               GError** error)
+{
+    GRefPtr<GFile> source_file = adoptGRef(g_file_new_for_path(source.c_str()));
+    GRefPtr<GFileInputStream> in = adoptGRef(g_file_read(source_file.get(), NULL, error));
+    if (!in)
+        return COPY_FAILED;
+
+    guint8 riff[12];
+    gsize n_read = 0;
+    if (!g_input_stream_read_all(G_INPUT_STREAM(in.get()), riff, sizeof(riff), &n_read, NULL, error))
+        return COPY_FAILED;
+    if (n_read != sizeof(riff) || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4))
+        return COPY_UNSUPPORTED;
+
+    // walk the chunks up to the sample data
+    std::string fmt;
+    goffset data_offset = -1;
+    guint32 data_size = 0;
+    while (data_offset < 0) {
+        guint8 chunk[8];
+        if (!g_input_stream_read_all(G_INPUT_STREAM(in.get()), chunk, sizeof(chunk), &n_read, NULL, error))
+            return COPY_FAILED;
+        if (n_read != sizeof(chunk))
+            return COPY_UNSUPPORTED;
+
+        guint32 size = read_le32(chunk + 4);
+        if (!memcmp(chunk, "data", 4)) {
+            data_offset = g_seekable_tell(G_SEEKABLE(in.get()));
+            data_size = size;
+        } else if (!memcmp(chunk, "fmt ", 4) && size < 1024) {
+            fmt.resize(size);
+            if (!g_input_stream_read_all(G_INPUT_STREAM(in.get()), &fmt[0], size, &n_read, NULL, error))
+                return COPY_FAILED;
+            if (n_read != size)
+                return COPY_UNSUPPORTED;
+            if (size & 1 && !g_seekable_seek(G_SEEKABLE(in.get()), 1, G_SEEK_CUR, NULL, error))
+                return COPY_FAILED;
+        } else if (!g_seekable_seek(G_SEEKABLE(in.get()), size + (size & 1), G_SEEK_CUR, NULL, error)) {
+            return COPY_FAILED;
+        }
+    }
+    if (!is_pcm_format(fmt))
+        return COPY_UNSUPPORTED;
+
+    const guint8* fmt_data = reinterpret_cast<const guint8*>(fmt.data());
+    guint32 rate = read_le32(fmt_data + 4);
+    guint16 block_align = read_le16(fmt_data + 12);
+    if (!rate || !block_align)
+        return COPY_UNSUPPORTED;
+
+    // only whole sample frames are copied
+    guint64 frames = data_size / block_align;
+    guint64 first = MIN(static_cast<guint64>(start * rate + 0.5), frames);
+    guint64 last = end >= 0 ? MIN(static_cast<guint64>(end * rate + 0.5), frames) : frames;
+    if (first >= last) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "The clip is outside of the recording");
+        return COPY_FAILED;
+    }
+    guint32 clip_size = (last - first) * block_align;
+
+    if (!g_seekable_seek(G_SEEKABLE(in.get()), data_offset + first * block_align, G_SEEK_SET, NULL, error))
+        return COPY_FAILED;
+
+    GRefPtr<GFile> dest_file = adoptGRef(g_file_new_for_path(dest.c_str()));
+    GRefPtr<GFileOutputStream> out = adoptGRef(
+        g_file_create(dest_file.get(), G_FILE_CREATE_NONE, NULL, error));
+    if (!out)
+        return COPY_FAILED;
+
+    GOutputStream* stream = G_OUTPUT_STREAM(out.get());
+    if (!write_wav_header(stream, fmt, clip_size, error))
+        return COPY_FAILED;
+
+    std::vector<guint8> buffer(COPY_BUFFER_SIZE);
+    guint32 remaining = clip_size;
+    while (remaining) {
+        gsize chunk = MIN(remaining, COPY_BUFFER_SIZE);
+        if (!g_input_stream_read_all(G_INPUT_STREAM(in.get()), &buffer[0], chunk, &n_read, NULL, error)
+            || !g_output_stream_write_all(stream, &buffer[0], n_read, NULL, NULL, error))
+            return COPY_FAILED;
+        if (n_read != chunk) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                        "%s is truncated", source.c_str());
+            return COPY_FAILED;
+        }
+        remaining -= chunk;
+    }
+    if (clip_size & 1 && !g_output_stream_write_all(stream, "", 1, NULL, NULL, error))
+        return COPY_FAILED;
+    if (!g_output_stream_close(stream, NULL, error))
+        return COPY_FAILED;
+
+    *duration = static_cast<double>(last - first) / rate;
+    return COPY_DONE;
+}
+
+struct DecodedClip {
+    GOutputStream* out;
+    AudioDecoder* decoder;
+    guint64 frames;
+    GError* error;
+};
+
+static guint16 sample_bits(AudioDecoder::SampleFormat format)
+{
+    return format == AudioDecoder::FORMAT_S16 ? 16 : 32;
+}
+
+static bool write_samples(const void* data, gsize frames, DecodedClip* clip)
+{
+    gsize frame_size = clip->decoder->channels() * sample_bits(clip->decoder->format()) / 8;
+    if (!g_output_stream_write_all(clip->out, data, frames * frame_size, NULL, NULL, &clip->error))
+        return false;
+    clip->frames += frames;
+    return true;
+}
+
+// Decodes just the requested range and stores it as PCM in the sample format
+// closest to the source's (16 or 32 bit integer, or 32 bit float), so that
+// e.g. 24 bit FLAC recordings are not requantized
+static bool decode_clip(const std::string& source,
+                        const std::string& dest,
+                        double start,
+                        double end,
+                        double* duration,
+                        GError** error)
+{
+    GRefPtr<GFile> dest_file = adoptGRef(g_file_new_for_path(dest.c_str()));
+    GRefPtr<GFileOutputStream> out = adoptGRef(
+        g_file_create(dest_file.get(), G_FILE_CREATE_NONE, NULL, error));
+    if (!out)
+        return false;
+
+    // the header is rewritten once the format and length are known
+    GOutputStream* stream = G_OUTPUT_STREAM(out.get());
+    std::string fmt(16, '\0');
+    if (!write_wav_header(stream, fmt, 0, error))
+        return false;
+
+    AudioDecoder decoder(source, AudioDecoder::FORMAT_SOURCE);
+    DecodedClip clip = { stream, &decoder, 0, 0 };
+    bool decoded = decoder.decode(start,
+                                  end,
+                                  sigc::bind(sigc::ptr_fun(&write_samples), &clip),
+                                  error);
+    if (clip.error) {
+        g_clear_error(error);
+        g_propagate_error(error, clip.error);
+        decoded = false;
+    }
+    if (!decoded)
+        return false;
+    if (!clip.frames) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "The clip is outside of the recording");
+        return false;
+    }
+
+    guint16 channels = decoder.channels();
+    guint32 rate = decoder.rate();
+    guint16 bits = sample_bits(decoder.format());
+    guint16 block_align = channels * bits / 8;
+    guint8* fmt_data = reinterpret_cast<guint8*>(&fmt[0]);
+    fmt_data[0] = decoder.format() == AudioDecoder::FORMAT_F32 ? 3 : 1; // IEEE float or PCM
+    fmt_data[2] = channels & 0xff;
+    fmt_data[3] = channels >> 8;
+    write_le32(fmt_data + 4, rate);
+    write_le32(fmt_data + 8, rate * block_align);
+    fmt_data[12] = block_align & 0xff;
+    fmt_data[13] = block_align >> 8;
+    fmt_data[14] = bits;
+
+    guint32 data_size = clip.frames * block_align;
+    if (!g_seekable_seek(G_SEEKABLE(out.get()), 0, G_SEEK_SET, NULL, error)
+        || !write_wav_header(stream, fmt, data_size, error)
+        || !g_output_stream_close(stream, NULL, error))
+        return false;
+
+    *duration = static_cast<double>(clip.frames) / rate;
+    return true;
+}
+
+bool extract_clip(const std::string& source,
+                  const std::string& dest,
+                  double start,
+                  double end,
+                  double* duration,
+                  GError** error)
+{
+    g_return_val_if_fail(end < 0 || end > start, false);
+
+    if (g_file_test(dest.c_str(), G_FILE_TEST_EXISTS)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_EXISTS, "%s already exists", dest.c_str());
+        return false;
+    }
+
+    bool success = false;
+    switch (copy_pcm_wav(source, dest, start, end, duration, error)) {
+    case COPY_DONE:
+        success = true;
+        break;
+    case COPY_FAILED:
+        break;
+    case COPY_UNSUPPORTED:
+        g_debug("%s is not a PCM WAV file, decoding the clip instead", source.c_str());
+        success = decode_clip(source, dest, start, end, duration, error);
+        break;
+    }
+
+    // don't leave a partial clip behind
+    if (!success)
+        g_unlink(dest.c_str());
+    return success;
+}
+}
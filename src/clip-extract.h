@@ -0,0 +1,42 @@
+/*
+ * clip-extract.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CLIP_EXTRACT_H
+#define _CLIP_EXTRACT_H
+
+#include <glib.h>
+#include <string>
+
+namespace SC {
+// Writes the audio between @start and @end seconds of @source to the WAV
+// file @dest. PCM WAV files are copied byte for byte without touching the
+// samples; anything else only has the requested range decoded, in the sample
+// format closest to the source's.
+// @duration is set to the length of the clip that was written.
+// This blocks, so it should be run in a worker thread.
+bool extract_clip(const std::string& source,
+                  const std::string& dest,
+                  double start,
+                  double end,
+                  double* duration,
+                  GError** error);
+}
+
+#endif /* _CLIP_EXTRACT_H */
@@ -0,0 +1,503 @@
+/*
+ * collection-stats.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "collection-stats.h"
+#include "GRefPtr.h"
+
+namespace SC {
+
+/*
+ * The aggregate tables are maintained by SQLite triggers on the recordings
+ * and identifications tables. Each trigger applies the change of a single
+ * row to the groups that the row belongs to: the count and total are
+ * adjusted by one row, and an inserted row can only extend the MIN/MAX
+ * values. Only when a removed row held the current minimum or maximum of a
+ * group are the remaining rows of that group scanned again, using the
+ * indexes created below. Reading the aggregates is then a plain scan of a
+ * small table.
+ *
+ * The row_counts table holds the number of rows of the tables that are shown
+ * in lists, so that a list can be sized without a COUNT(*) over the table.
+ */
+
+static const char* counted_tables[] = { "recordings", "locations" };
+
+static const char* stats_triggers[] = { "recordings_stats_insert",
+                                        "recordings_stats_delete",
+                                        "recordings_stats_update",
+                                        "identifications_stats_insert",
+                                        "identifications_stats_delete",
+                                        "identifications_stats_update" };
+
+static const char* AGGREGATE_COLUMNS = "COUNT(*), "
+                                       "TOTAL(CASE WHEN r.duration > 0 THEN r.duration ELSE 0 END), "
+                                       "MAX(r.quality), "
+                                       "MIN(r.date), "
+                                       "MAX(r.date)";
+
+static const char* STATS_COLUMNS = "count INTEGER NOT NULL, "
+                                   "total_duration REAL NOT NULL, "
+                                   "best_quality INTEGER, "
+                                   "first_date TEXT, "
+                                   "last_date TEXT";
+
+StatsEntry::StatsEntry()
+    : key_id(0)
+    , location_id(0)
+    , count(0)
+    , total_duration(0.0)
+    , best_quality(-1)
+{
+}
+
+// The values a recording adds to the groups it belongs to
+struct Contribution {
+    std::string duration;
+    std::string quality;
+    std::string date;
+};
+
+// the values of the OLD or NEW row of a trigger on recordings
+static Contribution row_contribution(const char* row)
+{
+    Contribution c;
+    c.duration = Glib::ustring::compose("(CASE WHEN %1.duration > 0 THEN %1.duration ELSE 0 END)", row);
+    c.quality = Glib::ustring::compose("%1.quality", row);
+    c.date = Glib::ustring::compose("%1.date", row);
+    return c;
+}
+
+// the values of the recording with the id @recording
+static Contribution recording_contribution(const std::string& recording)
+{
+    Contribution c;
+    c.duration = Glib::ustring::compose(
+        "(SELECT CASE WHEN duration > 0 THEN duration ELSE 0 END FROM recordings WHERE id = %1)",
+        recording);
+    c.quality = Glib::ustring::compose("(SELECT quality FROM recordings WHERE id = %1)", recording);
+    c.date = Glib::ustring::compose("(SELECT date FROM recordings WHERE id = %1)", recording);
+    return c;
+}
+
+// The recordings that currently make up the row of @table being updated, for
+// rescanning its extremes
+static std::string group_members(const std::string& table)
+{
+    if (table == "location_stats")
+        return "recordings r WHERE r.\"location-id\" = location_stats.location_id";
+    if (table == "recordist_stats")
+        return "recordings r WHERE r.recordist = recordist_stats.recordist";
+    return "recordings r WHERE r.\"location-id\" = species_stats.location_id "
+           "AND r.id IN (SELECT \"recording-id\" FROM identifications "
+           "WHERE \"species-id\" = species_stats.species_id)";
+}
+
+// Adds a recording to the existing rows of @table matched by @group
+static std::string add_to_groups(const std::string& table,
+                                 const std::string& group,
+                                 const Contribution& c)
+{
+    return Glib::ustring::compose(
+        "UPDATE %1 SET count = count + 1, total_duration = total_duration + %3, "
+        "best_quality = CASE WHEN %4 IS NOT NULL AND (best_quality IS NULL OR %4 > best_quality) "
+        "THEN %4 ELSE best_quality END, "
+        "first_date = CASE WHEN %5 IS NOT NULL AND (first_date IS NULL OR %5 < first_date) "
+        "THEN %5 ELSE first_date END, "
+        "last_date = CASE WHEN %5 IS NOT NULL AND (last_date IS NULL OR %5 > last_date) "
+        "THEN %5 ELSE last_date END "
+        "WHERE %2; ",
+        table,
+        group,
+        c.duration,
+        c.quality,
+        c.date);
+}
+
+// Removes a recording from the rows of @table matched by @group. Must run
+// after the recording has left the group, i.e. in an AFTER trigger.
+static std::string remove_from_groups(const std::string& table,
+                                      const std::string& group,
+                                      const Contribution& c)
+{
+    std::string members = group_members(table);
+    return Glib::ustring::compose(
+               "UPDATE %1 SET count = count - 1, total_duration = total_duration - %3 WHERE %2; "
+               "DELETE FROM %1 WHERE (%2) AND count <= 0; ",
+               table,
+               group,
+               c.duration)
+        + Glib::ustring::compose(
+               "UPDATE %1 SET best_quality = (SELECT MAX(r.quality) FROM %3) "
+               "WHERE (%2) AND %4 IS NOT NULL AND %4 >= best_quality; "
+               "UPDATE %1 SET first_date = (SELECT MIN(r.date) FROM %3) "
+               "WHERE (%2) AND %5 IS NOT NULL AND %5 <= first_date; "
+               "UPDATE %1 SET last_date = (SELECT MAX(r.date) FROM %3) "
+               "WHERE (%2) AND %5 IS NOT NULL AND %5 >= last_date; ",
+               table,
+               group,
+               members,
+               c.quality,
+               c.date);
+}
+
+static std::string recording_groups_add(const char* row)
+{
+    Contribution c = row_contribution(row);
+    std::string location = Glib::ustring::compose("%1.\"location-id\"", row);
+    std::string recordist = Glib::ustring::compose("%1.recordist", row);
+    std::string species = Glib::ustring::compose(
+        "SELECT \"species-id\" FROM identifications WHERE \"recording-id\" = %1.id", row);
+    return Glib::ustring::compose(
+               "INSERT OR IGNORE INTO location_stats (location_id, count, total_duration) "
+               "SELECT %1, 0, 0 WHERE %1 IS NOT NULL; "
+               "INSERT OR IGNORE INTO recordist_stats (recordist, count, total_duration) "
+               "SELECT %2, 0, 0 WHERE %2 IS NOT NULL; "
+               "INSERT OR IGNORE INTO species_stats (species_id, location_id, count, total_duration) "
+               "SELECT DISTINCT \"species-id\", %1, 0, 0 FROM identifications "
+               "WHERE \"recording-id\" = %3.id AND %1 IS NOT NULL; ",
+               location,
+               recordist,
+               row)
+        + add_to_groups("location_stats", "location_id = " + location, c)
+        + add_to_groups("recordist_stats", "recordist = " + recordist, c)
+        + add_to_groups("species_stats",
+                        Glib::ustring::compose("location_id = %1 AND species_id IN (%2)", location, species),
+                        c);
+}
+
+static std::string recording_groups_remove(const char* row)
+{
+    Contribution c = row_contribution(row);
+    std::string location = Glib::ustring::compose("%1.\"location-id\"", row);
+    std::string species = Glib::ustring::compose(
+        "SELECT \"species-id\" FROM identifications WHERE \"recording-id\" = %1.id", row);
+    return remove_from_groups("location_stats", "location_id = " + location, c)
+        + remove_from_groups("recordist_stats", Glib::ustring::compose("recordist = %1.recordist", row), c)
+        + remove_from_groups("species_stats",
+                             Glib::ustring::compose("location_id = %1 AND species_id IN (%2)", location, species),
+                             c);
+}
+
+// The species group of the identification @row, but only if no other
+// identification of the same species for the same recording exists;
+// @exclude_row is set when @row itself is still in the table
+static std::string identification_group(const char* row, bool exclude_row)
+{
+    return Glib::ustring::compose(
+        "species_id = %1.\"species-id\" "
+        "AND location_id = (SELECT \"location-id\" FROM recordings WHERE id = %1.\"recording-id\") "
+        "AND NOT EXISTS (SELECT 1 FROM identifications WHERE \"species-id\" = %1.\"species-id\" "
+        "AND \"recording-id\" = %1.\"recording-id\"%2)",
+        row,
+        exclude_row ? Glib::ustring::compose(" AND id != %1.id", row) : Glib::ustring());
+}
+
+static std::string identification_add(const char* row)
+{
+    std::string group = identification_group(row, true);
+    return Glib::ustring::compose(
+               "INSERT OR IGNORE INTO species_stats (species_id, location_id, count, total_duration) "
+               "SELECT %1.\"species-id\", r.\"location-id\", 0, 0 FROM recordings r "
+               "WHERE r.id = %1.\"recording-id\" AND r.\"location-id\" IS NOT NULL; ",
+               row)
+        + add_to_groups("species_stats",
+                        group,
+                        recording_contribution(Glib::ustring::compose("%1.\"recording-id\"", row)));
+}
+
+static std::string identification_remove(const char* row)
+{
+    return remove_from_groups("species_stats",
+                              identification_group(row, false),
+                              recording_contribution(Glib::ustring::compose("%1.\"recording-id\"", row)));
+}
+
+static std::vector<std::string> stats_schema()
+{
+    std::vector<std::string> schema;
+    schema.push_back(Glib::ustring::compose(
+        "CREATE TABLE IF NOT EXISTS location_stats (location_id INTEGER PRIMARY KEY, %1)",
+        STATS_COLUMNS));
+    schema.push_back(Glib::ustring::compose(
+        "CREATE TABLE IF NOT EXISTS recordist_stats (recordist TEXT PRIMARY KEY, %1)",
+        STATS_COLUMNS));
+    schema.push_back(Glib::ustring::compose(
+        "CREATE TABLE IF NOT EXISTS species_stats (species_id INTEGER NOT NULL, "
+        "location_id INTEGER NOT NULL, %1, PRIMARY KEY (species_id, location_id))",
+        STATS_COLUMNS));
+
+    schema.push_back("CREATE INDEX IF NOT EXISTS recordings_location_idx ON recordings (\"location-id\")");
+    schema.push_back("CREATE INDEX IF NOT EXISTS recordings_recordist_idx ON recordings (recordist)");
+    schema.push_back("CREATE INDEX IF NOT EXISTS identifications_species_idx ON identifications (\"species-id\")");
+    schema.push_back("CREATE INDEX IF NOT EXISTS identifications_recording_idx ON identifications (\"recording-id\")");
+    // prefix lookups for location name completion, see LocationIndex
+    schema.push_back("CREATE INDEX IF NOT EXISTS locations_name_idx ON locations (name COLLATE NOCASE)");
+
+    // the triggers are replaced rather than kept, so that changes to them
+    // take effect when the schema is installed again
+    for (guint i = 0; i < G_N_ELEMENTS(stats_triggers); ++i) {
+        schema.push_back(Glib::ustring::compose("DROP TRIGGER IF EXISTS %1", stats_triggers[i]));
+    }
+    schema.push_back(Glib::ustring::compose(
+        "CREATE TRIGGER recordings_stats_insert AFTER INSERT ON recordings "
+        "BEGIN %1 END",
+        recording_groups_add("NEW")));
+    schema.push_back(Glib::ustring::compose(
+        "CREATE TRIGGER recordings_stats_delete AFTER DELETE ON recordings "
+        "BEGIN %1 END",
+        recording_groups_remove("OLD")));
+    schema.push_back(Glib::ustring::compose(
+        "CREATE TRIGGER recordings_stats_update AFTER UPDATE OF "
+        "duration, quality, date, \"location-id\", recordist ON recordings "
+        "BEGIN %1%2 END",
+        recording_groups_remove("OLD"),
+        recording_groups_add("NEW")));
+    schema.push_back(Glib::ustring::compose(
+        "CREATE TRIGGER identifications_stats_insert AFTER INSERT ON identifications "
+        "BEGIN %1 END",
+        identification_add("NEW")));
+    schema.push_back(Glib::ustring::compose(
+        "CREATE TRIGGER identifications_stats_delete AFTER DELETE ON identifications "
+        "BEGIN %1 END",
+        identification_remove("OLD")));
+    // an update that keeps the (species, recording) pair changes nothing
+    schema.push_back(Glib::ustring::compose(
+        "CREATE TRIGGER identifications_stats_update AFTER UPDATE OF "
+        "\"species-id\", \"recording-id\" ON identifications "
+        "WHEN OLD.\"species-id\" IS NOT NEW.\"species-id\" "
+        "OR OLD.\"recording-id\" IS NOT NEW.\"recording-id\" "
+        "BEGIN %1%2 END",
+        identification_remove("OLD"),
+        identification_add("NEW")));
+    return schema;
+}
+
+static std::vector<std::string> row_count_schema()
+{
+    std::vector<std::string> schema;
+    schema.push_back("CREATE TABLE IF NOT EXISTS row_counts (name TEXT PRIMARY KEY, count INTEGER NOT NULL)");
+    for (guint i = 0; i < G_N_ELEMENTS(counted_tables); ++i) {
+        schema.push_back(Glib::ustring::compose(
+            "CREATE TRIGGER IF NOT EXISTS %1_count_insert AFTER INSERT ON %1 "
+            "BEGIN UPDATE row_counts SET count = count + 1 WHERE name = '%1'; END",
+            counted_tables[i]));
+        schema.push_back(Glib::ustring::compose(
+            "CREATE TRIGGER IF NOT EXISTS %1_count_delete AFTER DELETE ON %1 "
+            "BEGIN UPDATE row_counts SET count = count - 1 WHERE name = '%1'; END",
+            counted_tables[i]));
+    }
+    return schema;
+}
+
+static std::vector<std::string> row_count_backfill()
+{
+    std::vector<std::string> backfill;
+    backfill.push_back("DELETE FROM row_counts");
+    for (guint i = 0; i < G_N_ELEMENTS(counted_tables); ++i) {
+        backfill.push_back(Glib::ustring::compose(
+            "INSERT INTO row_counts SELECT '%1', COUNT(*) FROM %1",
+            counted_tables[i]));
+    }
+    return backfill;
+}
+
+// populate the aggregate tables from scratch; only needed when they are first
+// created, after that the triggers keep them up to date
+static std::vector<std::string> stats_backfill()
+{
+    std::vector<std::string> backfill;
+    backfill.push_back("DELETE FROM location_stats");
+    backfill.push_back(Glib::ustring::compose(
+        "INSERT INTO location_stats SELECT r.\"location-id\", %1 FROM recordings r "
+        "GROUP BY r.\"location-id\"",
+        AGGREGATE_COLUMNS));
+    backfill.push_back("DELETE FROM recordist_stats");
+    backfill.push_back(Glib::ustring::compose(
+        "INSERT INTO recordist_stats SELECT r.recordist, %1 FROM recordings r "
+        "WHERE r.recordist IS NOT NULL GROUP BY r.recordist",
+        AGGREGATE_COLUMNS));
+    backfill.push_back("DELETE FROM species_stats");
+    backfill.push_back(Glib::ustring::compose(
+        "INSERT INTO species_stats SELECT i.sid, r.\"location-id\", %1 FROM "
+        "(SELECT DISTINCT \"species-id\" AS sid, \"recording-id\" AS rid FROM identifications) i "
+        "JOIN recordings r ON r.id = i.rid GROUP BY i.sid, r.\"location-id\"",
+        AGGREGATE_COLUMNS));
+    return backfill;
+}
+
+static bool table_exists(GomAdapter* adapter, const char* table, GError** error)
+{
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter",
+                     adapter,
+                     "sql",
+                     "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = ?",
+                     NULL)));
+    GValue name = G_VALUE_INIT;
+    g_value_init(&name, G_TYPE_STRING);
+    g_value_set_static_string(&name, table);
+    gom_command_set_param(command.get(), 0, &name);
+    g_value_unset(&name);
+
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+    GRefPtr<GomCursor> cursor_ref = adoptGRef(cursor);
+
+    return gom_cursor_next(cursor) && gom_cursor_get_column_int64(cursor, 0) > 0;
+}
+
+static bool execute_all(GomAdapter* adapter,
+                        const std::vector<std::string>& statements,
+                        GError** error)
+{
+    for (std::vector<std::string>::const_iterator it = statements.begin();
+         it != statements.end();
+         ++it) {
+        if (!gom_adapter_execute_sql(adapter, it->c_str(), error))
+            return false;
+    }
+    return true;
+}
+
+bool install_stats_schema(GomAdapter* adapter, GError** error)
+{
+    GError* local_error = 0;
+    bool needs_backfill = !table_exists(adapter, "location_stats", &local_error);
+    bool needs_count_backfill = !local_error && !table_exists(adapter, "row_counts", &local_error);
+    if (local_error) {
+        g_propagate_error(error, local_error);
+        return false;
+    }
+
+    if (!gom_adapter_execute_sql(adapter, "BEGIN", error))
+        return false;
+
+    bool ok = execute_all(adapter, stats_schema(), error)
+        && execute_all(adapter, row_count_schema(), error);
+    if (ok && needs_backfill) {
+        g_debug("Populating aggregate statistics tables");
+        ok = execute_all(adapter, stats_backfill(), error);
+    }
+    if (ok && needs_count_backfill) {
+        g_debug("Counting rows");
+        ok = execute_all(adapter, row_count_backfill(), error);
+    }
+
+    if (!ok) {
+        gom_adapter_execute_sql(adapter, "ROLLBACK", NULL);
+        return false;
+    }
+
+    return gom_adapter_execute_sql(adapter, "COMMIT", error);
+}
+
+static const char* stats_query(StatsGrouping grouping)
+{
+    switch (grouping) {
+    case STATS_BY_SPECIES:
+        return "SELECT s.species_id, s.location_id, sp.\"common-name\", l.name, "
+               "s.count, s.total_duration, s.best_quality, s.first_date, s.last_date "
+               "FROM species_stats s "
+               "LEFT JOIN species sp ON sp.id = s.species_id "
+               "LEFT JOIN locations l ON l.id = s.location_id "
+               "ORDER BY s.count DESC";
+    case STATS_BY_LOCATION:
+        return "SELECT s.location_id, 0, l.name, NULL, "
+               "s.count, s.total_duration, s.best_quality, s.first_date, s.last_date "
+               "FROM location_stats s "
+               "LEFT JOIN locations l ON l.id = s.location_id "
+               "ORDER BY s.count DESC";
+    case STATS_BY_RECORDIST:
+        return "SELECT 0, 0, s.recordist, NULL, "
+               "s.count, s.total_duration, s.best_quality, s.first_date, s.last_date "
+               "FROM recordist_stats s "
+               "ORDER BY s.count DESC";
+    }
+    g_assert_not_reached();
+    return 0;
+}
+
+static Glib::ustring cursor_string(GomCursor* cursor, guint column)
+{
+    const char* str = gom_cursor_get_column_string(cursor, column);
+    return str ? Glib::ustring(str) : Glib::ustring();
+}
+
+bool query_stats(GomAdapter* adapter,
+                 StatsGrouping grouping,
+                 StatsVector& stats,
+                 GError** error)
+{
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter",
+                     adapter,
+                     "sql",
+                     stats_query(grouping),
+                     NULL)));
+
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+    GRefPtr<GomCursor> cursor_ref = adoptGRef(cursor);
+
+    stats.clear();
+    while (gom_cursor_next(cursor)) {
+        StatsEntry entry;
+        entry.key_id = gom_cursor_get_column_int64(cursor, 0);
+        entry.location_id = gom_cursor_get_column_int64(cursor, 1);
+        entry.label = cursor_string(cursor, 2);
+        entry.location_label = cursor_string(cursor, 3);
+        entry.count = gom_cursor_get_column_int64(cursor, 4);
+        entry.total_duration = gom_cursor_get_column_double(cursor, 5);
+        entry.best_quality = gom_cursor_get_column_int(cursor, 6);
+        entry.first_date = cursor_string(cursor, 7);
+        entry.last_date = cursor_string(cursor, 8);
+        stats.push_back(entry);
+    }
+
+    return true;
+}
+
+bool query_row_count(GomAdapter* adapter,
+                     const std::string& table,
+                     gint64& count,
+                     GError** error)
+{
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter",
+                     adapter,
+                     "sql",
+                     "SELECT count FROM row_counts WHERE name = ?",
+                     NULL)));
+    gom_command_set_param_string(command.get(), 0, table.c_str());
+
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+    GRefPtr<GomCursor> cursor_ref = adoptGRef(cursor);
+
+    count = gom_cursor_next(cursor) ? gom_cursor_get_column_int64(cursor, 0) : -1;
+    return true;
+}
+}
@@ -0,0 +1,74 @@
+/*
+ * collection-stats.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COLLECTION_STATS_H
+#define _COLLECTION_STATS_H
+
+#include <glibmm.h>
+#include <gom/gom.h>
+#include <string>
+#include <vector>
+
+namespace SC {
+
+// bump whenever the tables or triggers created by install_stats_schema() change
+static const int STATS_SCHEMA_VERSION = 4;
+
+enum StatsGrouping {
+    STATS_BY_SPECIES,
+    STATS_BY_LOCATION,
+    STATS_BY_RECORDIST
+};
+
+// One row of a materialized aggregate table. For STATS_BY_SPECIES, each entry
+// is a (species, location) pair; for the other groupings location_id is 0.
+struct StatsEntry {
+    gint64 key_id;
+    gint64 location_id;
+    Glib::ustring label;
+    Glib::ustring location_label;
+    gint64 count;
+    double total_duration;
+    int best_quality;
+    Glib::ustring first_date;
+    Glib::ustring last_date;
+
+    StatsEntry();
+};
+
+typedef std::vector<StatsEntry> StatsVector;
+
+// These must be called from the adapter thread, i.e. from within a
+// gom_adapter_queue_read() / gom_adapter_queue_write() callback.
+bool install_stats_schema(GomAdapter* adapter, GError** error);
+bool query_stats(GomAdapter* adapter,
+                 StatsGrouping grouping,
+                 StatsVector& stats,
+                 GError** error);
+// Reads the number of rows of @table that the triggers installed by
+// install_stats_schema() maintain; @count is -1 for tables that aren't
+// counted
+bool query_row_count(GomAdapter* adapter,
+                     const std::string& table,
+                     gint64& count,
+                     GError** error);
+}
+
+#endif /* _COLLECTION_STATS_H */
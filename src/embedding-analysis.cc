@@ -0,0 +1,75 @@
+/*
+ * embedding-analysis.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glibmm.h>
+
+#include "audio-decoder.h"
+#include "embedding.h"
+#include "embedding-analysis.h"
+
+namespace SC {
+
+struct EmbeddingResult : public AnalysisResult {
+    Embedding embedding;
+};
+
+static bool extract_embedding(const void* data, gsize frames, EmbeddingExtractor* extractor)
+{
+    extractor->process(reinterpret_cast<const float*>(data), frames);
+    return true;
+}
+
+const char* EmbeddingAnalysis::name() const
+{
+    return "embedding";
+}
+
+int EmbeddingAnalysis::version() const
+{
+    return 1;
+}
+
+AnalysisResult* EmbeddingAnalysis::analyze(const std::string& path, GError** error) const
+{
+    AudioDecoder decoder(path, AudioDecoder::FORMAT_F32, 1, EMBEDDING_RATE);
+    EmbeddingExtractor extractor;
+    if (!decoder.decode(0, -1, sigc::bind(sigc::ptr_fun(&extract_embedding), &extractor), error))
+        return 0;
+
+    EmbeddingResult* result = new EmbeddingResult();
+    result->embedding = extractor.finish();
+    return result;
+}
+
+bool EmbeddingAnalysis::store(GomAdapter* adapter,
+                              gint64 recording_id,
+                              const AnalysisResult* result,
+                              GError** error) const
+{
+    const Embedding& embedding = static_cast<const EmbeddingResult*>(result)->embedding;
+    // both values are generated here, so they can go into the statement as
+    // literals; gom has no way to bind a blob
+    std::string sql = Glib::ustring::compose("INSERT OR REPLACE INTO \"embeddings\" "
+                                             "(\"recording_id\", \"vector\") VALUES (%1, X'%2')",
+                                             recording_id,
+                                             embedding_to_hex(embedding));
+    return gom_adapter_execute_sql(adapter, sql.c_str(), error);
+}
+}
@@ -0,0 +1,41 @@
+/*
+ * embedding-analysis.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EMBEDDING_ANALYSIS_H
+#define _EMBEDDING_ANALYSIS_H
+
+#include "analysis.h"
+
+namespace SC {
+// Stores an EmbeddingExtractor summary of each recording in the embeddings
+// table, which the similarity index is built from
+class EmbeddingAnalysis : public Analysis {
+public:
+    virtual const char* name() const;
+    virtual int version() const;
+    virtual AnalysisResult* analyze(const std::string& path, GError** error) const;
+    virtual bool store(GomAdapter* adapter,
+                       gint64 recording_id,
+                       const AnalysisResult* result,
+                       GError** error) const;
+};
+}
+
+#endif /* _EMBEDDING_ANALYSIS_H */
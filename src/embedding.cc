@@ -0,0 +1,341 @@
+/*
+ * embedding.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "embedding.h"
+#include "GRefPtr.h"
+#include "similarity-index.h"
+#include "spectrum.h"
+
+namespace SC {
+
+static const guint FRAME_SIZE = 1024;
+static const guint HOP_SIZE = FRAME_SIZE / 2;
+static const guint MEL_BANDS = 40;
+static const guint MFCCS = 20;
+static const double MEL_LOW = 100;
+static const double MEL_HIGH = 10000;
+// frames quieter than this don't describe the recording, only its silences
+static const float MIN_FRAME_ENERGY = 1e-4f;
+static const guint FEATURES = MFCCS + 2;
+// rebuild instead of adding once the index holds this many times the
+// vectors its centroids were trained on
+static const guint RETRAIN_FACTOR = 2;
+
+static double hz_to_mel(double hz)
+{
+    return 2595.0 * std::log10(1.0 + hz / 700.0);
+}
+
+static double mel_to_hz(double mel)
+{
+    return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0);
+}
+
+struct EmbeddingExtractor::Priv {
+    Spectrum spectrum;
+    std::vector<float> pending;
+    // MEL_BANDS rows of triangular filter weights over the spectrum bins
+    std::vector<float> filters;
+    // MFCCS rows of DCT-II coefficients, skipping c0 so that the embedding
+    // doesn't depend on the recording level
+    std::vector<float> dct;
+    std::vector<float> bands;
+    std::vector<double> sum;
+    std::vector<double> sum_squares;
+    guint64 frames;
+
+    Priv()
+        : spectrum(FRAME_SIZE)
+        , filters(MEL_BANDS * (FRAME_SIZE / 2 + 1), 0.0f)
+        , dct(MFCCS * MEL_BANDS)
+        , bands(MEL_BANDS)
+        , sum(FEATURES, 0.0)
+        , sum_squares(FEATURES, 0.0)
+        , frames(0)
+    {
+        guint bins = FRAME_SIZE / 2 + 1;
+        double low = hz_to_mel(MEL_LOW);
+        double high = hz_to_mel(std::min(MEL_HIGH, EMBEDDING_RATE / 2.0));
+        std::vector<double> edges(MEL_BANDS + 2);
+        for (guint i = 0; i < edges.size(); ++i)
+            edges[i] = mel_to_hz(low + (high - low) * i / (MEL_BANDS + 1));
+        for (guint band = 0; band < MEL_BANDS; ++band) {
+            for (guint bin = 0; bin < bins; ++bin) {
+                double freq = Spectrum::bin_frequency(bin, FRAME_SIZE, EMBEDDING_RATE);
+                double weight = 0;
+                if (freq > edges[band] && freq <= edges[band + 1])
+                    weight = (freq - edges[band]) / (edges[band + 1] - edges[band]);
+                else if (freq > edges[band + 1] && freq < edges[band + 2])
+                    weight = (edges[band + 2] - freq) / (edges[band + 2] - edges[band + 1]);
+                filters[band * bins + bin] = weight;
+            }
+        }
+        for (guint c = 0; c < MFCCS; ++c) {
+            for (guint band = 0; band < MEL_BANDS; ++band)
+                dct[c * MEL_BANDS + band] = std::cos(G_PI * (c + 1) * (band + 0.5) / MEL_BANDS);
+        }
+    }
+
+    void add_feature(guint index, double value)
+    {
+        sum[index] += value;
+        sum_squares[index] += value * value;
+    }
+
+    void analyze_frame(const float* frame)
+    {
+        const float* magnitudes = spectrum.compute(frame);
+        guint bins = FRAME_SIZE / 2 + 1;
+
+        float energy = 0;
+        float weighted = 0;
+        float log_sum = 0;
+        for (guint bin = 1; bin < bins; ++bin) {
+            float power = magnitudes[bin] * magnitudes[bin];
+            energy += power;
+            weighted += power * bin;
+            log_sum += std::log(power + 1e-12f);
+        }
+        if (energy < MIN_FRAME_ENERGY)
+            return;
+
+        for (guint band = 0; band < MEL_BANDS; ++band) {
+            const float* weights = &filters[band * bins];
+            float total = 0;
+            for (guint bin = 0; bin < bins; ++bin)
+                total += weights[bin] * magnitudes[bin] * magnitudes[bin];
+            bands[band] = std::log(total + 1e-10f);
+        }
+        for (guint c = 0; c < MFCCS; ++c) {
+            const float* coefficients = &dct[c * MEL_BANDS];
+            float mfcc = 0;
+            for (guint band = 0; band < MEL_BANDS; ++band)
+                mfcc += coefficients[band] * bands[band];
+            add_feature(c, mfcc);
+        }
+
+        // centroid as a fraction of the spectrum, flatness as the ratio of
+        // the geometric to the arithmetic mean of the power spectrum
+        add_feature(MFCCS, weighted / energy / bins);
+        add_feature(MFCCS + 1, std::exp(log_sum / (bins - 1)) / (energy / (bins - 1)));
+        frames++;
+    }
+};
+
+EmbeddingExtractor::EmbeddingExtractor()
+    : m_priv(new Priv())
+{
+}
+
+void EmbeddingExtractor::process(const float* samples, gsize n_samples)
+{
+    std::vector<float>& pending = m_priv->pending;
+    pending.insert(pending.end(), samples, samples + n_samples);
+
+    gsize offset = 0;
+    while (pending.size() - offset >= FRAME_SIZE) {
+        m_priv->analyze_frame(&pending[offset]);
+        offset += HOP_SIZE;
+    }
+    pending.erase(pending.begin(), pending.begin() + offset);
+}
+
+Embedding EmbeddingExtractor::finish()
+{
+    Embedding embedding(EMBEDDING_SIZE, 0.0f);
+    guint64 n = m_priv->frames;
+    if (!n)
+        return embedding;
+    for (guint i = 0; i < FEATURES; ++i) {
+        double mean = m_priv->sum[i] / n;
+        double variance = m_priv->sum_squares[i] / n - mean * mean;
+        embedding[i] = mean;
+        embedding[FEATURES + i] = variance > 0 ? std::sqrt(variance) : 0;
+    }
+    return embedding;
+}
+
+std::string embedding_to_hex(const Embedding& embedding)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    const guint8* bytes = reinterpret_cast<const guint8*>(&embedding[0]);
+    std::string hex;
+    hex.reserve(embedding.size() * sizeof(float) * 2);
+    for (gsize i = 0; i < embedding.size() * sizeof(float); ++i) {
+        hex += digits[bytes[i] >> 4];
+        hex += digits[bytes[i] & 0xf];
+    }
+    return hex;
+}
+
+bool embedding_from_hex(const char* hex, Embedding& embedding)
+{
+    if (!hex || strlen(hex) != EMBEDDING_SIZE * sizeof(float) * 2)
+        return false;
+    embedding.resize(EMBEDDING_SIZE);
+    guint8* bytes = reinterpret_cast<guint8*>(&embedding[0]);
+    for (gsize i = 0; i < EMBEDDING_SIZE * sizeof(float); ++i) {
+        int high = g_ascii_xdigit_value(hex[2 * i]);
+        int low = g_ascii_xdigit_value(hex[2 * i + 1]);
+        if (high < 0 || low < 0)
+            return false;
+        bytes[i] = (high << 4) | low;
+    }
+    return true;
+}
+
+bool query_embedding(GomAdapter* adapter,
+                     gint64 recording_id,
+                     Embedding& embedding,
+                     GError** error)
+{
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "SELECT hex(\"vector\") FROM \"embeddings\" WHERE \"recording_id\" = ?",
+                     NULL)));
+    gom_command_set_param_int64(command.get(), 0, recording_id);
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+    // a recording that wasn't analyzed yet just has no embedding
+    embedding.clear();
+    if (gom_cursor_next(cursor) && !embedding_from_hex(gom_cursor_get_column_string(cursor, 0), embedding))
+        embedding.clear();
+    g_object_unref(cursor);
+    return true;
+}
+
+// reads the embeddings with a rowid above @after_rowid
+static bool read_embeddings(GomAdapter* adapter,
+                            gint64 after_rowid,
+                            std::vector<gint64>& ids,
+                            std::vector<float>& vectors,
+                            gint64* max_rowid,
+                            GError** error)
+{
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "SELECT \"rowid\", \"recording_id\", hex(\"vector\") FROM \"embeddings\" "
+                            "WHERE \"rowid\" > ? ORDER BY \"rowid\"",
+                     NULL)));
+    gom_command_set_param_int64(command.get(), 0, after_rowid);
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+    Embedding embedding;
+    while (gom_cursor_next(cursor)) {
+        *max_rowid = std::max(*max_rowid, gom_cursor_get_column_int64(cursor, 0));
+        if (!embedding_from_hex(gom_cursor_get_column_string(cursor, 2), embedding))
+            continue;
+        ids.push_back(gom_cursor_get_column_int64(cursor, 1));
+        vectors.insert(vectors.end(), embedding.begin(), embedding.end());
+    }
+    g_object_unref(cursor);
+    return true;
+}
+
+static bool count_embeddings(GomAdapter* adapter, gint64* count, gint64* max_rowid, GError** error)
+{
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "SELECT COUNT(*), IFNULL(MAX(\"rowid\"), 0) FROM \"embeddings\"",
+                     NULL)));
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+    *count = 0;
+    *max_rowid = 0;
+    if (gom_cursor_next(cursor)) {
+        *count = gom_cursor_get_column_int64(cursor, 0);
+        *max_rowid = gom_cursor_get_column_int64(cursor, 1);
+    }
+    g_object_unref(cursor);
+    return true;
+}
+
+static bool rebuild_index(GomAdapter* adapter, SimilarityIndex& index, GError** error)
+{
+    std::vector<gint64> ids;
+    std::vector<float> vectors;
+    gint64 max_rowid = 0;
+    if (!read_embeddings(adapter, 0, ids, vectors, &max_rowid, error))
+        return false;
+    g_debug("building similarity index from %" G_GSIZE_FORMAT " embeddings", ids.size());
+    index.build(ids, vectors);
+    index.set_last_rowid(max_rowid);
+    return true;
+}
+
+bool update_similarity_index(GomAdapter* adapter,
+                             SimilarityIndex& index,
+                             const std::string& path,
+                             GError** error)
+{
+    gint64 count = 0;
+    gint64 max_rowid = 0;
+    if (!count_embeddings(adapter, &count, &max_rowid, error))
+        return false;
+    if (!index.size() && count && g_file_test(path.c_str(), G_FILE_TEST_EXISTS)) {
+        GError* load_error = 0;
+        if (!index.load(path, &load_error)) {
+            g_warning("Unable to load similarity index: %s", load_error->message);
+            g_error_free(load_error);
+        }
+    }
+    if (index.last_rowid() == max_rowid && index.size() == count)
+        return true;
+
+    // analyzing new recordings only appends rows; re-analyzed ones get a new
+    // rowid, and removed ones leave the count short of the index size
+    std::vector<gint64> ids;
+    std::vector<float> vectors;
+    gint64 last_rowid = index.last_rowid();
+    if (!read_embeddings(adapter, last_rowid, ids, vectors, &last_rowid, error))
+        return false;
+    bool rebuild = !index.trained_size()
+                   || index.size() + ids.size() != static_cast<guint64>(count)
+                   || count > static_cast<gint64>(RETRAIN_FACTOR * index.trained_size());
+    for (guint i = 0; !rebuild && i < ids.size(); ++i)
+        rebuild = index.contains(ids[i]);
+
+    if (rebuild) {
+        if (!rebuild_index(adapter, index, error))
+            return false;
+    } else {
+        for (guint i = 0; i < ids.size(); ++i)
+            index.add(ids[i], &vectors[i * EMBEDDING_SIZE]);
+        index.set_last_rowid(last_rowid);
+    }
+
+    GError* save_error = 0;
+    if (!index.save(path, &save_error)) {
+        g_warning("Unable to save similarity index: %s", save_error->message);
+        g_error_free(save_error);
+    }
+    return true;
+}
+}
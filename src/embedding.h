@@ -0,0 +1,74 @@
+/*
+ * embedding.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EMBEDDING_H
+#define _EMBEDDING_H
+
+#include <glib.h>
+#include <gom/gom.h>
+#include <string>
+#include <tr1/memory>
+#include <vector>
+
+namespace SC {
+
+// embeddings are computed from mono audio resampled to this rate
+static const int EMBEDDING_RATE = 22050;
+// mean and standard deviation of 20 MFCCs, spectral centroid and flatness
+static const guint EMBEDDING_SIZE = 44;
+
+typedef std::vector<float> Embedding;
+
+// Summarizes the timbre of a recording in a fixed size vector, so that
+// recordings that sound alike are close to each other
+class EmbeddingExtractor {
+public:
+    EmbeddingExtractor();
+
+    // @samples is mono audio at EMBEDDING_RATE
+    void process(const float* samples, gsize n_samples);
+    // an all-zero embedding if the recording had no audible frames
+    Embedding finish();
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+
+class SimilarityIndex;
+
+// embeddings are stored as blobs and passed around SQL as hex strings
+std::string embedding_to_hex(const Embedding& embedding);
+bool embedding_from_hex(const char* hex, Embedding& embedding);
+
+// These must be called from the adapter thread
+bool query_embedding(GomAdapter* adapter,
+                     gint64 recording_id,
+                     Embedding& embedding,
+                     GError** error);
+// Brings @index up to date with the embeddings table, adding new rows or
+// rebuilding it when rows were replaced, and saves it to @path if it changed
+bool update_similarity_index(GomAdapter* adapter,
+                             SimilarityIndex& index,
+                             const std::string& path,
+                             GError** error);
+}
+
+#endif /* _EMBEDDING_H */
@@ -19,6 +19,7 @@
  */
 
 #include "equipment-resource.h"
+#include "resource-dirty.h"
 
 #define SC_EQUIPMENT_RESOURCE_GET_PRIVATE(object) \
     (G_TYPE_INSTANCE_GET_PRIVATE(                 \
@@ -57,6 +58,8 @@ static void sc_equipment_resource_set_property(GObject* obj,
 {
     ScEquipmentResource* self = SC_EQUIPMENT_RESOURCE(obj);
 
+    sc_resource_track_change(obj, pspec, value);
+
     switch (property_id) {
     case PROP_ID:
         self->priv->id = g_value_get_int64(value);
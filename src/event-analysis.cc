@@ -0,0 +1,116 @@
+/*
+ * event-analysis.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <tr1/memory>
+
+#include "annotation-resource.h"
+#include "audio-decoder.h"
+#include "event-analysis.h"
+#include "event-detector.h"
+#include "GRefPtr.h"
+
+namespace SC {
+
+static const char* SOURCE = "energy-detector";
+
+struct EventResult : public AnalysisResult {
+    EventVector events;
+};
+
+struct DetectionState {
+    AudioDecoder* decoder;
+    std::tr1::shared_ptr<EventDetector> detector;
+};
+
+static bool detect_events(const void* data, gsize frames, DetectionState* state)
+{
+    // the rate is only known once decoding started
+    if (!state->detector.get())
+        state->detector.reset(new EventDetector(state->decoder->rate()));
+    state->detector->process(reinterpret_cast<const float*>(data), frames);
+    return true;
+}
+
+const char* EventAnalysis::name() const
+{
+    return SOURCE;
+}
+
+int EventAnalysis::version() const
+{
+    return 2;
+}
+
+GType EventAnalysis::resource_type() const
+{
+    return SC_TYPE_ANNOTATION_RESOURCE;
+}
+
+AnalysisResult* EventAnalysis::analyze(const std::string& path, GError** error) const
+{
+    AudioDecoder decoder(path, AudioDecoder::FORMAT_F32, 1);
+    DetectionState state;
+    state.decoder = &decoder;
+    if (!decoder.decode(0, -1, sigc::bind(sigc::ptr_fun(&detect_events), &state), error))
+        return 0;
+
+    EventResult* result = new EventResult();
+    if (state.detector.get())
+        result->events = state.detector->finish();
+    return result;
+}
+
+bool EventAnalysis::store(GomAdapter* adapter,
+                          gint64 recording_id,
+                          const AnalysisResult* result,
+                          GError** error) const
+{
+    const EventResult* events = static_cast<const EventResult*>(result);
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "DELETE FROM \"annotations\" WHERE \"recording-id\" = ? AND \"source\" = ?",
+                     NULL)));
+    gom_command_set_param_int64(command.get(), 0, recording_id);
+    gom_command_set_param_string(command.get(), 1, SOURCE);
+    if (!gom_command_execute(command.get(), NULL, error))
+        return false;
+
+    for (EventVector::const_iterator it = events->events.begin(); it != events->events.end(); ++it) {
+        command = adoptGRef(GOM_COMMAND(
+            g_object_new(GOM_TYPE_COMMAND,
+                         "adapter", adapter,
+                         "sql", "INSERT INTO \"annotations\" "
+                                "(\"recording-id\", \"start\", \"end\", \"low-freq\", \"high-freq\", \"score\", \"source\") "
+                                "VALUES (?, ?, ?, ?, ?, ?, ?)",
+                         NULL)));
+        gom_command_set_param_int64(command.get(), 0, recording_id);
+        gom_command_set_param_double(command.get(), 1, it->start);
+        gom_command_set_param_double(command.get(), 2, it->end);
+        gom_command_set_param_double(command.get(), 3, it->low_freq);
+        gom_command_set_param_double(command.get(), 4, it->high_freq);
+        gom_command_set_param_double(command.get(), 5, it->score);
+        gom_command_set_param_string(command.get(), 6, SOURCE);
+        if (!gom_command_execute(command.get(), NULL, error))
+            return false;
+    }
+    return true;
+}
+}
@@ -0,0 +1,42 @@
+/*
+ * event-analysis.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EVENT_ANALYSIS_H
+#define _EVENT_ANALYSIS_H
+
+#include "analysis.h"
+
+namespace SC {
+// Runs the EventDetector over a recording and stores the events it finds as
+// annotations with the source "energy-detector"
+class EventAnalysis : public Analysis {
+public:
+    virtual const char* name() const;
+    virtual int version() const;
+    virtual GType resource_type() const;
+    virtual AnalysisResult* analyze(const std::string& path, GError** error) const;
+    virtual bool store(GomAdapter* adapter,
+                       gint64 recording_id,
+                       const AnalysisResult* result,
+                       GError** error) const;
+};
+}
+
+#endif /* _EVENT_ANALYSIS_H */
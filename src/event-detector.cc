@@ -0,0 +1,194 @@
+/*
+ * event-detector.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "event-detector.h"
+#include "spectrum.h"
+
+namespace SC {
+
+static const guint FRAME_SIZE = 1024;
+static const guint HOP_SIZE = FRAME_SIZE / 2;
+// an event starts this far above the noise floor and ends when it drops
+// back below the lower threshold
+static const float ON_THRESHOLD_DB = 9.0f;
+static const float OFF_THRESHOLD_DB = 6.0f;
+// spectral flux this many times its running average also starts an event
+static const float FLUX_FACTOR = 4.0f;
+// the floor follows drops quickly but rises slowly, so that long events
+// don't raise it; during events it rises slower still, but does rise, so a
+// lasting change of the background eventually stops counting as an event
+static const float FLOOR_FALL = 0.5f;
+static const float FLOOR_RISE = 0.002f;
+static const float FLOOR_RISE_ACTIVE = 0.0005f;
+static const double MIN_EVENT = 0.05;
+// longer events are closed and the floor is reset to the current level;
+// calls don't last this long, a new background does
+static const double MAX_EVENT = 20.0;
+static const double MERGE_GAP = 0.1;
+// bins within this many dB of the loudest one define the event's band
+static const float BAND_RANGE_DB = 20.0f;
+
+struct EventDetector::Priv {
+    int rate;
+    Spectrum spectrum;
+    guint low_bin;
+    guint high_bin;
+    std::vector<float> pending;
+    std::vector<float> previous;
+    guint64 frame_index;
+    bool have_floor;
+    float floor_db;
+    float mean_flux;
+    bool active;
+    DetectedEvent current;
+    EventVector events;
+
+    Priv(int rate, double low_freq, double high_freq)
+        : rate(rate)
+        , spectrum(FRAME_SIZE)
+        , low_bin(std::min<guint>(low_freq * FRAME_SIZE / rate, FRAME_SIZE / 2))
+        , high_bin(std::min<guint>(high_freq * FRAME_SIZE / rate, FRAME_SIZE / 2))
+        , previous(FRAME_SIZE / 2 + 1, 0.0f)
+        , frame_index(0)
+        , have_floor(false)
+        , floor_db(0)
+        , mean_flux(0)
+        , active(false)
+    {
+        if (high_bin <= low_bin)
+            high_bin = std::min(low_bin + 1, FRAME_SIZE / 2);
+    }
+
+    double frame_time(guint64 index) const
+    {
+        return static_cast<double>(index * HOP_SIZE) / rate;
+    }
+
+    void analyze_frame(const float* frame)
+    {
+        const float* magnitudes = spectrum.compute(frame);
+        const float* prev = &previous[0];
+
+        // band energy, spectral flux and the loudest bin in one pass
+        float energy = 0;
+        float flux = 0;
+        float peak = 0;
+        for (guint i = low_bin; i <= high_bin; ++i) {
+            float m = magnitudes[i];
+            float rise = m - prev[i];
+            energy += m * m;
+            flux += rise > 0 ? rise : 0;
+            peak = m > peak ? m : peak;
+        }
+        std::copy(magnitudes, magnitudes + FRAME_SIZE / 2 + 1, previous.begin());
+
+        float db = 10.0f * std::log10(energy + 1e-12f);
+        if (!have_floor) {
+            floor_db = db;
+            mean_flux = flux;
+            have_floor = true;
+        }
+
+        float above = db - floor_db;
+        bool onset = flux > FLUX_FACTOR * mean_flux && above > OFF_THRESHOLD_DB;
+        if (!active && (above > ON_THRESHOLD_DB || onset)) {
+            active = true;
+            current.start = frame_time(frame_index);
+            current.low_freq = G_MAXDOUBLE;
+            current.high_freq = 0;
+            current.score = 0;
+        } else if (active && above < OFF_THRESHOLD_DB) {
+            close_event();
+        } else if (active && frame_time(frame_index) - current.start > MAX_EVENT) {
+            close_event();
+            floor_db = db;
+        }
+
+        if (active) {
+            current.end = frame_time(frame_index) + static_cast<double>(FRAME_SIZE) / rate;
+            current.score = std::max<double>(current.score, above);
+            float limit = peak * std::pow(10.0f, -BAND_RANGE_DB / 20.0f);
+            for (guint i = low_bin; i <= high_bin; ++i) {
+                if (magnitudes[i] >= limit) {
+                    double freq = Spectrum::bin_frequency(i, FRAME_SIZE, rate);
+                    current.low_freq = std::min(current.low_freq, freq);
+                    current.high_freq = std::max(current.high_freq, freq);
+                }
+            }
+            floor_db += (db - floor_db) * FLOOR_RISE_ACTIVE;
+        } else {
+            // flux is only learned outside of events
+            float rate_db = db < floor_db ? FLOOR_FALL : FLOOR_RISE;
+            floor_db += (db - floor_db) * rate_db;
+            mean_flux += (flux - mean_flux) * 0.05f;
+        }
+        frame_index++;
+    }
+
+    void close_event()
+    {
+        active = false;
+        if (!events.empty() && current.start - events.back().end < MERGE_GAP) {
+            DetectedEvent& last = events.back();
+            last.end = current.end;
+            last.low_freq = std::min(last.low_freq, current.low_freq);
+            last.high_freq = std::max(last.high_freq, current.high_freq);
+            last.score = std::max(last.score, current.score);
+        } else {
+            events.push_back(current);
+        }
+    }
+};
+
+EventDetector::EventDetector(int rate, double low_freq, double high_freq)
+    : m_priv(new Priv(rate, low_freq, high_freq))
+{
+}
+
+void EventDetector::process(const float* samples, gsize n_samples)
+{
+    std::vector<float>& pending = m_priv->pending;
+    pending.insert(pending.end(), samples, samples + n_samples);
+
+    gsize offset = 0;
+    while (pending.size() - offset >= FRAME_SIZE) {
+        m_priv->analyze_frame(&pending[offset]);
+        offset += HOP_SIZE;
+    }
+    pending.erase(pending.begin(), pending.begin() + offset);
+}
+
+EventVector EventDetector::finish()
+{
+    if (m_priv->active)
+        m_priv->close_event();
+
+    EventVector events;
+    for (EventVector::const_iterator it = m_priv->events.begin(); it != m_priv->events.end(); ++it) {
+        if (it->end - it->start >= MIN_EVENT)
+            events.push_back(*it);
+    }
+    m_priv->events.clear();
+    return events;
+}
+}
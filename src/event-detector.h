@@ -0,0 +1,62 @@
+/*
+ * event-detector.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EVENT_DETECTOR_H
+#define _EVENT_DETECTOR_H
+
+#include <glib.h>
+#include <tr1/memory>
+#include <vector>
+
+namespace SC {
+
+struct DetectedEvent {
+    // seconds from the start of the recording
+    double start;
+    double end;
+    // Hz
+    double low_freq;
+    double high_freq;
+    // loudest point of the event, in dB above the noise floor
+    double score;
+};
+
+typedef std::vector<DetectedEvent> EventVector;
+
+// Finds the parts of a recording that stand out from the background: frames
+// whose energy in the frequency band of interest rises well above an
+// adaptive noise floor, or whose spectrum changes abruptly (spectral flux).
+// Samples are fed in blocks, so recordings never need to fit in memory.
+class EventDetector {
+public:
+    EventDetector(int rate, double low_freq = 1000, double high_freq = 12000);
+
+    // @samples is mono audio at the rate given to the constructor
+    void process(const float* samples, gsize n_samples);
+    // flushes the last event and returns all of them, merged and filtered
+    EventVector finish();
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _EVENT_DETECTOR_H */
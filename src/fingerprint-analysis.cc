@@ -0,0 +1,97 @@
+/*
+ * fingerprint-analysis.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "audio-decoder.h"
+#include "fingerprint.h"
+#include "fingerprint-analysis.h"
+#include "GRefPtr.h"
+
+namespace SC {
+
+// rows per INSERT statement; a recording has hundreds of landmarks per second
+static const guint INSERT_BATCH = 500;
+
+struct FingerprintResult : public AnalysisResult {
+    LandmarkVector landmarks;
+};
+
+static bool fingerprint_samples(const void* data, gsize frames, Fingerprinter* fingerprinter)
+{
+    fingerprinter->process(reinterpret_cast<const float*>(data), frames);
+    return true;
+}
+
+const char* FingerprintAnalysis::name() const
+{
+    return "fingerprint";
+}
+
+int FingerprintAnalysis::version() const
+{
+    return 2;
+}
+
+AnalysisResult* FingerprintAnalysis::analyze(const std::string& path, GError** error) const
+{
+    AudioDecoder decoder(path, AudioDecoder::FORMAT_F32, 1, FINGERPRINT_RATE);
+    Fingerprinter fingerprinter;
+    if (!decoder.decode(0, -1, sigc::bind(sigc::ptr_fun(&fingerprint_samples), &fingerprinter), error))
+        return 0;
+
+    FingerprintResult* result = new FingerprintResult();
+    result->landmarks = fingerprinter.finish();
+    return result;
+}
+
+bool FingerprintAnalysis::store(GomAdapter* adapter,
+                                gint64 recording_id,
+                                const AnalysisResult* result,
+                                GError** error) const
+{
+    const LandmarkVector& landmarks = static_cast<const FingerprintResult*>(result)->landmarks;
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "DELETE FROM \"fingerprints\" WHERE \"recording_id\" = ?",
+                     NULL)));
+    gom_command_set_param_int64(command.get(), 0, recording_id);
+    if (!gom_command_execute(command.get(), NULL, error))
+        return false;
+
+    // all values are integers, so they can go into the statement directly
+    // and a long recording doesn't need a prepared statement per landmark
+    for (gsize start = 0; start < landmarks.size(); start += INSERT_BATCH) {
+        gsize end = std::min<gsize>(start + INSERT_BATCH, landmarks.size());
+        std::ostringstream sql;
+        sql << "INSERT INTO \"fingerprints\" (\"hash\", \"recording_id\", \"offset\") VALUES ";
+        for (gsize i = start; i < end; ++i) {
+            if (i != start)
+                sql << ", ";
+            sql << "(" << landmarks[i].hash << ", " << recording_id << ", " << landmarks[i].offset << ")";
+        }
+        if (!gom_adapter_execute_sql(adapter, sql.str().c_str(), error))
+            return false;
+    }
+    return true;
+}
+}
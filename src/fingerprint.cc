@@ -0,0 +1,263 @@
+/*
+ * fingerprint.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <set>
+
+#include "fingerprint.h"
+#include "GRefPtr.h"
+#include "spectrum.h"
+
+namespace SC {
+
+static const guint FRAME_SIZE = 1024;
+static const guint HOP_SIZE = FRAME_SIZE / 2;
+// bins below ~200Hz are mostly wind and handling noise; the hash has room
+// for 9 bits of frequency
+static const guint MIN_BIN = 10;
+static const guint MAX_BIN = 511;
+static const guint PEAKS_PER_FRAME = 5;
+static const float MIN_MAGNITUDE = 1e-2f;
+// a peak masks later peaks in the neighbouring bins until its envelope
+// decayed below them
+static const float ENVELOPE_DECAY = 0.97f;
+static const int ENVELOPE_SPREAD = 8;
+// limits of the target zone that anchors are paired with; together with
+// the anchor bin they make a 24 bit hash
+static const guint MAX_DT = 127;
+static const int MAX_DF = 127;
+static const guint FAN_OUT = 3;
+// bounds the landmarks to about 170 per second, however busy the spectrum;
+// dense recordings otherwise flood the index with landmarks of little use
+static const guint LANDMARKS_PER_FRAME = 4;
+// hashes with more postings than this in the whole index are too common to
+// tell recordings apart and are left out of duplicate queries
+static const guint MAX_HASH_POSTINGS = 2000;
+
+struct Peak {
+    guint32 frame;
+    guint bin;
+    float magnitude;
+    guint pairs;
+
+    bool operator<(const Peak& other) const
+    {
+        return magnitude > other.magnitude;
+    }
+};
+
+struct Fingerprinter::Priv {
+    Spectrum spectrum;
+    std::vector<float> pending;
+    std::vector<float> envelope;
+    std::vector<float> spread;
+    std::vector<Peak> candidates;
+    std::deque<Peak> recent;
+    guint32 frame_index;
+    LandmarkVector landmarks;
+
+    Priv()
+        : spectrum(FRAME_SIZE)
+        , envelope(FRAME_SIZE / 2 + 1, 0.0f)
+        , spread(2 * ENVELOPE_SPREAD + 1)
+        , frame_index(0)
+    {
+        for (int d = -ENVELOPE_SPREAD; d <= ENVELOPE_SPREAD; ++d) {
+            double x = d / (ENVELOPE_SPREAD / 2.0);
+            spread[d + ENVELOPE_SPREAD] = std::exp(-0.5 * x * x);
+        }
+    }
+
+    void find_peaks(const float* magnitudes)
+    {
+        candidates.clear();
+        float* env = &envelope[0];
+        for (guint i = MIN_BIN; i < MAX_BIN; ++i) {
+            float m = magnitudes[i];
+            if (m > MIN_MAGNITUDE && m > env[i]
+                && m > magnitudes[i - 1] && m >= magnitudes[i + 1]) {
+                Peak peak = { frame_index, i, m, 0 };
+                candidates.push_back(peak);
+            }
+        }
+        if (candidates.size() > PEAKS_PER_FRAME) {
+            std::partial_sort(candidates.begin(),
+                              candidates.begin() + PEAKS_PER_FRAME,
+                              candidates.end());
+            candidates.resize(PEAKS_PER_FRAME);
+        } else {
+            std::sort(candidates.begin(), candidates.end());
+        }
+
+        for (guint i = 0; i < envelope.size(); ++i)
+            env[i] *= ENVELOPE_DECAY;
+        for (std::vector<Peak>::const_iterator it = candidates.begin(); it != candidates.end(); ++it) {
+            int low = std::max<int>(0, it->bin - ENVELOPE_SPREAD);
+            int high = std::min<int>(envelope.size() - 1, it->bin + ENVELOPE_SPREAD);
+            for (int i = low; i <= high; ++i)
+                env[i] = std::max(env[i], it->magnitude * spread[i - it->bin + ENVELOPE_SPREAD]);
+        }
+    }
+
+    // pairs the earlier peaks in the target zone with this frame's peaks,
+    // nearest targets first. Anchors about to leave the zone go first, so
+    // that the frame's budget doesn't starve them.
+    void pair_peaks()
+    {
+        while (!recent.empty() && frame_index - recent.front().frame > MAX_DT)
+            recent.pop_front();
+
+        guint budget = LANDMARKS_PER_FRAME;
+        for (std::deque<Peak>::iterator anchor = recent.begin(); anchor != recent.end() && budget; ++anchor) {
+            guint dt = frame_index - anchor->frame;
+            for (std::vector<Peak>::const_iterator target = candidates.begin();
+                 target != candidates.end() && anchor->pairs < FAN_OUT && budget;
+                 ++target) {
+                int df = static_cast<int>(target->bin) - static_cast<int>(anchor->bin);
+                if (df < -MAX_DF || df > MAX_DF)
+                    continue;
+                Landmark landmark;
+                landmark.hash = (anchor->bin << 15) | ((df + MAX_DF) << 7) | dt;
+                landmark.offset = anchor->frame;
+                landmarks.push_back(landmark);
+                anchor->pairs++;
+                budget--;
+            }
+        }
+        recent.insert(recent.end(), candidates.begin(), candidates.end());
+    }
+
+    void analyze_frame(const float* frame)
+    {
+        find_peaks(spectrum.compute(frame));
+        pair_peaks();
+        frame_index++;
+    }
+};
+
+Fingerprinter::Fingerprinter()
+    : m_priv(new Priv())
+{
+}
+
+void Fingerprinter::process(const float* samples, gsize n_samples)
+{
+    std::vector<float>& pending = m_priv->pending;
+    pending.insert(pending.end(), samples, samples + n_samples);
+
+    gsize offset = 0;
+    while (pending.size() - offset >= FRAME_SIZE) {
+        m_priv->analyze_frame(&pending[offset]);
+        offset += HOP_SIZE;
+    }
+    pending.erase(pending.begin(), pending.begin() + offset);
+}
+
+LandmarkVector Fingerprinter::finish()
+{
+    LandmarkVector landmarks;
+    landmarks.swap(m_priv->landmarks);
+    return landmarks;
+}
+
+double Fingerprinter::frame_duration()
+{
+    return static_cast<double>(HOP_SIZE) / FINGERPRINT_RATE;
+}
+
+// only landmarks whose hash isn't stop-listed count, both here and in the
+// matches, so that a recording made of common sounds can still score 1
+static bool count_landmarks(GomAdapter* adapter, gint64 recording_id, gint64* count, GError** error)
+{
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "SELECT COUNT(*) FROM \"fingerprints\" "
+                            "JOIN \"fingerprint_hashes\" USING (\"hash\") "
+                            "WHERE \"recording_id\" = ? AND \"postings\" <= ?",
+                     NULL)));
+    gom_command_set_param_int64(command.get(), 0, recording_id);
+    gom_command_set_param_uint(command.get(), 1, MAX_HASH_POSTINGS);
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+    *count = gom_cursor_next(cursor) ? gom_cursor_get_column_int64(cursor, 0) : 0;
+    g_object_unref(cursor);
+    return true;
+}
+
+bool query_duplicates(GomAdapter* adapter,
+                      gint64 recording_id,
+                      guint min_matches,
+                      DuplicateVector& duplicates,
+                      GError** error)
+{
+    gint64 total = 0;
+    if (!count_landmarks(adapter, recording_id, &total, error))
+        return false;
+    if (!total)
+        return true;
+
+    // Every landmark of the query is looked up in the hash index; copies of
+    // the same audio line up at a constant offset difference, chance matches
+    // don't. The posting counts keep frequent hashes out before the join, so
+    // no landmark visits more than MAX_HASH_POSTINGS rows.
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "SELECT \"b\".\"recording_id\", "
+                            "\"b\".\"offset\" - \"a\".\"offset\" AS \"delta\", "
+                            "COUNT(*) AS \"matches\" "
+                            "FROM \"fingerprints\" AS \"a\" "
+                            "JOIN \"fingerprint_hashes\" AS \"h\" ON \"h\".\"hash\" = \"a\".\"hash\" "
+                            "JOIN \"fingerprints\" AS \"b\" ON \"b\".\"hash\" = \"a\".\"hash\" "
+                            "WHERE \"a\".\"recording_id\" = ? AND \"h\".\"postings\" <= ? "
+                            "AND \"b\".\"recording_id\" != ? "
+                            "GROUP BY \"b\".\"recording_id\", \"delta\" "
+                            "HAVING \"matches\" >= ? "
+                            "ORDER BY \"matches\" DESC",
+                     NULL)));
+    gom_command_set_param_int64(command.get(), 0, recording_id);
+    gom_command_set_param_uint(command.get(), 1, MAX_HASH_POSTINGS);
+    gom_command_set_param_int64(command.get(), 2, recording_id);
+    gom_command_set_param_uint(command.get(), 3, min_matches);
+
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+
+    // only the best alignment of each recording is reported
+    std::set<gint64> seen;
+    while (gom_cursor_next(cursor)) {
+        DuplicateMatch match;
+        match.recording_id = gom_cursor_get_column_int64(cursor, 0);
+        if (!seen.insert(match.recording_id).second)
+            continue;
+        match.offset = gom_cursor_get_column_int64(cursor, 1) * Fingerprinter::frame_duration();
+        match.matches = gom_cursor_get_column_int64(cursor, 2);
+        match.score = std::min(1.0, static_cast<double>(match.matches) / total);
+        duplicates.push_back(match);
+    }
+    g_object_unref(cursor);
+    return true;
+}
+}
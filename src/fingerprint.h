@@ -0,0 +1,81 @@
+/*
+ * fingerprint.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FINGERPRINT_H
+#define _FINGERPRINT_H
+
+#include <glib.h>
+#include <gom/gom.h>
+#include <tr1/memory>
+#include <vector>
+
+namespace SC {
+
+// fingerprints are computed from mono audio resampled to this rate
+static const int FINGERPRINT_RATE = 22050;
+
+// A pair of spectral peaks, hashed by their frequencies and distance in
+// time. The hash doesn't depend on the codec or the absolute position, so
+// transcoded or trimmed copies of a recording share most of their landmarks.
+struct Landmark {
+    guint32 hash;
+    // frame of the first peak
+    guint32 offset;
+};
+
+typedef std::vector<Landmark> LandmarkVector;
+
+class Fingerprinter {
+public:
+    Fingerprinter();
+
+    // @samples is mono audio at FINGERPRINT_RATE
+    void process(const float* samples, gsize n_samples);
+    LandmarkVector finish();
+
+    // duration of one landmark offset step in seconds
+    static double frame_duration();
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+
+struct DuplicateMatch {
+    gint64 recording_id;
+    // position of the query recording's start within the matching one
+    double offset;
+    guint matches;
+    // fraction of the query recording's landmarks that matched
+    double score;
+};
+
+typedef std::vector<DuplicateMatch> DuplicateVector;
+
+// Must be called from the adapter thread. Finds recordings that share at
+// least @min_matches time-aligned landmarks with @recording_id, best first.
+bool query_duplicates(GomAdapter* adapter,
+                      gint64 recording_id,
+                      guint min_matches,
+                      DuplicateVector& duplicates,
+                      GError** error);
+}
+
+#endif /* _FINGERPRINT_H */
@@ -0,0 +1,209 @@
+/*
+ * flac-archive.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include "audio-decoder.h"
+#include "flac-archive.h"
+#include "media-init.h"
+
+namespace SC {
+
+static const char* PCM_EXTENSIONS[] = { ".wav", ".wave", ".aif", ".aiff", ".aifc" };
+
+bool flac_can_archive(const std::string& path)
+{
+    gchar* lower = g_ascii_strdown(path.c_str(), -1);
+    bool pcm = false;
+    for (guint i = 0; i < G_N_ELEMENTS(PCM_EXTENSIONS) && !pcm; ++i)
+        pcm = g_str_has_suffix(lower, PCM_EXTENSIONS[i]);
+    g_free(lower);
+    return pcm;
+}
+
+std::string flac_archive_path(const std::string& source)
+{
+    std::string::size_type dot = source.rfind('.');
+    std::string::size_type slash = source.rfind(G_DIR_SEPARATOR);
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return source + ".flac";
+    return source.substr(0, dot) + ".flac";
+}
+
+static void link_audio_pad(GstElement* decodebin, GstPad* pad, GstElement* convert)
+{
+    GstPad* sink = gst_element_get_static_pad(convert, "sink");
+    GstCaps* caps = gst_pad_query_caps(pad, NULL);
+    const gchar* name = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+    if (g_str_has_prefix(name, "audio/") && !gst_pad_is_linked(sink))
+        gst_pad_link(pad, sink);
+    gst_caps_unref(caps);
+    gst_object_unref(sink);
+}
+
+// The decoder's tag events reach flacenc, which writes them as Vorbis
+// comments. audioconvert only changes the sample layout where flacenc needs
+// it (e.g. packed 24 bit to 24 in 32), which doesn't lose precision for
+// integer samples.
+static bool encode(const std::string& source, const std::string& dest, GError** error)
+{
+    GstElement* pipeline = gst_pipeline_new(NULL);
+    GstElement* decode = gst_element_factory_make("uridecodebin", NULL);
+    GstElement* convert = gst_element_factory_make("audioconvert", NULL);
+    GstElement* encoder = gst_element_factory_make("flacenc", NULL);
+    GstElement* sink = gst_element_factory_make("filesink", NULL);
+    if (!decode || !convert || !encoder || !sink) {
+        g_set_error(error, GST_CORE_ERROR, GST_CORE_ERROR_MISSING_PLUGIN,
+                    "Unable to create FLAC encoding pipeline");
+        gst_object_unref(pipeline);
+        return false;
+    }
+
+    gchar* uri = g_filename_to_uri(source.c_str(), NULL, NULL);
+    g_object_set(decode, "uri", uri, NULL);
+    g_free(uri);
+    g_object_set(sink, "location", dest.c_str(), NULL);
+    g_signal_connect(decode, "pad-added", G_CALLBACK(link_audio_pad), convert);
+    gst_bin_add_many(GST_BIN(pipeline), decode, convert, encoder, sink, NULL);
+    gst_element_link_many(convert, encoder, sink, NULL);
+
+    bool success = true;
+    GstBus* bus = gst_element_get_bus(pipeline);
+    if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+        success = false;
+    GstMessage* message = gst_bus_timed_pop_filtered(
+        bus,
+        success ? GST_CLOCK_TIME_NONE : 0,
+        GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    if (message && GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR) {
+        GError* gst_error = 0;
+        gst_message_parse_error(message, &gst_error, NULL);
+        g_propagate_error(error, gst_error);
+        success = false;
+    }
+    if (message)
+        gst_message_unref(message);
+    if (!success && error && !*error)
+        g_set_error(error, GST_STREAM_ERROR, GST_STREAM_ERROR_ENCODE,
+                    "Unable to encode %s", source.c_str());
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(bus);
+    gst_object_unref(pipeline);
+    return success;
+}
+
+struct SampleChecksum {
+    AudioDecoder decoder;
+    GChecksum* checksum;
+    int channels;
+
+    SampleChecksum(const std::string& path)
+        : decoder(path, AudioDecoder::FORMAT_S32)
+        , checksum(g_checksum_new(G_CHECKSUM_SHA256))
+        , channels(0)
+    {
+    }
+
+    ~SampleChecksum()
+    {
+        g_checksum_free(checksum);
+    }
+
+    bool compute(GError** error)
+    {
+        return decoder.decode(0, -1, sigc::mem_fun(this, &SampleChecksum::consume), error);
+    }
+
+    bool consume(const void* data, gsize frames)
+    {
+        channels = decoder.channels();
+        g_checksum_update(checksum, reinterpret_cast<const guchar*>(data), frames * channels * sizeof(gint32));
+        return true;
+    }
+
+    std::string digest() const
+    {
+        // identical samples at a different rate or layout aren't the same
+        return Glib::ustring::compose("%1/%2/%3",
+                                      decoder.rate(),
+                                      decoder.channels(),
+                                      g_checksum_get_string(checksum));
+    }
+};
+
+// Decoded to 32 bit integers, so that 16 and 24 bit samples are compared
+// exactly and anything wider than FLAC can store shows up as a difference
+static bool samples_match(const std::string& source, const std::string& dest, GError** error)
+{
+    SampleChecksum original(source);
+    SampleChecksum archived(dest);
+    if (!original.compute(error) || !archived.compute(error))
+        return false;
+    if (original.digest() != archived.digest()) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s can't be archived without loss", source.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool flac_archive(const std::string& source, const std::string& dest, GError** error)
+{
+    media_ensure_initialized();
+    if (g_file_test(dest.c_str(), G_FILE_TEST_EXISTS)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_EXISTS, "%s already exists", dest.c_str());
+        return false;
+    }
+
+    // only appears under its final name once it has been verified
+    std::string partial = dest + ".part";
+    if (!encode(source, partial, error) || !samples_match(source, partial, error)) {
+        g_unlink(partial.c_str());
+        return false;
+    }
+
+    GFile* source_file = g_file_new_for_path(source.c_str());
+    GFile* partial_file = g_file_new_for_path(partial.c_str());
+    GError* attribute_error = 0;
+    bool success = g_file_copy_attributes(source_file,
+                                          partial_file,
+                                          G_FILE_COPY_ALL_METADATA,
+                                          NULL,
+                                          &attribute_error);
+    if (!success) {
+        // keep the original rather than lose its timestamps
+        g_propagate_error(error, attribute_error);
+    } else if (g_rename(partial.c_str(), dest.c_str()) != 0) {
+        int saved_errno = errno;
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                    "Unable to rename %s: %s", partial.c_str(), g_strerror(saved_errno));
+        success = false;
+    }
+    if (!success)
+        g_unlink(partial.c_str());
+    g_object_unref(source_file);
+    g_object_unref(partial_file);
+    return success;
+}
+}
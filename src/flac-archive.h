@@ -0,0 +1,43 @@
+/*
+ * flac-archive.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLAC_ARCHIVE_H
+#define _FLAC_ARCHIVE_H
+
+#include <glib.h>
+#include <string>
+
+namespace SC {
+
+// true if @path is an uncompressed PCM container that is worth archiving
+bool flac_can_archive(const std::string& path);
+
+// The path @source is archived to: the same name with a .flac extension
+std::string flac_archive_path(const std::string& source);
+
+// Losslessly compresses @source into a FLAC file at @dest, keeping its tags
+// and file timestamps. Both files are decoded afterwards and their samples
+// compared; if they differ (e.g. because @source has floating point samples)
+// @dest is removed and G_IO_ERROR_INVALID_DATA is returned. Synchronous, so
+// it is meant to be used from a worker thread.
+bool flac_archive(const std::string& source, const std::string& dest, GError** error);
+}
+
+#endif /* _FLAC_ARCHIVE_H */
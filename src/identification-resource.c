@@ -21,6 +21,7 @@
 #include <glib.h>
 
 #include "identification-resource.h"
+#include "resource-dirty.h"
 
 #define SC_IDENTIFICATION_RESOURCE_GET_PRIVATE(object)            \
     (G_TYPE_INSTANCE_GET_PRIVATE((object),                        \
@@ -64,6 +65,8 @@ static void sc_identification_resource_set_property(GObject* obj,
 {
     ScIdentificationResource* self = SC_IDENTIFICATION_RESOURCE(obj);
 
+    sc_resource_track_change(obj, pspec, value);
+
     switch (property_id) {
     case PROP_ID:
         self->priv->id = g_value_get_int64(value);
@@ -0,0 +1,945 @@
+/*
+ * keyset-pager.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <map>
+#include <set>
+
+#include "collection-stats.h"
+#include "GRefPtr.h"
+#include "keyset-pager.h"
+#include "read-pool.h"
+#include "task.h"
+
+namespace SC {
+
+/*
+ * gom_resource_group_fetch_async() reads a page with LIMIT/OFFSET, which makes
+ * SQLite step over every row before the requested one, so scrolling to the
+ * bottom of a large collection gets slower the larger it is. Instead, the
+ * pager remembers the (sort key, id) of the last row of every page and reads
+ * a page with
+ *
+ *   WHERE sort > :key OR (sort = :key AND id > :id) ORDER BY sort, id LIMIT n
+ *
+ * which is a single seek on an index over the sort column (or the primary
+ * key). The anchors are collected by one pass over the keys when the pager is
+ * built, which doesn't read any of the other columns.
+ *
+ * A page of resources is then read with a second query by id, since gom can
+ * only hydrate resources itself. A page of projected rows is read by the
+ * keyset query directly.
+ *
+ * An unfiltered pager takes its row count from the row_counts table, so it is
+ * ready without reading the table at all, and scans the keys for the anchors
+ * in the background. Pages that are needed before the scan is done are read
+ * with an OFFSET instead.
+ */
+
+const guint KeysetPager::PAGE_SIZE;
+const guint KeysetPager::MIN_RESIDENT_PAGES;
+
+static const gsize DEFAULT_MEMORY_BUDGET = 4 * 1024 * 1024;
+// what gom and the property values of a hydrated resource take on top of
+// its instance, roughly
+static const gsize RESOURCE_OVERHEAD = 512;
+
+// the key of the last row of a page; the following page starts after it
+struct Anchor {
+    Glib::ValueBase sort;
+    gint64 id;
+};
+
+typedef std::vector<Anchor> AnchorVector;
+typedef std::vector<GRefPtr<GomResource> > ResourceVector;
+
+// only one of the vectors is used, depending on whether the pager projects
+struct Page {
+    ResourceVector resources;
+    std::vector<ProjectedRow> rows;
+    gsize bytes;
+    // position in KeysetPager::Priv::lru
+    std::list<guint>::iterator lru_position;
+
+    Page()
+        : bytes(0)
+    {
+    }
+
+    guint size() const
+    {
+        return std::max(resources.size(), rows.size());
+    }
+};
+
+static GArray* value_array_new()
+{
+    GArray* values = g_array_new(FALSE, TRUE, sizeof(GValue));
+    g_array_set_clear_func(values, reinterpret_cast<GDestroyNotify>(g_value_unset));
+    return values;
+}
+
+static void value_array_append(GArray* values, const GValue* value)
+{
+    GValue copy = G_VALUE_INIT;
+    g_value_init(&copy, G_VALUE_TYPE(value));
+    g_value_copy(value, &copy);
+    g_array_append_val(values, copy);
+}
+
+static gsize default_memory_budget()
+{
+    std::string budget = Glib::getenv("SC_MODEL_MEMORY_BUDGET");
+    if (budget.empty())
+        return DEFAULT_MEMORY_BUDGET;
+    return g_ascii_strtoull(budget.c_str(), NULL, 10) * 1024;
+}
+
+static gsize projected_row_size(const ProjectedRow& row)
+{
+    gsize size = sizeof(ProjectedRow) + row.size() * sizeof(Glib::ValueBase);
+    for (ProjectedRow::const_iterator it = row.begin(); it != row.end(); ++it) {
+        if (G_VALUE_HOLDS_STRING(it->gobj()) && g_value_get_string(it->gobj()))
+            size += strlen(g_value_get_string(it->gobj())) + 1;
+    }
+    return size;
+}
+
+static void value_array_append_int64(GArray* values, gint64 v)
+{
+    GValue value = G_VALUE_INIT;
+    g_value_init(&value, G_TYPE_INT64);
+    g_value_set_int64(&value, v);
+    g_array_append_val(values, value);
+}
+
+// types that gom_cursor_get_column() can read into an anchor or a projected
+// column
+static bool is_scalar(GType type)
+{
+    return type == G_TYPE_BOOLEAN || type == G_TYPE_INT || type == G_TYPE_UINT
+        || type == G_TYPE_INT64 || type == G_TYPE_UINT64 || type == G_TYPE_FLOAT
+        || type == G_TYPE_DOUBLE || type == G_TYPE_STRING;
+}
+
+struct KeysetPager::Priv {
+    GRefPtr<GomRepository> repository;
+    GType resource_type;
+    std::string table;
+    std::string primary_key;
+    // equal to primary_key when ordering by the primary key only
+    std::string sort_column;
+    GType sort_type;
+    // sorted by this SQL expression instead of the sort column if set
+    std::string sort_expression;
+    // the projected columns, starting with the primary key; empty when
+    // fetching resources
+    std::vector<std::string> columns;
+    std::vector<GType> column_types;
+    std::string filter_sql;
+    GArray* filter_values;
+    // Everything above is immutable once constructed and may be read from the
+    // adapter thread; the rest is only touched in the main thread.
+    guint count;
+    AnchorVector anchors; // anchors[p - 1] precedes page p
+    std::map<guint, Page> pages;
+    // the loaded pages, most recently used first
+    mutable std::list<guint> lru;
+    gsize memory_budget;
+    gsize memory_used;
+    std::set<guint> pending;
+    sigc::signal<void, guint, guint> signal_rows_loaded;
+
+    Priv(GomRepository* repository,
+         GType resource_type,
+         GomFilter* filter,
+         const std::string& sort,
+         const std::vector<std::string>& projection)
+        : repository(repository)
+        , resource_type(resource_type)
+        , sort_type(G_TYPE_INT64)
+        , filter_values(value_array_new())
+        , count(0)
+        , memory_budget(default_memory_budget())
+        , memory_used(0)
+    {
+        GomResourceClass* klass = GOM_RESOURCE_CLASS(g_type_class_ref(resource_type));
+        table = klass->table;
+        primary_key = klass->primary_key;
+        sort_column = primary_key;
+        if (!sort.empty() && sort != primary_key) {
+            GParamSpec* pspec = g_object_class_find_property(G_OBJECT_CLASS(klass), sort.c_str());
+            if (pspec && is_scalar(G_PARAM_SPEC_VALUE_TYPE(pspec))) {
+                sort_column = sort;
+                sort_type = G_PARAM_SPEC_VALUE_TYPE(pspec);
+            } else
+                g_warning("Cannot sort %s by '%s'", g_type_name(resource_type), sort.c_str());
+        }
+        if (!projection.empty()) {
+            columns.push_back(primary_key);
+            column_types.push_back(G_TYPE_INT64);
+        }
+        for (std::vector<std::string>::const_iterator it = projection.begin(); it != projection.end(); ++it) {
+            GParamSpec* pspec = g_object_class_find_property(G_OBJECT_CLASS(klass), it->c_str());
+            if (!pspec || !is_scalar(G_PARAM_SPEC_VALUE_TYPE(pspec))) {
+                g_warning("Cannot project '%s' of %s", it->c_str(), g_type_name(resource_type));
+                continue;
+            }
+            columns.push_back(*it);
+            column_types.push_back(G_PARAM_SPEC_VALUE_TYPE(pspec));
+        }
+        g_type_class_unref(klass);
+
+        if (filter) {
+            gchar* sql = gom_filter_get_sql(filter, NULL);
+            filter_sql = sql;
+            g_free(sql);
+
+            GArray* values = gom_filter_get_values(filter);
+            for (guint i = 0; values && i < values->len; ++i)
+                value_array_append(filter_values, &g_array_index(values, GValue, i));
+            if (values)
+                g_array_unref(values);
+        }
+    }
+
+    ~Priv()
+    {
+        g_array_unref(filter_values);
+    }
+
+    bool projected() const
+    {
+        return !columns.empty();
+    }
+
+    bool by_primary_key() const
+    {
+        return sort_expression.empty() && sort_column == primary_key;
+    }
+
+    std::string sort_key() const
+    {
+        return sort_expression.empty() ? column(sort_column) : sort_expression;
+    }
+
+    std::string column(const std::string& name) const
+    {
+        return Glib::ustring::compose("\"%1\".\"%2\"", table, name);
+    }
+
+    std::string order_by() const
+    {
+        if (by_primary_key())
+            return column(primary_key);
+        return sort_key() + ", " + column(primary_key);
+    }
+
+    // Returns a condition selecting the rows from the start of @page on,
+    // after skipping @skip rows, and appends the values it binds to @values
+    std::string rows_from_page(guint page, GArray* values, guint& skip) const
+    {
+        skip = 0;
+        std::string where;
+        if (!filter_sql.empty()) {
+            where = "(" + filter_sql + ")";
+            for (guint i = 0; i < filter_values->len; ++i)
+                value_array_append(values, &g_array_index(filter_values, GValue, i));
+        }
+        // the adapter thread only ever asks for page 0, which doesn't need
+        // the anchors
+        if (page > 0 && page > anchors.size()) {
+            // not anchored yet
+            skip = page * PAGE_SIZE;
+        } else if (page > 0) {
+            if (!where.empty())
+                where += " AND ";
+            where += after_anchor(anchors[page - 1], values);
+        }
+        return where.empty() ? "1" : where;
+    }
+
+    // Returns a condition selecting the rows of @page as it was when the
+    // anchors were collected, by the keys that bound it; only pages that are
+    // followed by an anchor have an upper bound
+    std::string rows_of_page(guint page, GArray* values) const
+    {
+        guint skip = 0;
+        std::string where = rows_from_page(page, values, skip);
+        g_assert(page < anchors.size() && !skip);
+        return where + " AND NOT " + after_anchor(anchors[page], values);
+    }
+
+    std::string after_anchor(const Anchor& anchor, GArray* values) const
+    {
+        std::string where;
+        if (by_primary_key()) {
+            where = Glib::ustring::compose("%1 > ?", column(primary_key));
+        } else {
+            where = Glib::ustring::compose("(%1 > ? OR (%1 = ? AND %2 > ?))",
+                                           sort_key(),
+                                           column(primary_key));
+            value_array_append(values, anchor.sort.gobj());
+            value_array_append(values, anchor.sort.gobj());
+        }
+        value_array_append_int64(values, anchor.id);
+        return where;
+    }
+
+    std::string select_list() const
+    {
+        if (!projected())
+            return column(primary_key);
+        std::string list;
+        for (std::vector<std::string>::const_iterator it = columns.begin(); it != columns.end(); ++it) {
+            if (!list.empty())
+                list += ", ";
+            list += column(*it);
+        }
+        return list;
+    }
+
+    void touch(const Page& page) const
+    {
+        lru.splice(lru.begin(), lru, page.lru_position);
+    }
+
+    gsize page_bytes(const Page& page) const
+    {
+        gsize bytes = 0;
+        for (std::vector<ProjectedRow>::const_iterator it = page.rows.begin(); it != page.rows.end(); ++it)
+            bytes += projected_row_size(*it);
+        if (!page.resources.empty()) {
+            GTypeQuery query;
+            g_type_query(resource_type, &query);
+            bytes += page.resources.size() * (query.instance_size + RESOURCE_OVERHEAD);
+        }
+        return bytes;
+    }
+
+    // drops the least recently used pages until the budget is met
+    void evict()
+    {
+        while (memory_used > memory_budget && lru.size() > MIN_RESIDENT_PAGES) {
+            std::map<guint, Page>::iterator it = pages.find(lru.back());
+            g_debug("%s: evicting page %u", table.c_str(), it->first);
+            memory_used -= it->second.bytes;
+            lru.pop_back();
+            pages.erase(it);
+        }
+    }
+
+    guint page_rows(guint page) const
+    {
+        guint first = page * PAGE_SIZE;
+        return first < count ? std::min(PAGE_SIZE, count - first) : 0;
+    }
+};
+
+static GomCursor* execute_query(GomAdapter* adapter,
+                                const std::string& sql,
+                                GArray* values,
+                                GError** error)
+{
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND, "adapter", adapter, "sql", sql.c_str(), NULL)));
+    for (guint i = 0; i < values->len; ++i)
+        gom_command_set_param(command.get(), i, &g_array_index(values, GValue, i));
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return 0;
+    return cursor;
+}
+
+struct BuildTask : public Task {
+    std::tr1::shared_ptr<KeysetPager::Priv> priv;
+    guint count;
+    AnchorVector anchors;
+    // true if the count was cached and the anchors still need to be scanned
+    bool counted;
+
+    BuildTask(const std::tr1::shared_ptr<KeysetPager::Priv>& priv,
+              const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , priv(priv)
+        , count(0)
+        , counted(false)
+    {
+    }
+};
+
+// must be called from the adapter thread
+static bool scan_keys(GomAdapter* adapter,
+                      const KeysetPager::Priv& priv,
+                      guint& count,
+                      AnchorVector& anchors,
+                      GError** error)
+{
+    GArray* values = value_array_new();
+    guint skip = 0;
+    std::string sql = Glib::ustring::compose("SELECT %1, %2 FROM \"%3\" WHERE %4 ORDER BY %5",
+                                             priv.sort_key(),
+                                             priv.column(priv.primary_key),
+                                             priv.table,
+                                             priv.rows_from_page(0, values, skip),
+                                             priv.order_by());
+    GomCursor* cursor = execute_query(adapter, sql, values, error);
+    g_array_unref(values);
+    if (!cursor)
+        return false;
+
+    count = 0;
+    while (gom_cursor_next(cursor)) {
+        if (++count % KeysetPager::PAGE_SIZE)
+            continue;
+        Anchor anchor;
+        anchor.sort.init(priv.sort_type);
+        gom_cursor_get_column(cursor, 0, anchor.sort.gobj());
+        anchor.id = gom_cursor_get_column_int64(cursor, 1);
+        anchors.push_back(anchor);
+    }
+    g_object_unref(cursor);
+    return true;
+}
+
+// runs in the adapter thread
+static void build_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    BuildTask* task = reinterpret_cast<BuildTask*>(user_data);
+    const KeysetPager::Priv& priv = *task->priv;
+    GError* error = 0;
+    if (priv.filter_sql.empty()) {
+        gint64 count = -1;
+        if (!query_row_count(adapter, priv.table, count, &error)) {
+            g_task_return_error(task->task(), error);
+            return;
+        }
+        if (count >= 0) {
+            task->count = count;
+            task->counted = true;
+            g_task_return_boolean(task->task(), true);
+            return;
+        }
+    }
+
+    if (!scan_keys(adapter, priv, task->count, task->anchors, &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    g_task_return_boolean(task->task(), true);
+}
+
+// runs in the adapter thread
+static void scan_anchors_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    BuildTask* task = reinterpret_cast<BuildTask*>(user_data);
+    GError* error = 0;
+    if (!scan_keys(adapter, *task->priv, task->count, task->anchors, &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    g_task_return_boolean(task->task(), true);
+}
+
+static void anchors_scanned(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    BuildTask* task = reinterpret_cast<BuildTask*>(g_task_get_task_data(gtask));
+    if (!g_task_propagate_boolean(gtask, &error)) {
+        // pages will keep being read with OFFSET
+        g_warning("Failed to scan the keys of %s: %s", task->priv->table.c_str(), error->message);
+        g_error_free(error);
+        return;
+    }
+    if (task->count != task->priv->count)
+        g_debug("%s: %u rows were counted but %u scanned", task->priv->table.c_str(), task->priv->count, task->count);
+    task->priv->anchors.swap(task->anchors);
+}
+
+KeysetPager::KeysetPager(GomRepository* repository,
+                         GType resource_type,
+                         GomFilter* filter,
+                         const std::string& sort_column,
+                         const std::vector<std::string>& columns)
+    : m_priv(new Priv(repository, resource_type, filter, sort_column, columns))
+{
+}
+
+KeysetPager::KeysetPager(GomRepository* repository,
+                         GType resource_type,
+                         const std::vector<gint64>& ids,
+                         const std::vector<std::string>& columns)
+{
+    std::string list;
+    std::string ranks;
+    for (guint i = 0; i < ids.size(); ++i) {
+        if (i)
+            list += ", ";
+        list += Glib::ustring::format(ids[i]);
+        ranks += Glib::ustring::compose(" WHEN %1 THEN %2", ids[i], i);
+    }
+    GomResourceClass* klass = GOM_RESOURCE_CLASS(g_type_class_ref(resource_type));
+    std::string key = Glib::ustring::compose("\"%1\".\"%2\"", klass->table, klass->primary_key);
+    g_type_class_unref(klass);
+
+    std::string sql = Glib::ustring::compose("%1 IN (%2)", key, list.empty() ? "NULL" : list);
+    GRefPtr<GomFilter> filter = adoptGRef(gom_filter_new_sql(sql.c_str(), NULL));
+    m_priv.reset(new Priv(repository, resource_type, filter.get(), std::string(), columns));
+    if (!ids.empty())
+        m_priv->sort_expression = Glib::ustring::compose("(CASE %1%2 END)", key, ranks);
+}
+
+void KeysetPager::build_async(const Gio::SlotAsyncReady& slot)
+{
+    BuildTask* task = new BuildTask(m_priv, slot);
+    ReadPool::get(m_priv->repository.get())->queue_read(build_proxy, task);
+}
+
+void KeysetPager::build_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    BuildTask* task = reinterpret_cast<BuildTask*>(g_task_get_task_data(gtask));
+    g_task_propagate_boolean(gtask, &error);
+    if (error)
+        throw Glib::Error(error);
+
+    m_priv->count = task->count;
+    m_priv->anchors.swap(task->anchors);
+    m_priv->pages.clear();
+    m_priv->lru.clear();
+    m_priv->memory_used = 0;
+    g_debug("%s: %u rows, %zu anchors", m_priv->table.c_str(), m_priv->count, m_priv->anchors.size());
+
+    if (task->counted) {
+        BuildTask* scan = new BuildTask(m_priv, sigc::ptr_fun(&anchors_scanned));
+        ReadPool::get(m_priv->repository.get())->queue_read(scan_anchors_proxy, scan);
+    }
+}
+
+guint KeysetPager::count() const
+{
+    return m_priv->count;
+}
+
+void KeysetPager::set_memory_budget(gsize bytes)
+{
+    m_priv->memory_budget = bytes;
+    m_priv->evict();
+}
+
+gsize KeysetPager::memory_used() const
+{
+    return m_priv->memory_used;
+}
+
+GomResource* KeysetPager::peek(guint row) const
+{
+    std::map<guint, Page>::const_iterator it = m_priv->pages.find(row / PAGE_SIZE);
+    if (it == m_priv->pages.end() || row % PAGE_SIZE >= it->second.resources.size())
+        return 0;
+    m_priv->touch(it->second);
+    return it->second.resources[row % PAGE_SIZE].get();
+}
+
+const ProjectedRow* KeysetPager::peek_row(guint row) const
+{
+    std::map<guint, Page>::const_iterator it = m_priv->pages.find(row / PAGE_SIZE);
+    if (it == m_priv->pages.end() || row % PAGE_SIZE >= it->second.rows.size())
+        return 0;
+    m_priv->touch(it->second);
+    return &it->second.rows[row % PAGE_SIZE];
+}
+
+int KeysetPager::column_index(const std::string& column) const
+{
+    for (guint i = 0; i < m_priv->columns.size(); ++i) {
+        if (m_priv->columns[i] == column)
+            return i;
+    }
+    return -1;
+}
+
+sigc::signal<void, guint, guint>& KeysetPager::signal_rows_loaded()
+{
+    return m_priv->signal_rows_loaded;
+}
+
+void KeysetPager::foreach_loaded(const sigc::slot<void, guint, GomResource*>& slot) const
+{
+    for (std::map<guint, Page>::const_iterator it = m_priv->pages.begin();
+         it != m_priv->pages.end();
+         ++it) {
+        const ResourceVector& resources = it->second.resources;
+        for (guint i = 0; i < resources.size(); ++i) {
+            if (resources[i])
+                slot(it->first * PAGE_SIZE + i, resources[i].get());
+        }
+    }
+}
+
+void KeysetPager::foreach_loaded_row(const sigc::slot<void, guint, ProjectedRow&>& slot)
+{
+    for (std::map<guint, Page>::iterator it = m_priv->pages.begin();
+         it != m_priv->pages.end();
+         ++it) {
+        std::vector<ProjectedRow>& rows = it->second.rows;
+        for (guint i = 0; i < rows.size(); ++i)
+            slot(it->first * PAGE_SIZE + i, rows[i]);
+    }
+}
+
+// Fetching a page of resources takes two steps: the ids of the page are
+// looked up with a keyset query in the adapter thread, then the resources are
+// read by id. Projected rows are read by the first query.
+struct PageTask : public Task {
+    std::tr1::shared_ptr<KeysetPager::Priv> priv;
+    guint page;
+    // built in the main thread, where the anchors live
+    std::string sql;
+    GArray* values;
+    std::vector<gint64> ids;
+    std::vector<ProjectedRow> rows;
+
+    PageTask(const std::tr1::shared_ptr<KeysetPager::Priv>& priv,
+             guint page,
+             const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , priv(priv)
+        , page(page)
+        , values(value_array_new())
+    {
+    }
+
+    ~PageTask()
+    {
+        g_array_unref(values);
+    }
+};
+
+struct PageFetch {
+    std::tr1::shared_ptr<KeysetPager::Priv> priv;
+    guint page;
+    std::vector<gint64> ids;
+    GRefPtr<GomResourceGroup> group;
+};
+
+// runs in the adapter thread
+static void page_query_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    PageTask* task = reinterpret_cast<PageTask*>(user_data);
+    const KeysetPager::Priv& priv = *task->priv;
+    GError* error = 0;
+    GomCursor* cursor = execute_query(adapter, task->sql, task->values, &error);
+    if (!cursor) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    while (gom_cursor_next(cursor)) {
+        if (!priv.projected()) {
+            task->ids.push_back(gom_cursor_get_column_int64(cursor, 0));
+            continue;
+        }
+        task->rows.push_back(ProjectedRow(priv.columns.size()));
+        ProjectedRow& row = task->rows.back();
+        for (guint i = 0; i < priv.columns.size(); ++i) {
+            row[i].init(priv.column_types[i]);
+            gom_cursor_get_column(cursor, i, row[i].gobj());
+        }
+    }
+    g_object_unref(cursor);
+    g_task_return_boolean(task->task(), true);
+}
+
+static void page_done(PageFetch* fetch, Page& contents)
+{
+    KeysetPager::Priv& priv = *fetch->priv;
+    priv.pending.erase(fetch->page);
+    Page& page = priv.pages[fetch->page];
+    page.resources.swap(contents.resources);
+    page.rows.swap(contents.rows);
+    page.bytes = priv.page_bytes(page);
+    priv.lru.push_front(fetch->page);
+    page.lru_position = priv.lru.begin();
+    priv.memory_used += page.bytes;
+    guint first = fetch->page * KeysetPager::PAGE_SIZE;
+    guint rows = std::min(page.size(), priv.page_rows(fetch->page));
+    // the new page is the most recently used one and can't be evicted here
+    priv.evict();
+    if (rows)
+        priv.signal_rows_loaded.emit(first, rows);
+    delete fetch;
+}
+
+static void page_failed(PageFetch* fetch, GError* error)
+{
+    g_warning("Failed to fetch page %u of %s: %s",
+              fetch->page,
+              fetch->priv->table.c_str(),
+              error->message);
+    g_error_free(error);
+    fetch->priv->pending.erase(fetch->page);
+    delete fetch;
+}
+
+static void page_fetched_proxy(GObject* source, GAsyncResult* result, gpointer user_data)
+{
+    PageFetch* fetch = reinterpret_cast<PageFetch*>(user_data);
+    GomResourceGroup* group = GOM_RESOURCE_GROUP(source);
+    GError* error = 0;
+    if (!gom_resource_group_fetch_finish(group, result, &error)) {
+        page_failed(fetch, error);
+        return;
+    }
+
+    // the group is in table order; put the resources back in key order
+    std::map<gint64, GomResource*> by_id;
+    for (guint i = 0; i < gom_resource_group_get_count(group); ++i) {
+        GomResource* resource = gom_resource_group_get_index(group, i);
+        GValue id = G_VALUE_INIT;
+        g_value_init(&id, G_TYPE_INT64);
+        g_object_get_property(G_OBJECT(resource), fetch->priv->primary_key.c_str(), &id);
+        by_id[g_value_get_int64(&id)] = resource;
+        g_value_unset(&id);
+    }
+    Page page;
+    for (std::vector<gint64>::const_iterator it = fetch->ids.begin(); it != fetch->ids.end(); ++it) {
+        std::map<gint64, GomResource*>::const_iterator found = by_id.find(*it);
+        // a row that was deleted in the meantime leaves a gap
+        page.resources.push_back(found != by_id.end() ? found->second : 0);
+    }
+    page_done(fetch, page);
+}
+
+static void page_found_proxy(GObject* source, GAsyncResult* result, gpointer user_data)
+{
+    PageFetch* fetch = reinterpret_cast<PageFetch*>(user_data);
+    GError* error = 0;
+    fetch->group = adoptGRef(gom_repository_find_finish(GOM_REPOSITORY(source), result, &error));
+    if (error) {
+        page_failed(fetch, error);
+        return;
+    }
+    gom_resource_group_fetch_async(fetch->group.get(),
+                                   0,
+                                   gom_resource_group_get_count(fetch->group.get()),
+                                   page_fetched_proxy,
+                                   fetch);
+}
+
+static void page_query_done(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    PageTask* task = reinterpret_cast<PageTask*>(g_task_get_task_data(gtask));
+    PageFetch* fetch = new PageFetch();
+    fetch->priv = task->priv;
+    fetch->page = task->page;
+    fetch->ids.swap(task->ids);
+    if (!g_task_propagate_boolean(gtask, &error)) {
+        page_failed(fetch, error);
+        return;
+    }
+    if (fetch->priv->projected() || fetch->ids.empty()) {
+        Page page;
+        page.rows.swap(task->rows);
+        page_done(fetch, page);
+        return;
+    }
+
+    std::string sql = fetch->priv->column(fetch->priv->primary_key) + " IN (";
+    for (std::vector<gint64>::const_iterator it = fetch->ids.begin(); it != fetch->ids.end(); ++it) {
+        if (it != fetch->ids.begin())
+            sql += ",";
+        sql += Glib::ustring::format(*it);
+    }
+    sql += ")";
+    GRefPtr<GomFilter> filter = adoptGRef(gom_filter_new_sql(sql.c_str(), NULL));
+    gom_repository_find_async(fetch->priv->repository.get(),
+                              fetch->priv->resource_type,
+                              filter.get(),
+                              page_found_proxy,
+                              fetch);
+}
+
+void KeysetPager::fetch(guint row)
+{
+    guint page = row / PAGE_SIZE;
+    if (row >= m_priv->count || m_priv->pages.count(page) || m_priv->pending.count(page))
+        return;
+
+    m_priv->pending.insert(page);
+    PageTask* task = new PageTask(m_priv, page, sigc::ptr_fun(&page_query_done));
+    guint skip = 0;
+    std::string where = m_priv->rows_from_page(page, task->values, skip);
+    task->sql = Glib::ustring::compose("SELECT %1 FROM \"%2\" WHERE %3 ORDER BY %4 LIMIT %5 OFFSET %6",
+                                       m_priv->select_list(),
+                                       m_priv->table,
+                                       where,
+                                       m_priv->order_by(),
+                                       PAGE_SIZE,
+                                       skip);
+    ReadPool::get(m_priv->repository.get())->queue_read(page_query_proxy, task);
+}
+
+// Rows that haven't been fetched yet are matched without reading them where
+// possible: a page that is selected as a whole is matched by the keys of the
+// anchors around it, so rows that were inserted into or deleted from other
+// pages since the pager was built don't change which rows match. The ids of
+// the rows of other unloaded pages are looked up the way the page would be
+// fetched.
+struct RowsFilterTask : public Task {
+    std::tr1::shared_ptr<KeysetPager::Priv> priv;
+    // the condition for the loaded rows and whole pages, and its values
+    std::string sql;
+    GArray* values;
+    std::vector<gint64> loaded_ids;
+    // queries for the ids of the remaining rows, run in the adapter thread
+    std::vector<std::string> lookups;
+    std::vector<GArray*> lookup_values;
+    std::vector<gint64> ids;
+
+    RowsFilterTask(const std::tr1::shared_ptr<KeysetPager::Priv>& priv,
+                   const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , priv(priv)
+        , values(value_array_new())
+    {
+    }
+
+    ~RowsFilterTask()
+    {
+        g_array_unref(values);
+        for (std::vector<GArray*>::iterator it = lookup_values.begin(); it != lookup_values.end(); ++it)
+            g_array_unref(*it);
+    }
+};
+
+// runs in the adapter thread
+static void rows_lookup_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    RowsFilterTask* task = reinterpret_cast<RowsFilterTask*>(user_data);
+    GError* error = 0;
+    for (guint i = 0; i < task->lookups.size(); ++i) {
+        GomCursor* cursor = execute_query(adapter, task->lookups[i], task->lookup_values[i], &error);
+        if (!cursor) {
+            g_task_return_error(task->task(), error);
+            return;
+        }
+        while (gom_cursor_next(cursor))
+            task->ids.push_back(gom_cursor_get_column_int64(cursor, 0));
+        g_object_unref(cursor);
+    }
+    g_task_return_boolean(task->task(), true);
+}
+
+static void append_ids(std::string& sql, const std::string& key, const std::vector<gint64>& ids)
+{
+    if (ids.empty())
+        return;
+    if (!sql.empty())
+        sql += " OR ";
+    sql += key + " IN (";
+    for (std::vector<gint64>::const_iterator it = ids.begin(); it != ids.end(); ++it) {
+        if (it != ids.begin())
+            sql += ",";
+        sql += Glib::ustring::format(*it);
+    }
+    sql += ")";
+}
+
+void KeysetPager::create_filter_for_rows_async(const std::vector<guint>& rows,
+                                               const Gio::SlotAsyncReady& slot) const
+{
+    RowsFilterTask* task = new RowsFilterTask(m_priv, slot);
+    // (first row, number of rows) of runs of unloaded rows within one page
+    std::vector<std::pair<guint, guint> > ranges;
+    for (std::vector<guint>::const_iterator it = rows.begin(); it != rows.end(); ++it) {
+        if (*it >= m_priv->count)
+            continue;
+        GomResource* resource = peek(*it);
+        const ProjectedRow* row = peek_row(*it);
+        if (row) {
+            task->loaded_ids.push_back(g_value_get_int64((*row)[0].gobj()));
+        } else if (resource) {
+            GValue id = G_VALUE_INIT;
+            g_value_init(&id, G_TYPE_INT64);
+            g_object_get_property(G_OBJECT(resource), m_priv->primary_key.c_str(), &id);
+            task->loaded_ids.push_back(g_value_get_int64(&id));
+            g_value_unset(&id);
+        } else if (!ranges.empty()
+                   && ranges.back().first + ranges.back().second == *it
+                   && *it % PAGE_SIZE) {
+            ranges.back().second++;
+        } else {
+            ranges.push_back(std::make_pair(*it, 1u));
+        }
+    }
+
+    std::string key = m_priv->column(m_priv->primary_key);
+    append_ids(task->sql, key, task->loaded_ids);
+    for (std::vector<std::pair<guint, guint> >::const_iterator it = ranges.begin(); it != ranges.end(); ++it) {
+        guint page = it->first / PAGE_SIZE;
+        if (it->second == PAGE_SIZE && page < m_priv->anchors.size()) {
+            if (!task->sql.empty())
+                task->sql += " OR ";
+            task->sql += "(" + m_priv->rows_of_page(page, task->values) + ")";
+            continue;
+        }
+        GArray* values = value_array_new();
+        guint skip = 0;
+        std::string where = m_priv->rows_from_page(page, values, skip);
+        task->lookups.push_back(Glib::ustring::compose("SELECT %1 FROM \"%2\" WHERE %3 ORDER BY %4 LIMIT %5 OFFSET %6",
+                                                       key,
+                                                       m_priv->table,
+                                                       where,
+                                                       m_priv->order_by(),
+                                                       it->second,
+                                                       skip + it->first % PAGE_SIZE));
+        task->lookup_values.push_back(values);
+    }
+
+    if (task->lookups.empty()) {
+        g_task_return_boolean(task->task(), true);
+        return;
+    }
+    ReadPool::get(m_priv->repository.get())->queue_read(rows_lookup_proxy, task);
+}
+
+GomFilter* KeysetPager::create_filter_for_rows_finish(const Glib::RefPtr<Gio::AsyncResult>& result,
+                                                      std::vector<gint64>& loaded_ids) const
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    RowsFilterTask* task = reinterpret_cast<RowsFilterTask*>(g_task_get_task_data(gtask));
+    if (!g_task_propagate_boolean(gtask, &error))
+        throw Glib::Error(error);
+
+    std::string sql = task->sql;
+    append_ids(sql, m_priv->column(m_priv->primary_key), task->ids);
+    if (sql.empty())
+        sql = "0";
+    loaded_ids.insert(loaded_ids.end(), task->loaded_ids.begin(), task->loaded_ids.end());
+    return gom_filter_new_sql(sql.c_str(), task->values);
+}
+}
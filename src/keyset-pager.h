@@ -0,0 +1,113 @@
+/*
+ * keyset-pager.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _KEYSET_PAGER_H
+#define _KEYSET_PAGER_H
+
+#include <giomm.h>
+#include <gom/gom.h>
+#include <string>
+#include <tr1/memory>
+#include <vector>
+
+namespace SC {
+// A read-only copy of the projected columns of one row, in the order they
+// were passed to the KeysetPager; the primary key always comes first
+typedef std::vector<Glib::ValueBase> ProjectedRow;
+
+// Pages through the resources of a table in (sort column, id) order without
+// OFFSET scans. build_async() walks the keys once and remembers the key that
+// precedes every page (a sparse anchor table); a page is then read with an
+// index seek past its anchor, so fetching row N costs the same for any N.
+// The table's primary key must be an integer column.
+//
+// A pager either hydrates full resources or, when given a list of columns,
+// reads only those columns into ProjectedRows, which is much cheaper for
+// views that display a few small columns of each row.
+//
+// Only a bounded number of fetched pages is kept: once they take up more than
+// the memory budget, the least recently used ones are dropped and fetched
+// again when they are needed, so scrolling through a huge table doesn't
+// accumulate all of it in memory.
+class KeysetPager {
+public:
+    static const guint PAGE_SIZE = 64;
+    // pages that are kept regardless of the memory budget
+    static const guint MIN_RESIDENT_PAGES = 4;
+
+    // An empty @sort_column orders by the primary key only. The sort column
+    // must not contain NULLs. @columns are property names of
+    // @resource_type; an empty list fetches resources.
+    KeysetPager(GomRepository* repository,
+                GType resource_type,
+                GomFilter* filter = 0,
+                const std::string& sort_column = std::string(),
+                const std::vector<std::string>& columns = std::vector<std::string>());
+    // Pages the resources with the given ids, in the order of @ids
+    KeysetPager(GomRepository* repository,
+                GType resource_type,
+                const std::vector<gint64>& ids,
+                const std::vector<std::string>& columns = std::vector<std::string>());
+
+    // Without a filter, the row count of tables that the database counts
+    // (see query_row_count()) is used right away and the anchors are
+    // collected in the background.
+    void build_async(const Gio::SlotAsyncReady& slot);
+    void build_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
+
+    // number of rows, valid once built
+    guint count() const;
+    // Defaults to the SC_MODEL_MEMORY_BUDGET environment variable (in KiB)
+    // or 4 MiB. The sizes of the fetched rows are estimated.
+    void set_memory_budget(gsize bytes);
+    gsize memory_used() const;
+    // the resource at @row if its page has been fetched; peeking at a row
+    // marks its page as recently used
+    GomResource* peek(guint row) const;
+    // the projected row at @row if its page has been fetched
+    const ProjectedRow* peek_row(guint row) const;
+    // the index of the property @column in a ProjectedRow, or -1
+    int column_index(const std::string& column) const;
+    // Starts fetching the page containing @row unless it is loaded or
+    // already being fetched
+    void fetch(guint row);
+    // (first row, number of rows) of a page that finished loading
+    sigc::signal<void, guint, guint>& signal_rows_loaded();
+    void foreach_loaded(const sigc::slot<void, guint, GomResource*>& slot) const;
+    // the projected rows may be modified to reflect changes that were
+    // written to the database
+    void foreach_loaded_row(const sigc::slot<void, guint, ProjectedRow&>& slot);
+
+    // Creates a filter matching the resources at @rows (sorted, no
+    // duplicates) without fetching them. The ids of the rows that are
+    // already loaded are returned in @loaded_ids.
+    void create_filter_for_rows_async(const std::vector<guint>& rows,
+                                      const Gio::SlotAsyncReady& slot) const;
+    GomFilter* create_filter_for_rows_finish(const Glib::RefPtr<Gio::AsyncResult>& result,
+                                             std::vector<gint64>& loaded_ids) const;
+
+    struct Priv;
+
+private:
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _KEYSET_PAGER_H */
@@ -0,0 +1,66 @@
+/*
+ * lazy-page.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lazy-page.h"
+
+namespace SC {
+
+struct LazyPage::Priv {
+    SlotCreate create;
+    Gtk::Widget* page;
+
+    Priv(const SlotCreate& create)
+        : create(create)
+        , page(0)
+    {
+    }
+};
+
+LazyPage::LazyPage(const SlotCreate& create)
+    : Gtk::Box(Gtk::ORIENTATION_VERTICAL)
+    , m_priv(new Priv(create))
+{
+}
+
+void LazyPage::ensure_built()
+{
+    if (m_priv->page)
+        return;
+
+    m_priv->page = m_priv->create();
+    // the slot may hold references that aren't needed anymore
+    m_priv->create = SlotCreate();
+    m_priv->page->show();
+    pack_start(*m_priv->page, true, true);
+}
+
+bool LazyPage::is_built() const
+{
+    return m_priv->page != 0;
+}
+
+void LazyPage::on_map()
+{
+    // built before the children are mapped, so that the page is mapped
+    // along with them
+    ensure_built();
+    Gtk::Box::on_map();
+}
+}
@@ -0,0 +1,53 @@
+/*
+ * lazy-page.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LAZY_PAGE_H
+#define _LAZY_PAGE_H
+
+#include <gtkmm.h>
+#include <tr1/memory>
+
+namespace SC {
+// A placeholder for a page of a Gtk::Stack (or any other container that
+// maps only the children it shows) which creates the actual page when it is
+// first shown, so that hidden pages don't build their models and query the
+// database at startup.
+class LazyPage : public Gtk::Box {
+public:
+    // @create returns the page, which is shown and managed by the LazyPage
+    typedef sigc::slot<Gtk::Widget*> SlotCreate;
+
+    LazyPage(const SlotCreate& create);
+
+    // creates the page if that hasn't happened yet, e.g. to prefetch it
+    // before it is shown
+    void ensure_built();
+    bool is_built() const;
+
+protected:
+    virtual void on_map();
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _LAZY_PAGE_H */
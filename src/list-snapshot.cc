@@ -0,0 +1,321 @@
+/*
+ * list-snapshot.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <gio/gio.h>
+
+#include "list-snapshot.h"
+
+namespace SC {
+
+static const char SNAPSHOT_MAGIC[8] = { 'S', 'C', 'S', 'N', 'A', 'P', 0, 1 };
+// written in host order, reads back differently on another architecture
+static const guint32 SNAPSHOT_BYTE_ORDER = 0x01020304;
+static const guint32 NO_STRING = G_MAXUINT32;
+
+struct SnapshotHeader {
+    char magic[8];
+    guint32 byte_order;
+    guint32 n_columns;
+    guint32 n_rows;
+    guint32 count;
+    guint32 size;
+    guint32 reserved;
+};
+
+// every cell takes 8 bytes, strings are stored after the cells
+union SnapshotCell {
+    gint64 integer;
+    double real;
+    struct {
+        guint32 offset;
+        guint32 length;
+    } string;
+};
+
+// GType values aren't stable between runs, so the column types are stored
+// as these codes
+enum SnapshotType {
+    SNAPSHOT_TYPE_INVALID,
+    SNAPSHOT_TYPE_BOOLEAN,
+    SNAPSHOT_TYPE_INT,
+    SNAPSHOT_TYPE_UINT,
+    SNAPSHOT_TYPE_INT64,
+    SNAPSHOT_TYPE_UINT64,
+    SNAPSHOT_TYPE_FLOAT,
+    SNAPSHOT_TYPE_DOUBLE,
+    SNAPSHOT_TYPE_STRING
+};
+
+static guint32 snapshot_type(GType type)
+{
+    switch (G_TYPE_FUNDAMENTAL(type)) {
+    case G_TYPE_BOOLEAN:
+        return SNAPSHOT_TYPE_BOOLEAN;
+    case G_TYPE_INT:
+        return SNAPSHOT_TYPE_INT;
+    case G_TYPE_UINT:
+        return SNAPSHOT_TYPE_UINT;
+    case G_TYPE_INT64:
+        return SNAPSHOT_TYPE_INT64;
+    case G_TYPE_UINT64:
+        return SNAPSHOT_TYPE_UINT64;
+    case G_TYPE_FLOAT:
+        return SNAPSHOT_TYPE_FLOAT;
+    case G_TYPE_DOUBLE:
+        return SNAPSHOT_TYPE_DOUBLE;
+    case G_TYPE_STRING:
+        return SNAPSHOT_TYPE_STRING;
+    }
+    return SNAPSHOT_TYPE_INVALID;
+}
+
+static gsize types_size(guint n_columns)
+{
+    // keeps the cells 8-byte aligned
+    return (n_columns * sizeof(guint32) + 7) & ~static_cast<gsize>(7);
+}
+
+static SnapshotCell encode_cell(const GValue* value, std::string& strings, gsize strings_offset)
+{
+    SnapshotCell cell;
+    memset(&cell, 0, sizeof(cell));
+    switch (G_TYPE_FUNDAMENTAL(G_VALUE_TYPE(value))) {
+    case G_TYPE_BOOLEAN:
+        cell.integer = g_value_get_boolean(value);
+        break;
+    case G_TYPE_INT:
+        cell.integer = g_value_get_int(value);
+        break;
+    case G_TYPE_UINT:
+        cell.integer = g_value_get_uint(value);
+        break;
+    case G_TYPE_INT64:
+        cell.integer = g_value_get_int64(value);
+        break;
+    case G_TYPE_UINT64:
+        cell.integer = g_value_get_uint64(value);
+        break;
+    case G_TYPE_FLOAT:
+        cell.real = g_value_get_float(value);
+        break;
+    case G_TYPE_DOUBLE:
+        cell.real = g_value_get_double(value);
+        break;
+    case G_TYPE_STRING: {
+        const char* str = g_value_get_string(value);
+        if (!str) {
+            cell.string.offset = NO_STRING;
+            break;
+        }
+        cell.string.offset = strings_offset + strings.size();
+        cell.string.length = strlen(str);
+        strings.append(str, cell.string.length + 1);
+        break;
+    }
+    }
+    return cell;
+}
+
+struct ListSnapshot::Priv {
+    GMappedFile* file;
+    guint count;
+    std::vector<ProjectedRow> rows;
+
+    Priv()
+        : file(0)
+        , count(0)
+    {
+    }
+
+    ~Priv()
+    {
+        if (file)
+            g_mapped_file_unref(file);
+    }
+
+    bool decode(const std::vector<GType>& types)
+    {
+        const char* data = g_mapped_file_get_contents(file);
+        gsize size = g_mapped_file_get_length(file);
+        if (size < sizeof(SnapshotHeader))
+            return false;
+
+        SnapshotHeader header;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC))
+            || header.byte_order != SNAPSHOT_BYTE_ORDER
+            || header.size != size
+            || header.n_columns != types.size()
+            || header.n_rows > header.count)
+            return false;
+
+        gsize cells_offset = sizeof(SnapshotHeader) + types_size(header.n_columns);
+        gsize strings_offset = cells_offset + static_cast<gsize>(header.n_rows) * header.n_columns * sizeof(SnapshotCell);
+        if (strings_offset > size)
+            return false;
+
+        const guint32* stored_types = reinterpret_cast<const guint32*>(data + sizeof(SnapshotHeader));
+        for (guint i = 0; i < types.size(); ++i) {
+            if (stored_types[i] != snapshot_type(types[i]) || stored_types[i] == SNAPSHOT_TYPE_INVALID)
+                return false;
+        }
+
+        const SnapshotCell* cells = reinterpret_cast<const SnapshotCell*>(data + cells_offset);
+        rows.resize(header.n_rows);
+        for (guint r = 0; r < header.n_rows; ++r) {
+            ProjectedRow& row = rows[r];
+            row.resize(types.size());
+            for (guint c = 0; c < types.size(); ++c) {
+                const SnapshotCell& cell = cells[r * types.size() + c];
+                GValue* value = row[c].gobj();
+                row[c].init(types[c]);
+                switch (stored_types[c]) {
+                case SNAPSHOT_TYPE_BOOLEAN:
+                    g_value_set_boolean(value, cell.integer != 0);
+                    break;
+                case SNAPSHOT_TYPE_INT:
+                    g_value_set_int(value, cell.integer);
+                    break;
+                case SNAPSHOT_TYPE_UINT:
+                    g_value_set_uint(value, cell.integer);
+                    break;
+                case SNAPSHOT_TYPE_INT64:
+                    g_value_set_int64(value, cell.integer);
+                    break;
+                case SNAPSHOT_TYPE_UINT64:
+                    g_value_set_uint64(value, cell.integer);
+                    break;
+                case SNAPSHOT_TYPE_FLOAT:
+                    g_value_set_float(value, cell.real);
+                    break;
+                case SNAPSHOT_TYPE_DOUBLE:
+                    g_value_set_double(value, cell.real);
+                    break;
+                case SNAPSHOT_TYPE_STRING:
+                    if (cell.string.offset == NO_STRING)
+                        break;
+                    if (cell.string.offset < strings_offset
+                        || static_cast<gsize>(cell.string.offset) + cell.string.length >= size
+                        || data[cell.string.offset + cell.string.length] != '\0')
+                        return false;
+                    g_value_set_static_string(value, data + cell.string.offset);
+                    break;
+                }
+            }
+        }
+        count = header.count;
+        return true;
+    }
+};
+
+ListSnapshot::ListSnapshot()
+    : m_priv(new Priv())
+{
+}
+
+std::tr1::shared_ptr<ListSnapshot> ListSnapshot::load(const std::string& path,
+                                                      const std::vector<GType>& types)
+{
+    std::tr1::shared_ptr<ListSnapshot> snapshot;
+    GError* error = 0;
+    GMappedFile* file = g_mapped_file_new(path.c_str(), FALSE, &error);
+    if (!file) {
+        if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning("Unable to map list snapshot %s: %s", path.c_str(), error->message);
+        g_clear_error(&error);
+        return snapshot;
+    }
+
+    snapshot.reset(new ListSnapshot());
+    snapshot->m_priv->file = file;
+    if (!snapshot->m_priv->decode(types)) {
+        g_debug("Ignoring outdated list snapshot %s", path.c_str());
+        snapshot.reset();
+    }
+    return snapshot;
+}
+
+bool ListSnapshot::save(const std::string& path,
+                        const std::vector<GType>& types,
+                        guint count,
+                        const std::vector<const ProjectedRow*>& rows,
+                        GError** error)
+{
+    guint n_columns = types.size();
+    std::vector<guint32> stored_types(n_columns);
+    for (guint c = 0; c < n_columns; ++c) {
+        stored_types[c] = snapshot_type(types[c]);
+        if (stored_types[c] == SNAPSHOT_TYPE_INVALID) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                        "Column %u of type %s can't be saved in a snapshot",
+                        c, g_type_name(types[c]));
+            return false;
+        }
+    }
+
+    gsize cells_offset = sizeof(SnapshotHeader) + types_size(n_columns);
+    gsize strings_offset = cells_offset + rows.size() * n_columns * sizeof(SnapshotCell);
+    std::vector<SnapshotCell> cells;
+    cells.reserve(rows.size() * n_columns);
+    std::string strings;
+    for (std::vector<const ProjectedRow*>::const_iterator it = rows.begin(); it != rows.end(); ++it) {
+        g_return_val_if_fail((*it)->size() == n_columns, false);
+        for (guint c = 0; c < n_columns; ++c)
+            cells.push_back(encode_cell((**it)[c].gobj(), strings, strings_offset));
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.n_columns = n_columns;
+    header.n_rows = rows.size();
+    header.count = count;
+    header.size = strings_offset + strings.size();
+
+    std::string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (n_columns)
+        contents.append(reinterpret_cast<const char*>(&stored_types[0]), n_columns * sizeof(guint32));
+    contents.resize(cells_offset, '\0');
+    if (!cells.empty())
+        contents.append(reinterpret_cast<const char*>(&cells[0]), cells.size() * sizeof(SnapshotCell));
+    contents.append(strings);
+
+    // written to a temporary file and renamed, a crash can't leave a
+    // half-written snapshot behind
+    return g_file_set_contents(path.c_str(), contents.data(), contents.size(), error);
+}
+
+guint ListSnapshot::count() const
+{
+    return m_priv->count;
+}
+
+guint ListSnapshot::n_rows() const
+{
+    return m_priv->rows.size();
+}
+
+const ProjectedRow& ListSnapshot::row(guint index) const
+{
+    return m_priv->rows[index];
+}
+}
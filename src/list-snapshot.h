@@ -0,0 +1,71 @@
+/*
+ * list-snapshot.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LIST_SNAPSHOT_H
+#define _LIST_SNAPSHOT_H
+
+#include <glibmm.h>
+#include <string>
+#include <tr1/memory>
+#include <vector>
+
+#include "keyset-pager.h"
+
+namespace SC {
+
+/*
+ * The first rows of a list and its total length, saved when the application
+ * exits so that the list can be painted on the next start before the database
+ * has been opened, checked and queried.
+ *
+ * The file is mapped rather than read: it holds fixed-size cells for the
+ * scalar columns followed by the NUL-terminated strings, which the rows lend
+ * from the mapping instead of copying them. It is written for the machine
+ * that reads it, snapshots with a different layout are ignored.
+ */
+class ListSnapshot {
+public:
+    // Returns an empty pointer if there's no snapshot at @path or if its
+    // columns don't have the given types
+    static std::tr1::shared_ptr<ListSnapshot> load(const std::string& path,
+                                                   const std::vector<GType>& types);
+    // Saves @rows, whose columns must have the given types. Only columns of
+    // numeric types and strings can be saved.
+    static bool save(const std::string& path,
+                     const std::vector<GType>& types,
+                     guint count,
+                     const std::vector<const ProjectedRow*>& rows,
+                     GError** error);
+
+    // the length of the list when it was saved
+    guint count() const;
+    // the number of rows in the snapshot, at most count()
+    guint n_rows() const;
+    const ProjectedRow& row(guint index) const;
+
+private:
+    ListSnapshot();
+
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _LIST_SNAPSHOT_H */
@@ -0,0 +1,183 @@
+/*
+ * location-entry.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "location-entry.h"
+#include "location-index.h"
+
+namespace SC {
+
+struct LocationCompletionColumns : public Gtk::TreeModel::ColumnRecord {
+    Gtk::TreeModelColumn<gint64> id;
+    Gtk::TreeModelColumn<Glib::ustring> name;
+
+    LocationCompletionColumns()
+    {
+        add(id);
+        add(name);
+    }
+};
+
+// trackable, since lookups may finish after the entry was destroyed
+struct LocationEntry::Priv : public sigc::trackable {
+    Gtk::Entry& entry;
+    std::tr1::shared_ptr<LocationIndex> index;
+    LocationCompletionColumns columns;
+    Glib::RefPtr<Gtk::ListStore> matches;
+    Glib::RefPtr<Gtk::EntryCompletion> completion;
+    gint64 location_id;
+    Glib::ustring location_name;
+    bool setting_text;
+    sigc::signal<void> signal_location_changed;
+
+    Priv(Gtk::Entry& entry, const std::tr1::shared_ptr<Repository>& repository)
+        : entry(entry)
+        , index(LocationIndex::get(repository))
+        , matches(Gtk::ListStore::create(columns))
+        , completion(Gtk::EntryCompletion::create())
+        , location_id(0)
+        , setting_text(false)
+    {
+        completion->set_model(matches);
+        completion->set_text_column(columns.name);
+        completion->set_minimum_key_length(1);
+        // the store only ever holds the matches for the current text
+        completion->set_match_func(sigc::mem_fun(this, &Priv::match_all));
+        completion->signal_match_selected().connect(
+            sigc::mem_fun(this, &Priv::on_match_selected));
+        entry.set_completion(completion);
+        entry.set_placeholder_text("Type a location name");
+
+        entry.signal_changed().connect(sigc::mem_fun(this, &Priv::on_text_changed));
+        entry.signal_focus_out_event().connect(sigc::mem_fun(this, &Priv::on_focus_out));
+    }
+
+    bool match_all(const Glib::ustring& /*key*/, const Gtk::TreeModel::const_iterator& /*iter*/)
+    {
+        return true;
+    }
+
+    void set_text(const Glib::ustring& text)
+    {
+        setting_text = true;
+        entry.set_text(text);
+        setting_text = false;
+    }
+
+    void set_location(gint64 id, const Glib::ustring& name, bool notify)
+    {
+        bool changed = id != location_id;
+        location_id = id;
+        location_name = name;
+        if (changed && notify)
+            signal_location_changed.emit();
+    }
+
+    void on_text_changed()
+    {
+        if (setting_text)
+            return;
+
+        Glib::ustring text = entry.get_text();
+        if (text.empty()) {
+            matches->clear();
+            set_location(0, text, true);
+            return;
+        }
+
+        LocationMatchVector found;
+        if (index->find_cached(text, found)) {
+            show_matches(text, found);
+            return;
+        }
+        index->find_async(text, sigc::bind(sigc::mem_fun(this, &Priv::on_found), text));
+    }
+
+    void on_found(const Glib::RefPtr<Gio::AsyncResult>& result, Glib::ustring prefix)
+    {
+        LocationMatchVector found;
+        try
+        {
+            found = index->find_finish(result);
+        }
+        catch (const Glib::Error& error)
+        {
+            g_warning("Unable to look up locations: %s", error.what().c_str());
+            return;
+        }
+        // the user kept typing; a lookup for the current text is under way
+        if (prefix != entry.get_text())
+            return;
+        show_matches(prefix, found);
+        completion->complete();
+    }
+
+    void show_matches(const Glib::ustring& text, const LocationMatchVector& found)
+    {
+        matches->clear();
+        for (LocationMatchVector::const_iterator it = found.begin(); it != found.end(); ++it) {
+            Gtk::TreeModel::Row row = *matches->append();
+            row[columns.id] = it->id;
+            row[columns.name] = it->name;
+            // typing a name in full chooses it, as does picking it
+            if (!g_ascii_strcasecmp(it->name.c_str(), text.c_str()))
+                set_location(it->id, it->name, true);
+        }
+    }
+
+    bool on_match_selected(const Gtk::TreeModel::iterator& iter)
+    {
+        Glib::ustring name = (*iter)[columns.name];
+        set_text(name);
+        entry.set_position(-1);
+        set_location((*iter)[columns.id], name, true);
+        return true;
+    }
+
+    bool on_focus_out(GdkEventFocus* /*event*/)
+    {
+        // don't leave text in the entry that doesn't name the location
+        // that will be saved
+        if (entry.get_text() != location_name)
+            set_text(location_name);
+        return false;
+    }
+};
+
+LocationEntry::LocationEntry(const std::tr1::shared_ptr<Repository>& repository)
+    : m_priv(new Priv(*this, repository))
+{
+}
+
+void LocationEntry::set_location(gint64 id, const Glib::ustring& name)
+{
+    m_priv->set_location(id, name, false);
+    m_priv->set_text(name);
+}
+
+gint64 LocationEntry::location_id() const
+{
+    return m_priv->location_id;
+}
+
+sigc::signal<void>& LocationEntry::signal_location_changed()
+{
+    return m_priv->signal_location_changed;
+}
+}
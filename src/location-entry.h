@@ -0,0 +1,51 @@
+/*
+ * location-entry.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOCATION_ENTRY_H
+#define _LOCATION_ENTRY_H
+
+#include <gtkmm.h>
+#include <tr1/memory>
+
+#include "repository.h"
+
+namespace SC {
+// An entry for choosing a location by typing the beginning of its name.
+// Completions are looked up through the repository's LocationIndex as the
+// user types, instead of loading every location up front.
+class LocationEntry : public Gtk::Entry {
+public:
+    LocationEntry(const std::tr1::shared_ptr<Repository>& repository);
+
+    // shows @name for location @id without looking it up; 0 for no location
+    void set_location(gint64 id, const Glib::ustring& name);
+    gint64 location_id() const;
+
+    // emitted when a location was picked from the completions, typed in
+    // full, or the entry was cleared
+    sigc::signal<void>& signal_location_changed();
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _LOCATION_ENTRY_H */
@@ -0,0 +1,215 @@
+/*
+ * location-index.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GRefPtr.h"
+#include "location-index.h"
+#include "location-resource.h"
+#include "read-pool.h"
+#include "task.h"
+
+namespace SC {
+
+#define LOCATION_INDEX_KEY "sc-location-index"
+
+// the results of this many prefixes are remembered before starting over
+static const guint MAX_CACHED_PREFIXES = 256;
+
+// sorts after every character a location name can continue a prefix with
+static const char* PREFIX_END = "\xf4\x8f\xbf\xbf";
+
+LocationMatch::LocationMatch(gint64 id, const Glib::ustring& name)
+    : id(id)
+    , name(name)
+{
+}
+
+static bool has_prefix(const Glib::ustring& name, const Glib::ustring& prefix)
+{
+    return g_ascii_strncasecmp(name.c_str(), prefix.c_str(), prefix.bytes()) == 0;
+}
+
+struct FindLocationsTask : public Task {
+    std::string prefix;
+    guint generation;
+    LocationMatchVector matches;
+
+    FindLocationsTask(const std::string& prefix, guint generation, const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , prefix(prefix)
+        , generation(generation)
+    {
+    }
+};
+
+// runs in the adapter thread
+static void find_locations_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    FindLocationsTask* task = reinterpret_cast<FindLocationsTask*>(user_data);
+    // a range on the NOCASE index instead of LIKE, which SQLite can't always
+    // answer from an index when the pattern is a parameter
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "SELECT \"id\", \"name\" FROM \"locations\" "
+                            "WHERE \"name\" >= ? COLLATE NOCASE AND \"name\" < ? COLLATE NOCASE "
+                            "ORDER BY \"name\" COLLATE NOCASE LIMIT ?",
+                     NULL)));
+    std::string end = task->prefix + PREFIX_END;
+    gom_command_set_param_string(command.get(), 0, task->prefix.c_str());
+    gom_command_set_param_string(command.get(), 1, end.c_str());
+    gom_command_set_param_uint(command.get(), 2, LocationIndex::MAX_MATCHES);
+
+    GError* error = 0;
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    while (cursor && gom_cursor_next(cursor)) {
+        const char* name = gom_cursor_get_column_string(cursor, 1);
+        task->matches.push_back(LocationMatch(gom_cursor_get_column_int64(cursor, 0),
+                                              name ? name : ""));
+    }
+    if (cursor)
+        g_object_unref(cursor);
+    g_task_return_boolean(task->task(), true);
+}
+
+struct LocationIndex::Priv : public sigc::trackable {
+    // the index is kept with the GomRepository, which may outlive the
+    // Repository that it was created for
+    std::tr1::weak_ptr<Repository> repository;
+    typedef std::map<std::string, LocationMatchVector> PrefixMap;
+    PrefixMap cache;
+    // bumped whenever the cache is dropped, so that lookups that were
+    // running at that time don't put stale results back into it
+    guint generation;
+
+    Priv(const std::tr1::shared_ptr<Repository>& repository)
+        : repository(repository)
+        , generation(0)
+    {
+        repository->signal_database_changed().connect(
+            sigc::mem_fun(this, &Priv::clear));
+        repository->signal_resources_changed().connect(
+            sigc::mem_fun(this, &Priv::on_resources_changed));
+    }
+
+    void clear()
+    {
+        cache.clear();
+        generation++;
+    }
+
+    void on_resources_changed(GType type)
+    {
+        if (type == SC_TYPE_LOCATION_RESOURCE)
+            clear();
+    }
+
+    bool find_cached(const Glib::ustring& prefix, LocationMatchVector& matches) const
+    {
+        PrefixMap::const_iterator it = cache.find(prefix.raw());
+        if (it != cache.end()) {
+            matches = it->second;
+            return true;
+        }
+
+        // a shorter prefix whose matches were all returned contains every
+        // match for this one
+        for (Glib::ustring::size_type len = prefix.size(); len > 0; --len) {
+            it = cache.find(prefix.substr(0, len - 1).raw());
+            if (it == cache.end() || it->second.size() >= MAX_MATCHES)
+                continue;
+            matches.clear();
+            for (LocationMatchVector::const_iterator match = it->second.begin();
+                 match != it->second.end();
+                 ++match) {
+                if (has_prefix(match->name, prefix))
+                    matches.push_back(*match);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void store(const Glib::ustring& prefix, const LocationMatchVector& matches)
+    {
+        if (cache.size() >= MAX_CACHED_PREFIXES)
+            cache.clear();
+        cache[prefix.raw()] = matches;
+    }
+};
+
+static void delete_location_index(gpointer data)
+{
+    delete reinterpret_cast<std::tr1::shared_ptr<LocationIndex>*>(data);
+}
+
+std::tr1::shared_ptr<LocationIndex> LocationIndex::get(const std::tr1::shared_ptr<Repository>& repository)
+{
+    GObject* object = G_OBJECT(repository->cobj());
+    std::tr1::shared_ptr<LocationIndex>* index = reinterpret_cast<std::tr1::shared_ptr<LocationIndex>*>(
+        g_object_get_data(object, LOCATION_INDEX_KEY));
+    if (!index || (*index)->m_priv->repository.lock() != repository) {
+        index = new std::tr1::shared_ptr<LocationIndex>(new LocationIndex(repository));
+        g_object_set_data_full(object, LOCATION_INDEX_KEY, index, delete_location_index);
+    }
+    return *index;
+}
+
+LocationIndex::LocationIndex(const std::tr1::shared_ptr<Repository>& repository)
+    : m_priv(new Priv(repository))
+{
+}
+
+bool LocationIndex::find_cached(const Glib::ustring& prefix, LocationMatchVector& matches) const
+{
+    return m_priv->find_cached(prefix, matches);
+}
+
+void LocationIndex::find_async(const Glib::ustring& prefix, const Gio::SlotAsyncReady& slot)
+{
+    FindLocationsTask* task = new FindLocationsTask(prefix, m_priv->generation, slot);
+    std::tr1::shared_ptr<Repository> repository = m_priv->repository.lock();
+    if (!repository) {
+        g_task_return_new_error(task->task(), G_IO_ERROR, G_IO_ERROR_CLOSED, "The collection was closed");
+        return;
+    }
+    std::tr1::shared_ptr<ReadPool> pool = ReadPool::get(repository->cobj());
+    repository->run_when_ready(sigc::bind(sigc::mem_fun(*pool, &ReadPool::queue_read),
+                                           find_locations_proxy,
+                                           task));
+}
+
+LocationMatchVector LocationIndex::find_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    FindLocationsTask* task = reinterpret_cast<FindLocationsTask*>(g_task_get_task_data(gtask));
+    g_task_propagate_boolean(gtask, &error);
+    if (error)
+        throw Glib::Error(error);
+
+    if (task->generation == m_priv->generation)
+        m_priv->store(task->prefix, task->matches);
+    return task->matches;
+}
+}
@@ -0,0 +1,73 @@
+/*
+ * location-index.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOCATION_INDEX_H
+#define _LOCATION_INDEX_H
+
+#include <giomm.h>
+#include <map>
+#include <tr1/memory>
+#include <vector>
+
+#include "repository.h"
+
+namespace SC {
+
+struct LocationMatch {
+    gint64 id;
+    Glib::ustring name;
+
+    LocationMatch(gint64 id = 0, const Glib::ustring& name = Glib::ustring());
+};
+
+typedef std::vector<LocationMatch> LocationMatchVector;
+
+/*
+ * Looks up locations by the beginning of their name, for type-ahead
+ * completion. Lookups use the index on locations(name) and only return the
+ * first MAX_MATCHES names, so that no window has to load the whole locations
+ * table. There is one index per repository, shared by all windows, which
+ * remembers the results of recent lookups: once a prefix has fewer than
+ * MAX_MATCHES matches, the matches for longer prefixes are filtered from
+ * those in memory. The remembered results are dropped whenever the database
+ * changes.
+ */
+class LocationIndex {
+public:
+    static std::tr1::shared_ptr<LocationIndex> get(const std::tr1::shared_ptr<Repository>& repository);
+
+    static const guint MAX_MATCHES = 20;
+
+    // Names are compared ignoring (ASCII) case, like SQLite's NOCASE
+    // collation. Returns false if @prefix has to be looked up with
+    // find_async().
+    bool find_cached(const Glib::ustring& prefix, LocationMatchVector& matches) const;
+    void find_async(const Glib::ustring& prefix, const Gio::SlotAsyncReady& slot);
+    LocationMatchVector find_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
+
+private:
+    LocationIndex(const std::tr1::shared_ptr<Repository>& repository);
+
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _LOCATION_INDEX_H */
@@ -19,6 +19,7 @@
  */
 
 #include "GRefPtr.h"
+#include "keyset-pager.h"
 #include "location-list.h"
 #include "location-tree-model.h"
 #include "location-tree-view.h"
@@ -28,6 +29,7 @@ namespace SC {
 struct LocationList::Priv {
     std::tr1::shared_ptr<Repository> repository;
     Glib::RefPtr<LocationTreeModel> model;
+    std::tr1::shared_ptr<KeysetPager> pager;
     Gtk::ScrolledWindow scroller;
     LocationTreeView tree_view;
 
@@ -40,7 +42,8 @@ struct LocationList::Priv {
             sigc::mem_fun(this, &Priv::on_row_activated));
         scroller.show();
         tree_view.show();
-        refresh_view();
+        // don't query the database until its schema is known to be current
+        repository->run_when_ready(sigc::mem_fun(this, &Priv::refresh_view));
 
         repository->signal_database_changed().connect(
             sigc::mem_fun(this, &Priv::refresh_view));
@@ -48,37 +51,32 @@ struct LocationList::Priv {
 
     void refresh_view()
     {
-        gom_repository_find_async(repository->cobj(),
-                                  SC_TYPE_LOCATION_RESOURCE,
-                                  0 /*m_priv->filter.get()*/,
-                                  Priv::got_locations_proxy,
-                                  this);
+        // a newer query replaces one that is still running
+        pager.reset(new KeysetPager(repository->cobj(), SC_TYPE_LOCATION_RESOURCE));
+        pager->build_async(sigc::bind(sigc::mem_fun(this, &Priv::got_locations), pager));
     }
 
-    static void got_locations_proxy(GObject* source,
-                                    GAsyncResult* result,
-                                    gpointer user_data)
-    {
-        GomRepository* repository = reinterpret_cast<GomRepository*>(source);
-        Priv* self = reinterpret_cast<Priv*>(user_data);
-        self->got_locations(repository, result);
-    }
-
-    void got_locations(GomRepository* repository, GAsyncResult* result)
+    void got_locations(const Glib::RefPtr<Gio::AsyncResult>& result,
+                       std::tr1::shared_ptr<KeysetPager> built)
     {
         g_debug("%s", G_STRFUNC);
-        GError* error = 0;
-        WTF::GRefPtr<GomResourceGroup> results = adoptGRef(gom_repository_find_finish(repository, result, &error));
-        if (error) {
-            g_warning("Unable to find locations: %s", error->message);
-            g_clear_error(&error);
+        try
+        {
+            built->build_finish(result);
+        }
+        catch (const Glib::Error& error)
+        {
+            g_warning("Unable to find locations: %s", error.what().c_str());
             return;
         }
+        if (built != pager)
+            return;
 
-        // FIXME: figure out why we need to unset the model before setting it
+        // the pager doesn't announce its rows one by one; the view reads the
+        // row count when the model is set
         tree_view.set_model(Glib::RefPtr<LocationTreeModel>());
-        g_debug("total locations: %i", gom_resource_group_get_count(results.get()));
-        model->set_resource_group(results.get());
+        g_debug("total locations: %u", pager->count());
+        model->set_pager(pager);
         tree_view.set_model(model);
     }
 
@@ -19,6 +19,7 @@
  */
 
 #include "location-resource.h"
+#include "resource-dirty.h"
 
 #define SC_LOCATION_RESOURCE_GET_PRIVATE(object) \
     (G_TYPE_INSTANCE_GET_PRIVATE(                \
@@ -59,6 +60,8 @@ static void sc_location_resource_set_property(GObject* obj,
 {
     ScLocationResource* self = SC_LOCATION_RESOURCE(obj);
 
+    sc_resource_track_change(obj, pspec, value);
+
     switch (property_id) {
     case PROP_ID:
         self->priv->id = g_value_get_int64(value);
@@ -20,6 +20,7 @@
 
 #include "GRefPtr.h"
 #include "location-tree-model.h"
+#include "resource-dirty.h"
 
 namespace SC {
 
@@ -56,7 +57,8 @@ static const char* loading = "loading...";
 
 struct LocationTreeModel::Priv {
     LocationModelColumns columns;
-    WTF::GRefPtr<GomResourceGroup> locations;
+    std::tr1::shared_ptr<KeysetPager> pager;
+    sigc::connection rows_loaded_connection;
     WTF::GRefPtr<ScLocationResource> empty_location;
     int stamp;
 
@@ -89,26 +91,38 @@ LocationTreeModel::LocationTreeModel()
 {
 }
 
-bool LocationTreeModel::path_deleted(const Gtk::TreeModel::Path& path)
+void LocationTreeModel::set_pager(const std::tr1::shared_ptr<KeysetPager>& pager)
 {
-    row_deleted(path);
-    return false;
+    m_priv->rows_loaded_connection.disconnect();
+    m_priv->pager = pager;
+    if (pager) {
+        m_priv->stamp++;
+        m_priv->rows_loaded_connection = pager->signal_rows_loaded().connect(
+            sigc::mem_fun(this, &LocationTreeModel::on_rows_loaded));
+    }
 }
 
-void LocationTreeModel::set_resource_group(GomResourceGroup* locations)
+void LocationTreeModel::on_rows_loaded(guint first, guint count)
 {
-    foreach_path(sigc::mem_fun(this, &LocationTreeModel::path_deleted));
-    m_priv->locations = locations;
-    if (locations) {
-        m_priv->stamp++;
-        for (int i = 0; i < gom_resource_group_get_count(locations); ++i) {
-            Gtk::TreeModel::Path path;
-            path.push_back(i);
-            row_inserted(path, make_iterator(i));
-        }
+    for (guint i = first; i < first + count; ++i) {
+        // establish the baseline for tracking changes to these resources
+        GomResource* resource = m_priv->pager->peek(i);
+        if (resource)
+            sc_resource_clear_dirty(G_OBJECT(resource));
+
+        Gtk::TreeModel::Path path;
+        path.push_back(i);
+        row_changed(path, make_iterator(i));
     }
 }
 
+guint LocationTreeModel::count() const
+{
+    if (m_priv->pager)
+        return m_priv->pager->count();
+    return 0;
+}
+
 Gtk::TreeModelFlags LocationTreeModel::get_flags_vfunc(void) const
 {
     return Gtk::TreeModelFlags(Gtk::TREE_MODEL_LIST_ONLY);
@@ -218,10 +232,7 @@ int LocationTreeModel::iter_n_children_vfunc(const iterator& iter) const
 
 int LocationTreeModel::iter_n_root_children_vfunc(void) const
 {
-    if (!m_priv->locations)
-        return 0;
-
-    return gom_resource_group_get_count(m_priv->locations.get());
+    return count();
 }
 
 bool LocationTreeModel::iter_nth_child_vfunc(const iterator& parent,
@@ -275,82 +286,22 @@ bool LocationTreeModel::iter_is_valid(const iterator& iter) const
 
 ScLocationResource* LocationTreeModel::get_location(guint index) const
 {
-    if (!m_priv->locations)
+    if (!m_priv->pager)
         return 0;
-    ScLocationResource* location = SC_LOCATION_RESOURCE(
-        gom_resource_group_get_index(m_priv->locations.get(), index));
-
-    if (location) {
-        return location;
-    }
-    g_debug("location %u not fetched, fetching...", index);
-    fetch_location(index);
+    GomResource* location = m_priv->pager->peek(index);
+    if (location)
+        return SC_LOCATION_RESOURCE(location);
+    m_priv->pager->fetch(index);
     return m_priv->empty_location.get();
 }
 
 Gtk::TreeModel::iterator LocationTreeModel::make_iterator(guint index) const
 {
     iterator iter;
-    if (m_priv->locations
-        && index < gom_resource_group_get_count(m_priv->locations.get())) {
+    if (index < count()) {
         iter.set_stamp(m_priv->stamp);
         iter_set_index(iter, index);
     }
     return iter;
 }
-
-struct FetchLocationData {
-    LocationTreeModel* self;
-    guint index;
-    guint count;
-
-    FetchLocationData(LocationTreeModel* self, guint index, guint count)
-        : self(self)
-        , index(index)
-        , count(count)
-    {
-    }
-};
-
-void LocationTreeModel::location_fetch_done_proxy(GObject* source,
-                                                  GAsyncResult* result,
-                                                  gpointer user_data)
-{
-    FetchLocationData* data = reinterpret_cast<FetchLocationData*>(user_data);
-    GomResourceGroup* locations = reinterpret_cast<GomResourceGroup*>(source);
-    data->self->location_fetch_done(locations,
-                                    result,
-                                    data->index,
-                                    data->count);
-    delete data;
-}
-
-void LocationTreeModel::location_fetch_done(GomResourceGroup* locations,
-                                            GAsyncResult* result,
-                                            guint index,
-                                            guint count)
-{
-    GError* error = 0;
-    if (!gom_resource_group_fetch_finish(locations, result, &error)) {
-        g_warning("Failed to fetch location %i: %s", index, error->message);
-        g_clear_error(&error);
-        return;
-    }
-
-    g_debug("Location %i fetched. signaling changed...", index);
-    Gtk::TreeModel::Path path;
-    path.push_back(index);
-    row_changed(path, make_iterator(index));
-}
-
-void LocationTreeModel::fetch_location(guint index) const
-{
-    gom_resource_group_fetch_async(GOM_RESOURCE_GROUP(m_priv->locations.get()),
-                                   index,
-                                   1,
-                                   LocationTreeModel::location_fetch_done_proxy,
-                                   new FetchLocationData(const_cast<SC::LocationTreeModel*>(this),
-                                                         index,
-                                                         1));
-}
 }
@@ -24,6 +24,7 @@
 #include <gom/gom.h>
 #include <gtkmm.h>
 #include <tr1/memory>
+#include "keyset-pager.h"
 #include "location-resource.h"
 
 namespace SC {
@@ -43,7 +44,10 @@ class LocationTreeModel : public Gtk::TreeModel,
                           public Glib::Object {
 public:
     static Glib::RefPtr<LocationTreeModel> create();
-    void set_resource_group(GomResourceGroup* locations);
+    // @pager must already be built. No rows are announced, so the model
+    // has to be detached from its views while the pager is replaced; they read
+    // the row count when the model is set again.
+    void set_pager(const std::tr1::shared_ptr<KeysetPager>& pager);
     const LocationModelColumns& columns() const;
 
 private:
@@ -67,18 +71,9 @@ private:
     virtual bool iter_is_valid(const iterator& iter) const;
 
     ScLocationResource* get_location(guint index) const;
-    void fetch_location(guint index) const;
-    void invalidate_all();
     iterator make_iterator(guint index) const;
-    bool path_deleted(const Gtk::TreeModel::Path& path);
-
-    static void location_fetch_done_proxy(GObject* source,
-                                          GAsyncResult* result,
-                                          gpointer user_data);
-    void location_fetch_done(GomResourceGroup* locations,
-                             GAsyncResult* result,
-                             guint index,
-                             guint count);
+    guint count() const;
+    void on_rows_loaded(guint first, guint count);
 
     struct Priv;
     std::tr1::shared_ptr<Priv> m_priv;
@@ -0,0 +1,108 @@
+/*
+ * loudness-analysis.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <tr1/memory>
+
+#include "audio-decoder.h"
+#include "GRefPtr.h"
+#include "loudness.h"
+#include "loudness-analysis.h"
+#include "recording-resource.h"
+
+namespace SC {
+
+struct LoudnessResult : public AnalysisResult {
+    LoudnessStats stats;
+};
+
+struct MeterState {
+    AudioDecoder* decoder;
+    std::tr1::shared_ptr<LoudnessMeter> meter;
+};
+
+static bool measure_samples(const void* data, gsize frames, MeterState* state)
+{
+    // the format is only known once decoding started
+    if (!state->meter.get())
+        state->meter.reset(new LoudnessMeter(state->decoder->rate(), state->decoder->channels()));
+    state->meter->process(reinterpret_cast<const float*>(data), frames);
+    return true;
+}
+
+const char* LoudnessAnalysis::name() const
+{
+    return "loudness";
+}
+
+int LoudnessAnalysis::version() const
+{
+    return 1;
+}
+
+GType LoudnessAnalysis::resource_type() const
+{
+    return SC_TYPE_RECORDING_RESOURCE;
+}
+
+AnalysisResult* LoudnessAnalysis::analyze(const std::string& path, GError** error) const
+{
+    // native rate and channels: resampling would change the peaks
+    AudioDecoder decoder(path, AudioDecoder::FORMAT_F32);
+    MeterState state;
+    state.decoder = &decoder;
+    if (!decoder.decode(0, -1, sigc::bind(sigc::ptr_fun(&measure_samples), &state), error))
+        return 0;
+
+    LoudnessResult* result = new LoudnessResult();
+    if (state.meter.get()) {
+        result->stats = state.meter->finish();
+    } else {
+        result->stats.peak = result->stats.rms = -G_MAXFLOAT;
+        result->stats.loudness = result->stats.noise_floor = -G_MAXFLOAT;
+        result->stats.clipped_samples = 0;
+        result->stats.dc_offset = 0;
+    }
+    return result;
+}
+
+bool LoudnessAnalysis::store(GomAdapter* adapter,
+                             gint64 recording_id,
+                             const AnalysisResult* result,
+                             GError** error) const
+{
+    const LoudnessStats& stats = static_cast<const LoudnessResult*>(result)->stats;
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "UPDATE \"recordings\" SET \"peak\" = ?, \"rms\" = ?, \"loudness\" = ?, "
+                            "\"clipped-samples\" = ?, \"dc-offset\" = ?, \"noise-floor\" = ? "
+                            "WHERE \"id\" = ?",
+                     NULL)));
+    gom_command_set_param_float(command.get(), 0, stats.peak);
+    gom_command_set_param_float(command.get(), 1, stats.rms);
+    gom_command_set_param_float(command.get(), 2, stats.loudness);
+    gom_command_set_param_int64(command.get(), 3, stats.clipped_samples);
+    gom_command_set_param_float(command.get(), 4, std::max(-1.0, std::min(1.0, stats.dc_offset)));
+    gom_command_set_param_float(command.get(), 5, stats.noise_floor);
+    gom_command_set_param_int64(command.get(), 6, recording_id);
+    return gom_command_execute(command.get(), NULL, error);
+}
+}
@@ -0,0 +1,271 @@
+/*
+ * loudness.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "loudness.h"
+
+namespace SC {
+
+// a sample this close to full scale is counted as clipped
+static const float CLIP_LEVEL = 0.999f;
+// R128 gating: 400ms blocks that overlap by 75%, i.e. 100ms steps
+static const int STEPS_PER_SECOND = 10;
+static const int STEPS_PER_BLOCK = 4;
+static const double ABSOLUTE_GATE = -70.0;
+static const double RELATIVE_GATE = -10.0;
+// the noise floor is estimated from a histogram of 50ms window levels
+static const int NOISE_WINDOWS_PER_SECOND = 20;
+static const double HISTOGRAM_MIN = -120.0;
+static const double HISTOGRAM_STEP = 0.5;
+static const guint HISTOGRAM_BINS = 240;
+static const double NOISE_PERCENTILE = 0.1;
+
+static double to_db(double power)
+{
+    return power > 0 ? 10.0 * std::log10(power) : -G_MAXFLOAT;
+}
+
+static double block_loudness(double energy)
+{
+    return energy > 0 ? -0.691 + 10.0 * std::log10(energy) : -G_MAXFLOAT;
+}
+
+struct Biquad {
+    double b0, b1, b2, a1, a2;
+    double z1, z2;
+
+    double run(double x)
+    {
+        double y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        return y;
+    }
+};
+
+// The two stages of the K-weighting filter of ITU-R BS.1770, a high shelf
+// and a high pass, with coefficients derived for @rate
+static void k_weighting(int rate, Biquad& shelf, Biquad& highpass)
+{
+    double f0 = 1681.974450955533;
+    double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = std::tan(G_PI * f0 / rate);
+    double vh = std::pow(10.0, gain / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf.b1 = 2.0 * (k * k - vh) / a0;
+    shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf.a2 = (1.0 - k / q + k * k) / a0;
+    shelf.z1 = shelf.z2 = 0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(G_PI * f0 / rate);
+    a0 = 1.0 + k / q + k * k;
+    highpass.b0 = 1.0;
+    highpass.b1 = -2.0;
+    highpass.b2 = 1.0;
+    highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass.a2 = (1.0 - k / q + k * k) / a0;
+    highpass.z1 = highpass.z2 = 0;
+}
+
+struct LoudnessMeter::Priv {
+    int rate;
+    int channels;
+    std::vector<Biquad> shelves;
+    std::vector<Biquad> highpasses;
+    gsize step_frames;
+    gsize step_position;
+    double step_energy;
+    // mean K-weighted power of each 100ms step, summed over the channels
+    std::vector<double> steps;
+    gsize window_frames;
+    gsize window_position;
+    double window_energy;
+    std::vector<guint64> histogram;
+    float peak;
+    double sum;
+    double sum_squares;
+    guint64 n_samples;
+    gint64 clipped;
+
+    Priv(int rate, int channels)
+        : rate(rate)
+        , channels(std::max(channels, 1))
+        , shelves(this->channels)
+        , highpasses(this->channels)
+        , step_frames(std::max(rate / STEPS_PER_SECOND, 1))
+        , step_position(0)
+        , step_energy(0)
+        , window_frames(std::max(rate / NOISE_WINDOWS_PER_SECOND, 1))
+        , window_position(0)
+        , window_energy(0)
+        , histogram(HISTOGRAM_BINS, 0)
+        , peak(0)
+        , sum(0)
+        , sum_squares(0)
+        , n_samples(0)
+        , clipped(0)
+    {
+        for (int i = 0; i < this->channels; ++i)
+            k_weighting(rate, shelves[i], highpasses[i]);
+    }
+
+    // sample statistics that don't depend on the order of the samples, in a
+    // loop the compiler can vectorize
+    void accumulate(const float* samples, gsize n)
+    {
+        float block_peak = peak;
+        float block_sum = 0;
+        float block_squares = 0;
+        gint64 block_clipped = 0;
+        for (gsize i = 0; i < n; ++i) {
+            float x = samples[i];
+            float a = std::fabs(x);
+            block_peak = a > block_peak ? a : block_peak;
+            block_sum += x;
+            block_squares += x * x;
+            block_clipped += a >= CLIP_LEVEL;
+        }
+        peak = block_peak;
+        sum += block_sum;
+        sum_squares += block_squares;
+        clipped += block_clipped;
+        n_samples += n;
+    }
+
+    void add_to_histogram(double power)
+    {
+        double db = to_db(power);
+        int bin = static_cast<int>((db - HISTOGRAM_MIN) / HISTOGRAM_STEP);
+        histogram[std::max(0, std::min<int>(bin, HISTOGRAM_BINS - 1))]++;
+    }
+
+    void filter(const float* samples, gsize n_frames)
+    {
+        for (gsize frame = 0; frame < n_frames; ++frame) {
+            const float* x = samples + frame * channels;
+            double weighted = 0;
+            double power = 0;
+            for (int ch = 0; ch < channels; ++ch) {
+                double y = highpasses[ch].run(shelves[ch].run(x[ch]));
+                weighted += y * y;
+                power += static_cast<double>(x[ch]) * x[ch];
+            }
+            step_energy += weighted;
+            window_energy += power;
+
+            if (++step_position == step_frames) {
+                steps.push_back(step_energy / step_frames);
+                step_energy = 0;
+                step_position = 0;
+            }
+            if (++window_position == window_frames) {
+                add_to_histogram(window_energy / (window_frames * channels));
+                window_energy = 0;
+                window_position = 0;
+            }
+        }
+    }
+
+    double integrated_loudness() const
+    {
+        std::vector<double> blocks;
+        for (gsize i = 0; i + STEPS_PER_BLOCK <= steps.size(); ++i) {
+            double energy = 0;
+            for (int j = 0; j < STEPS_PER_BLOCK; ++j)
+                energy += steps[i + j];
+            blocks.push_back(energy / STEPS_PER_BLOCK);
+        }
+
+        double total = 0;
+        gsize n = 0;
+        for (gsize i = 0; i < blocks.size(); ++i) {
+            if (block_loudness(blocks[i]) > ABSOLUTE_GATE) {
+                total += blocks[i];
+                n++;
+            }
+        }
+        if (!n)
+            return -G_MAXFLOAT;
+
+        double threshold = block_loudness(total / n) + RELATIVE_GATE;
+        total = 0;
+        n = 0;
+        for (gsize i = 0; i < blocks.size(); ++i) {
+            double l = block_loudness(blocks[i]);
+            if (l > ABSOLUTE_GATE && l > threshold) {
+                total += blocks[i];
+                n++;
+            }
+        }
+        return n ? block_loudness(total / n) : -G_MAXFLOAT;
+    }
+
+    double noise_floor() const
+    {
+        guint64 windows = 0;
+        for (guint i = 0; i < HISTOGRAM_BINS; ++i)
+            windows += histogram[i];
+        if (!windows)
+            return -G_MAXFLOAT;
+
+        guint64 target = static_cast<guint64>(windows * NOISE_PERCENTILE);
+        guint64 seen = 0;
+        for (guint i = 0; i < HISTOGRAM_BINS; ++i) {
+            seen += histogram[i];
+            if (seen > target)
+                return HISTOGRAM_MIN + (i + 0.5) * HISTOGRAM_STEP;
+        }
+        return 0;
+    }
+};
+
+LoudnessMeter::LoudnessMeter(int rate, int channels)
+    : m_priv(new Priv(rate, channels))
+{
+}
+
+void LoudnessMeter::process(const float* samples, gsize n_frames)
+{
+    m_priv->accumulate(samples, n_frames * m_priv->channels);
+    m_priv->filter(samples, n_frames);
+}
+
+LoudnessStats LoudnessMeter::finish() const
+{
+    LoudnessStats stats;
+    guint64 n = m_priv->n_samples;
+    stats.peak = m_priv->peak > 0 ? 20.0 * std::log10(m_priv->peak) : -G_MAXFLOAT;
+    stats.rms = n ? to_db(m_priv->sum_squares / n) : -G_MAXFLOAT;
+    stats.loudness = m_priv->integrated_loudness();
+    stats.clipped_samples = m_priv->clipped;
+    stats.dc_offset = n ? m_priv->sum / n : 0;
+    stats.noise_floor = m_priv->noise_floor();
+    return stats;
+}
+}
@@ -0,0 +1,58 @@
+/*
+ * loudness.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOUDNESS_H
+#define _LOUDNESS_H
+
+#include <glib.h>
+#include <tr1/memory>
+
+namespace SC {
+
+struct LoudnessStats {
+    // dBFS
+    double peak;
+    double rms;
+    // EBU R128 integrated loudness in LUFS, -G_MAXFLOAT if everything was
+    // below the absolute gate
+    double loudness;
+    gint64 clipped_samples;
+    // mean sample value, as a fraction of full scale
+    double dc_offset;
+    // dBFS level that 10% of the recording is quieter than
+    double noise_floor;
+};
+
+// Level statistics of a whole recording, computed in a single pass
+class LoudnessMeter {
+public:
+    LoudnessMeter(int rate, int channels);
+
+    // @samples holds @n_frames interleaved frames
+    void process(const float* samples, gsize n_frames);
+    LoudnessStats finish() const;
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _LOUDNESS_H */
@@ -0,0 +1,139 @@
+/*
+ * media-init.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <glib.h>
+#include <gst/gst.h>
+#include <set>
+
+#include "media-init.h"
+
+namespace SC {
+
+static GMutex init_mutex;
+static GCond init_cond;
+static bool init_started = false;
+static bool init_done = false;
+
+static std::string extension_of(const char* filename)
+{
+    const char* dot = strrchr(filename, '.');
+    if (!dot || !dot[1])
+        return std::string();
+    gchar* lower = g_ascii_strdown(dot + 1, -1);
+    std::string extension(lower);
+    g_free(lower);
+    return extension;
+}
+
+// Loads the plugins that can handle the given extensions, so that the first
+// pipeline for such a file doesn't have to
+static void prewarm_decoders(const std::set<std::string>& extensions)
+{
+    GList* factories = gst_element_factory_list_get_elements(
+        GST_ELEMENT_FACTORY_TYPE_DECODER | GST_ELEMENT_FACTORY_TYPE_DEMUXER | GST_ELEMENT_FACTORY_TYPE_PARSER,
+        GST_RANK_MARGINAL);
+    // typefinders know which extensions belong to which media types
+    GList* typefinders = gst_type_find_factory_get_list();
+
+    for (std::set<std::string>::const_iterator it = extensions.begin(); it != extensions.end(); ++it) {
+        GstCaps* caps = gst_caps_new_empty();
+        for (GList* l = typefinders; l; l = l->next) {
+            GstTypeFindFactory* typefind = GST_TYPE_FIND_FACTORY(l->data);
+            const gchar* const* typefind_extensions = gst_type_find_factory_get_extensions(typefind);
+            for (int i = 0; typefind_extensions && typefind_extensions[i]; ++i) {
+                GstCaps* typefind_caps = gst_type_find_factory_get_caps(typefind);
+                if (*it == typefind_extensions[i] && typefind_caps)
+                    caps = gst_caps_merge(caps, gst_caps_ref(typefind_caps));
+            }
+        }
+
+        if (gst_caps_is_empty(caps)) {
+            g_debug("No known media type for .%s files", it->c_str());
+            gst_caps_unref(caps);
+            continue;
+        }
+
+        GList* matching = gst_element_factory_list_filter(factories, caps, GST_PAD_SINK, FALSE);
+        for (GList* l = matching; l; l = l->next) {
+            GstPluginFeature* loaded = gst_plugin_feature_load(GST_PLUGIN_FEATURE(l->data));
+            if (loaded) {
+                g_debug("Pre-warmed %s for .%s files", gst_plugin_feature_get_name(loaded), it->c_str());
+                gst_object_unref(loaded);
+            }
+        }
+        gst_plugin_feature_list_free(matching);
+        gst_caps_unref(caps);
+    }
+    gst_plugin_feature_list_free(typefinders);
+    gst_plugin_feature_list_free(factories);
+}
+
+static gpointer init_thread(gpointer data)
+{
+    std::string* prewarm_dir = reinterpret_cast<std::string*>(data);
+    gint64 start = g_get_monotonic_time();
+    gst_init(NULL, NULL);
+    g_debug("GStreamer initialized in %" G_GINT64_FORMAT "us", g_get_monotonic_time() - start);
+
+    // let anybody waiting for GStreamer go ahead before pre-warming
+    g_mutex_lock(&init_mutex);
+    init_done = true;
+    g_cond_broadcast(&init_cond);
+    g_mutex_unlock(&init_mutex);
+
+    if (!prewarm_dir->empty()) {
+        std::set<std::string> extensions;
+        GDir* dir = g_dir_open(prewarm_dir->c_str(), 0, NULL);
+        if (dir) {
+            const gchar* name = 0;
+            while ((name = g_dir_read_name(dir))) {
+                std::string extension = extension_of(name);
+                if (!extension.empty())
+                    extensions.insert(extension);
+            }
+            g_dir_close(dir);
+        }
+        prewarm_decoders(extensions);
+    }
+
+    delete prewarm_dir;
+    return NULL;
+}
+
+void media_init_start(const std::string& prewarm_dir)
+{
+    g_mutex_lock(&init_mutex);
+    if (!init_started) {
+        init_started = true;
+        g_thread_unref(g_thread_new("media-init", init_thread, new std::string(prewarm_dir)));
+    }
+    g_mutex_unlock(&init_mutex);
+}
+
+void media_ensure_initialized()
+{
+    media_init_start();
+    g_mutex_lock(&init_mutex);
+    while (!init_done)
+        g_cond_wait(&init_cond, &init_mutex);
+    g_mutex_unlock(&init_mutex);
+}
+}
@@ -0,0 +1,39 @@
+/*
+ * media-init.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MEDIA_INIT_H
+#define _MEDIA_INIT_H
+
+#include <string>
+
+namespace SC {
+
+// Starts initializing GStreamer in a background thread so that loading the
+// plugin registry doesn't delay startup. If @prewarm_dir is not empty, the
+// decoder plugins needed for the file types found in that directory are
+// loaded as well. Calling it more than once has no effect.
+void media_init_start(const std::string& prewarm_dir = std::string());
+
+// Blocks until GStreamer is initialized, starting initialization if needed.
+// Must be called before using any GStreamer API.
+void media_ensure_initialized();
+}
+
+#endif /* _MEDIA_INIT_H */
@@ -0,0 +1,212 @@
+/*
+ * preview-pool.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <list>
+
+#include "media-init.h"
+#include "preview-pool.h"
+
+namespace SC {
+
+static const guint DEFAULT_CAPACITY = 4;
+// prerolled pipelines hold on to an audio device; after this long without
+// the pool being used they are shut down until they are needed again
+static const guint IDLE_TIMEOUT_S = 30;
+
+struct PreviewPool::Priv {
+    struct Entry {
+        std::string uri;
+        GstElement* pipeline;
+        // shut down, see on_idle()
+        bool idle;
+
+        Entry(const std::string& uri, GstElement* pipeline)
+            : uri(uri)
+            , pipeline(pipeline)
+            , idle(false)
+        {
+        }
+    };
+
+    guint capacity;
+    // most recently prepared first
+    std::list<Entry> entries;
+    sigc::connection idle_timer;
+
+    Priv(guint capacity)
+        : capacity(capacity)
+    {
+    }
+
+    ~Priv()
+    {
+        idle_timer.disconnect();
+        while (!entries.empty()) {
+            dispose(entries.back().pipeline);
+            entries.pop_back();
+        }
+    }
+
+    static GstElement* create_pipeline(const std::string& uri)
+    {
+        media_ensure_initialized();
+        GstElement* pipeline = gst_element_factory_make("playbin", NULL);
+        g_object_set(pipeline, "uri", uri.c_str(), NULL);
+        // prerolling happens in the streaming threads, so this doesn't block
+        gst_element_set_state(pipeline, GST_STATE_PAUSED);
+        return pipeline;
+    }
+
+    static void dispose(GstElement* pipeline)
+    {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_object_unref(pipeline);
+    }
+
+    // Drops the messages a pipeline posted while it was in the pool, so that
+    // its next user doesn't act on e.g. the ASYNC_DONE of the rewind
+    static void drain_bus(GstElement* pipeline)
+    {
+        GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+        GstMessage* message = 0;
+        while ((message = gst_bus_pop(bus)))
+            gst_message_unref(message);
+        gst_object_unref(bus);
+    }
+
+    static void wake(Entry& entry)
+    {
+        if (!entry.idle)
+            return;
+        gst_element_set_state(entry.pipeline, GST_STATE_PAUSED);
+        entry.idle = false;
+    }
+
+    void schedule_idle()
+    {
+        idle_timer.disconnect();
+        if (!entries.empty())
+            idle_timer = Glib::signal_timeout().connect_seconds(sigc::mem_fun(this, &Priv::on_idle),
+                                                                IDLE_TIMEOUT_S);
+    }
+
+    // NULL rather than READY, which still keeps the audio sink open
+    bool on_idle()
+    {
+        for (std::list<Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+            if (it->idle)
+                continue;
+            gst_element_set_state(it->pipeline, GST_STATE_NULL);
+            drain_bus(it->pipeline);
+            it->idle = true;
+        }
+        return false;
+    }
+
+    std::list<Entry>::iterator find(const std::string& uri)
+    {
+        std::list<Entry>::iterator it = entries.begin();
+        for (; it != entries.end(); ++it) {
+            if (it->uri == uri)
+                break;
+        }
+        return it;
+    }
+
+    void trim()
+    {
+        while (entries.size() > capacity) {
+            dispose(entries.back().pipeline);
+            entries.pop_back();
+        }
+    }
+};
+
+PreviewPool::PreviewPool(guint capacity)
+    : m_priv(new Priv(capacity))
+{
+}
+
+std::tr1::shared_ptr<PreviewPool> PreviewPool::get_default()
+{
+    static std::tr1::shared_ptr<PreviewPool> pool;
+    if (!pool)
+        pool.reset(new PreviewPool(DEFAULT_CAPACITY));
+    return pool;
+}
+
+void PreviewPool::prepare(const std::vector<Glib::RefPtr<Gio::File> >& files)
+{
+    // walk backwards so that the most likely file ends up in front
+    for (std::vector<Glib::RefPtr<Gio::File> >::const_reverse_iterator it = files.rbegin();
+         it != files.rend();
+         ++it) {
+        std::string uri = (*it)->get_uri();
+        std::list<Priv::Entry>::iterator existing = m_priv->find(uri);
+        if (existing != m_priv->entries.end()) {
+            Priv::wake(*existing);
+            m_priv->entries.splice(m_priv->entries.begin(), m_priv->entries, existing);
+            continue;
+        }
+        m_priv->entries.push_front(Priv::Entry(uri, Priv::create_pipeline(uri)));
+    }
+    m_priv->trim();
+    m_priv->schedule_idle();
+}
+
+GstElement* PreviewPool::acquire(const Glib::RefPtr<Gio::File>& file)
+{
+    std::string uri = file->get_uri();
+    std::list<Priv::Entry>::iterator existing = m_priv->find(uri);
+    if (existing == m_priv->entries.end())
+        return Priv::create_pipeline(uri);
+
+    GstElement* pipeline = existing->pipeline;
+    Priv::drain_bus(pipeline);
+    Priv::wake(*existing);
+    m_priv->entries.erase(existing);
+    return pipeline;
+}
+
+void PreviewPool::release(GstElement* pipeline)
+{
+    g_return_if_fail(pipeline);
+    gchar* uri = 0;
+    g_object_get(pipeline, "uri", &uri, NULL);
+    if (!uri || m_priv->find(uri) != m_priv->entries.end()) {
+        Priv::dispose(pipeline);
+        g_free(uri);
+        return;
+    }
+
+    // pause and rewind; the flushing seek prerolls the start of the file again
+    Priv::drain_bus(pipeline);
+    gst_element_set_state(pipeline, GST_STATE_PAUSED);
+    gst_element_seek_simple(pipeline,
+                            GST_FORMAT_TIME,
+                            GstSeekFlags(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT),
+                            0);
+    // a released pipeline is less likely to be needed than prepared ones
+    m_priv->entries.push_back(Priv::Entry(uri, pipeline));
+    g_free(uri);
+    m_priv->trim();
+    m_priv->schedule_idle();
+}
+}
@@ -0,0 +1,56 @@
+/*
+ * preview-pool.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PREVIEW_POOL_H
+#define _PREVIEW_POOL_H
+
+#include <giomm.h>
+#include <gst/gst.h>
+#include <tr1/memory>
+#include <vector>
+
+namespace SC {
+// Keeps a few playback pipelines prerolled (i.e. PAUSED with the first
+// buffer decoded) so that playback of files that are likely to be played
+// next can start without waiting for the file to be opened and decoded.
+// Pipelines that sit in the pool unused for a while are shut down, so that
+// they don't keep the audio device, and preroll again when they are needed.
+class PreviewPool {
+public:
+    PreviewPool(guint capacity);
+    static std::tr1::shared_ptr<PreviewPool> get_default();
+
+    // Starts prerolling pipelines for @files, most likely first. Pipelines
+    // for files that were prepared earlier are dropped if the pool is full.
+    void prepare(const std::vector<Glib::RefPtr<Gio::File> >& files);
+    // Returns a pipeline for @file, taking it out of the pool if it was
+    // prepared; otherwise a new pipeline is created and starts prerolling.
+    // The caller owns the returned reference and gives it back with release().
+    GstElement* acquire(const Glib::RefPtr<Gio::File>& file);
+    // Rewinds @pipeline and keeps it prerolled if there is room for it
+    void release(GstElement* pipeline);
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _PREVIEW_POOL_H */
@@ -0,0 +1,158 @@
+/*
+ * quality-cell-renderer.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "quality-cell-renderer.h"
+
+namespace SC {
+
+static const int N_STARS = 5;
+static const int STAR_SPACING = 2;
+
+struct QualityCellRenderer::Priv {
+    int star_size;
+    Cairo::RefPtr<Cairo::Surface> starred;
+    Cairo::RefPtr<Cairo::Surface> non_starred;
+    Glib::RefPtr<Gtk::IconTheme> theme;
+    sigc::connection theme_changed;
+
+    Priv()
+        : star_size(16)
+    {
+        int width, height;
+        if (Gtk::IconSize::lookup(Gtk::ICON_SIZE_MENU, width, height))
+            star_size = std::max(width, height);
+    }
+
+    ~Priv()
+    {
+        theme_changed.disconnect();
+    }
+
+    int width() const
+    {
+        return N_STARS * star_size + (N_STARS - 1) * STAR_SPACING;
+    }
+
+    Cairo::RefPtr<Cairo::Surface> load_star(const char* icon_name)
+    {
+        Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+        try {
+            pixbuf = theme->load_icon(icon_name, star_size, Gtk::ICON_LOOKUP_FORCE_SIZE);
+        } catch (const Glib::Error& error) {
+            g_warning("Unable to load icon '%s': %s", icon_name, error.what().c_str());
+            return Cairo::RefPtr<Cairo::Surface>();
+        }
+
+        Cairo::RefPtr<Cairo::ImageSurface> surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, pixbuf->get_width(), pixbuf->get_height());
+        Cairo::RefPtr<Cairo::Context> cr = Cairo::Context::create(surface);
+        Gdk::Cairo::set_source_pixbuf(cr, pixbuf, 0, 0);
+        cr->paint();
+        return surface;
+    }
+
+    // (re)creates the star surfaces when they haven't been rendered yet for
+    // the icon theme of @widget's screen
+    void ensure_surfaces(Gtk::Widget& widget)
+    {
+        Glib::RefPtr<Gtk::IconTheme> screen_theme = Gtk::IconTheme::get_for_screen(widget.get_screen());
+        if (screen_theme == theme && starred)
+            return;
+
+        if (screen_theme != theme) {
+            theme_changed.disconnect();
+            theme = screen_theme;
+            theme_changed = theme->signal_changed().connect(sigc::mem_fun(this, &Priv::clear));
+        }
+
+        starred = load_star("starred");
+        non_starred = load_star("non-starred");
+    }
+
+    void clear()
+    {
+        starred.clear();
+        non_starred.clear();
+    }
+};
+
+QualityCellRenderer::QualityCellRenderer()
+    : Glib::ObjectBase(typeid(QualityCellRenderer))
+    , Gtk::CellRenderer()
+    , m_quality(*this, "quality", 0)
+    , m_priv(new Priv())
+{
+    property_xalign() = 0.0;
+}
+
+Glib::PropertyProxy<int> QualityCellRenderer::property_quality()
+{
+    return m_quality.get_proxy();
+}
+
+void QualityCellRenderer::render_vfunc(const Cairo::RefPtr<Cairo::Context>& cr,
+                                       Gtk::Widget& widget,
+                                       const Gdk::Rectangle& /*background_area*/,
+                                       const Gdk::Rectangle& cell_area,
+                                       Gtk::CellRendererState /*flags*/)
+{
+    int quality = m_quality.get_value();
+    // unrated recordings are drawn as an empty cell
+    if (quality <= 0)
+        return;
+
+    m_priv->ensure_surfaces(widget);
+    if (!m_priv->starred || !m_priv->non_starred)
+        return;
+
+    int xpad = property_xpad();
+    int ypad = property_ypad();
+    int free_width = cell_area.get_width() - 2 * xpad - m_priv->width();
+    int free_height = cell_area.get_height() - 2 * ypad - m_priv->star_size;
+    int x = cell_area.get_x() + xpad + std::max(0, static_cast<int>(free_width * property_xalign()));
+    int y = cell_area.get_y() + ypad + std::max(0, static_cast<int>(free_height * property_yalign()));
+
+    cr->save();
+    cr->rectangle(cell_area.get_x(), cell_area.get_y(), cell_area.get_width(), cell_area.get_height());
+    cr->clip();
+    for (int i = 1; i <= N_STARS; ++i) {
+        cr->set_source(quality >= i ? m_priv->starred : m_priv->non_starred, x, y);
+        cr->rectangle(x, y, m_priv->star_size, m_priv->star_size);
+        cr->fill();
+        x += m_priv->star_size + STAR_SPACING;
+    }
+    cr->restore();
+}
+
+void QualityCellRenderer::get_preferred_width_vfunc(Gtk::Widget& /*widget*/,
+                                                    int& minimum_width,
+                                                    int& natural_width) const
+{
+    minimum_width = natural_width = m_priv->width() + 2 * property_xpad();
+}
+
+void QualityCellRenderer::get_preferred_height_vfunc(Gtk::Widget& /*widget*/,
+                                                     int& minimum_height,
+                                                     int& natural_height) const
+{
+    minimum_height = natural_height = m_priv->star_size + 2 * property_ypad();
+}
+}
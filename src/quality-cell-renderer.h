@@ -0,0 +1,59 @@
+/*
+ * quality-cell-renderer.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _QUALITY_CELL_RENDERER_H
+#define _QUALITY_CELL_RENDERER_H
+
+#include <gtkmm.h>
+#include <tr1/memory>
+
+namespace SC {
+// Draws a recording's quality as a row of five stars.  The star icons are
+// rendered into cairo surfaces once and then painted for every cell, so that
+// drawing a row doesn't look up or scale theme icons.
+class QualityCellRenderer : public Gtk::CellRenderer {
+public:
+    QualityCellRenderer();
+
+    // also settable as the "quality" property from a cell data function
+    Glib::PropertyProxy<int> property_quality();
+
+protected:
+    virtual void render_vfunc(const Cairo::RefPtr<Cairo::Context>& cr,
+                              Gtk::Widget& widget,
+                              const Gdk::Rectangle& background_area,
+                              const Gdk::Rectangle& cell_area,
+                              Gtk::CellRendererState flags);
+    virtual void get_preferred_width_vfunc(Gtk::Widget& widget,
+                                           int& minimum_width,
+                                           int& natural_width) const;
+    virtual void get_preferred_height_vfunc(Gtk::Widget& widget,
+                                            int& minimum_height,
+                                            int& natural_height) const;
+
+private:
+    Glib::Property<int> m_quality;
+
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _QUALITY_CELL_RENDERER_H */
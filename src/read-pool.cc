@@ -0,0 +1,250 @@
+/*
+ * read-pool.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+
+#include "GRefPtr.h"
+#include "read-pool.h"
+#include "task.h"
+
+namespace SC {
+
+#define READ_POOL_KEY "sc-read-pool"
+
+struct Reader {
+    GRefPtr<GomAdapter> adapter;
+    // reads queued on this connection that haven't finished yet
+    volatile gint pending;
+
+    Reader(GomAdapter* adapter)
+        : adapter(adapter)
+        , pending(0)
+    {
+    }
+};
+
+struct QueuedRead {
+    std::tr1::shared_ptr<Reader> reader;
+    GomAdapterCallback callback;
+    gpointer user_data;
+
+    QueuedRead(const std::tr1::shared_ptr<Reader>& reader,
+               GomAdapterCallback callback,
+               gpointer user_data)
+        : reader(reader)
+        , callback(callback)
+        , user_data(user_data)
+    {
+    }
+};
+
+// runs in the thread of a reader
+static void queued_read_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    QueuedRead* read = reinterpret_cast<QueuedRead*>(user_data);
+    read->callback(adapter, read->user_data);
+    g_atomic_int_add(&read->reader->pending, -1);
+    delete read;
+}
+
+// runs in the thread of a reader, before any read is queued on it
+static void set_query_only_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    GError* error = 0;
+    if (!gom_adapter_execute_sql(adapter, "PRAGMA query_only = ON", &error)) {
+        g_warning("Unable to make read connection read-only: %s", error->message);
+        g_clear_error(&error);
+    }
+}
+
+struct WalTask : public Task {
+    WalTask(const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+    {
+    }
+};
+
+// runs in the thread of the repository's adapter
+static void enable_wal_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    WalTask* task = reinterpret_cast<WalTask*>(user_data);
+    GError* error = 0;
+    // persistent, later connections to the database use WAL as well
+    if (!gom_adapter_execute_sql(adapter, "PRAGMA journal_mode = WAL", &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    g_task_return_boolean(task->task(), true);
+}
+
+// a connection that finished opening after the pool was closed or destroyed
+static void close_late_reader(GomAdapter* adapter)
+{
+    GError* error = 0;
+    if (!gom_adapter_close_sync(adapter, &error)) {
+        g_warning("Unable to close read connection: %s", error->message);
+        g_clear_error(&error);
+    }
+}
+
+struct ReadPool::Priv {
+    GomRepository* repository;
+    std::string uri;
+    guint size;
+    bool closed;
+    std::vector<std::tr1::shared_ptr<Reader> > readers;
+
+    Priv(GomRepository* repository)
+        : repository(repository)
+        , size(0)
+        , closed(false)
+    {
+    }
+
+    GomAdapter* writer() const
+    {
+        return gom_repository_get_adapter(repository);
+    }
+
+    // The callbacks below only hold weak references: the pool goes away
+    // with its repository, possibly before WAL is enabled or all
+    // connections are open.
+    static void on_wal_enabled(const Glib::RefPtr<Gio::AsyncResult>& result,
+                               const std::tr1::weak_ptr<Priv>& weak_self)
+    {
+        GError* error = 0;
+        if (!g_task_propagate_boolean(G_TASK(result->gobj()), &error)) {
+            // without WAL, readers would wait for writes anyway
+            g_warning("Unable to enable WAL, not opening read connections: %s", error->message);
+            g_clear_error(&error);
+            return;
+        }
+
+        std::tr1::shared_ptr<Priv> self = weak_self.lock();
+        if (!self || self->closed)
+            return;
+        for (guint i = 0; i < self->size; ++i) {
+            GomAdapter* adapter = gom_adapter_new();
+            gom_adapter_open_async(adapter,
+                                   self->uri.c_str(),
+                                   &Priv::reader_opened_proxy,
+                                   new std::tr1::weak_ptr<Priv>(self));
+        }
+    }
+
+    static void reader_opened_proxy(GObject* source, GAsyncResult* result, gpointer user_data)
+    {
+        std::tr1::weak_ptr<Priv>* weak_self = reinterpret_cast<std::tr1::weak_ptr<Priv>*>(user_data);
+        std::tr1::shared_ptr<Priv> self = weak_self->lock();
+        delete weak_self;
+
+        GomAdapter* adapter = GOM_ADAPTER(source);
+        GError* error = 0;
+        if (!gom_adapter_open_finish(adapter, result, &error)) {
+            g_warning("Unable to open read connection: %s", error->message);
+            g_clear_error(&error);
+            g_object_unref(adapter);
+            return;
+        }
+        if (!self || self->closed) {
+            close_late_reader(adapter);
+            g_object_unref(adapter);
+            return;
+        }
+
+        // queued first, so it runs before the reads
+        gom_adapter_queue_write(adapter, set_query_only_proxy, 0);
+        self->readers.push_back(std::tr1::shared_ptr<Reader>(new Reader(adapter)));
+        g_object_unref(adapter);
+        g_debug("Opened read connection %zu", self->readers.size());
+    }
+};
+
+static void delete_read_pool(gpointer data)
+{
+    delete reinterpret_cast<std::tr1::shared_ptr<ReadPool>*>(data);
+}
+
+std::tr1::shared_ptr<ReadPool> ReadPool::get(GomRepository* repository)
+{
+    g_return_val_if_fail(GOM_IS_REPOSITORY(repository), std::tr1::shared_ptr<ReadPool>());
+
+    std::tr1::shared_ptr<ReadPool>* pool = reinterpret_cast<std::tr1::shared_ptr<ReadPool>*>(
+        g_object_get_data(G_OBJECT(repository), READ_POOL_KEY));
+    if (!pool) {
+        pool = new std::tr1::shared_ptr<ReadPool>(new ReadPool(repository));
+        g_object_set_data_full(G_OBJECT(repository), READ_POOL_KEY, pool, delete_read_pool);
+    }
+    return *pool;
+}
+
+ReadPool::ReadPool(GomRepository* repository)
+    : m_priv(new Priv(repository))
+{
+}
+
+void ReadPool::open(const std::string& uri, guint size)
+{
+    g_return_if_fail(m_priv->size == 0);
+    m_priv->uri = uri;
+    m_priv->size = size;
+    WalTask* task = new WalTask(sigc::bind(sigc::ptr_fun(&Priv::on_wal_enabled),
+                                           std::tr1::weak_ptr<Priv>(m_priv)));
+    gom_adapter_queue_write(m_priv->writer(), enable_wal_proxy, task);
+}
+
+void ReadPool::queue_read(GomAdapterCallback callback, gpointer user_data)
+{
+    if (m_priv->readers.empty()) {
+        gom_adapter_queue_read(m_priv->writer(), callback, user_data);
+        return;
+    }
+
+    std::tr1::shared_ptr<Reader> reader = m_priv->readers[0];
+    for (guint i = 1; i < m_priv->readers.size(); ++i) {
+        if (g_atomic_int_get(&m_priv->readers[i]->pending) < g_atomic_int_get(&reader->pending))
+            reader = m_priv->readers[i];
+    }
+    g_atomic_int_inc(&reader->pending);
+    gom_adapter_queue_read(reader->adapter.get(),
+                           queued_read_proxy,
+                           new QueuedRead(reader, callback, user_data));
+}
+
+bool ReadPool::close_sync(GError** error)
+{
+    // connections still being opened are closed when they are done
+    m_priv->closed = true;
+    std::vector<std::tr1::shared_ptr<Reader> > readers;
+    readers.swap(m_priv->readers);
+    bool ok = true;
+    for (std::vector<std::tr1::shared_ptr<Reader> >::iterator it = readers.begin(); it != readers.end(); ++it) {
+        GError* local_error = 0;
+        if (!gom_adapter_close_sync((*it)->adapter.get(), &local_error)) {
+            if (ok)
+                g_propagate_error(error, local_error);
+            else
+                g_error_free(local_error);
+            ok = false;
+        }
+    }
+    return ok;
+}
+}
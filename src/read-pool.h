@@ -0,0 +1,66 @@
+/*
+ * read-pool.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _READ_POOL_H
+#define _READ_POOL_H
+
+#include <gom/gom.h>
+#include <string>
+#include <tr1/memory>
+
+namespace SC {
+
+/*
+ * Read-only connections to the database of a GomRepository, so that queries
+ * for lists and searches don't wait behind imports, saves and other long
+ * writes on the repository's own adapter. The database is switched to WAL
+ * mode, in which readers see the last committed state while a write is in
+ * progress, and every connection of the pool is set to query_only.
+ *
+ * There is one pool per GomRepository. Until open() is called and the
+ * connections are open, reads are queued on the repository's adapter, so
+ * e.g. in-memory databases keep working with a single connection.
+ *
+ * The callbacks of queue_read() may run concurrently with each other and
+ * with writes, in different threads. They must only use the adapter they
+ * are passed and must not need to see the effects of writes that haven't
+ * completed yet. Loading resources that will be saved again still has to go
+ * through the repository, since resources are bound to its adapter.
+ */
+class ReadPool {
+public:
+    static std::tr1::shared_ptr<ReadPool> get(GomRepository* repository);
+
+    // Opens @size connections to the database at @uri in the background
+    void open(const std::string& uri, guint size);
+    // Runs @callback on the connection with the fewest queued reads
+    void queue_read(GomAdapterCallback callback, gpointer user_data);
+    // Closes the connections after the reads queued on them have run
+    bool close_sync(GError** error);
+
+private:
+    ReadPool(GomRepository* repository);
+
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _READ_POOL_H */
@@ -19,7 +19,7 @@
  */
 
 #include "header-label.h"
-#include "location-tree-model.h"
+#include "location-entry.h"
 #include "recording-form.h"
 #include "simple-audio-player.h"
 #include "util.h"
@@ -50,8 +50,7 @@ struct RecordingForm::Priv {
     HeaderLabel date_label;
     Gtk::Label date_value_label;
     HeaderLabel location_label;
-    Gtk::ComboBox location_selector;
-    Glib::RefPtr<LocationTreeModel> location_model;
+    LocationEntry location_entry;
 
     Priv(const std::tr1::shared_ptr<Recording>& rec,
          const std::tr1::shared_ptr<Repository>& repository)
@@ -70,7 +69,7 @@ struct RecordingForm::Priv {
         , date_label("Date", Gtk::ALIGN_END, Gtk::ALIGN_CENTER)
         , date_value_label("", Gtk::ALIGN_START, Gtk::ALIGN_CENTER)
         , location_label("Location", Gtk::ALIGN_END, Gtk::ALIGN_CENTER)
-        , location_model(LocationTreeModel::create())
+        , location_entry(repository)
     {
         id_label.show();
         id_value_label.set_text(Glib::ustring::format(recording->id()));
@@ -109,8 +108,8 @@ struct RecordingForm::Priv {
         elevation_entry.set_numeric(true);
         elevation_entry.set_value(recording->elevation());
         location_label.show();
-        location_selector.show();
-        location_selector.set_hexpand(true);
+        location_entry.show();
+        location_entry.set_hexpand(true);
         remarks_label.show();
         remarks_scroll.set_hexpand(true);
         remarks_scroll.add(remarks_entry);
@@ -127,81 +126,25 @@ struct RecordingForm::Priv {
             date_value_label.set_text(d.format("%c"));
         }
 
-        repository->get_locations_async(sigc::mem_fun(this, &Priv::got_locations));
+        recording->get_location_async(sigc::mem_fun(this, &Priv::got_location));
 
         // handlers for applying changes to the form
         remarks_entry.get_buffer()->signal_changed().connect(sigc::mem_fun(this, &Priv::on_property_changed));
         recordist_entry.signal_changed().connect(sigc::mem_fun(this, &Priv::on_property_changed));
         quality_widget.signal_changed().connect(sigc::mem_fun(this, &Priv::on_property_changed));
         elevation_entry.signal_value_changed().connect(sigc::mem_fun(this, &Priv::on_property_changed));
-        location_selector.signal_changed().connect(sigc::mem_fun(this, &Priv::on_property_changed));
-    }
-
-    void set_active_location(const std::tr1::shared_ptr<Location>& location)
-    {
-        g_debug("%s: setting active location to %u", G_STRFUNC, location->id());
-        g_debug("Checking %u locations", location_model->children().size());
-        for (Gtk::TreeModel::iterator it = location_model->children().begin();
-             it != location_model->children().end();
-             ++it) {
-            guint64 id = (*it)[location_model->columns().id];
-            g_debug("checking location %u", id);
-            if (id == location->id()) {
-                location_selector.set_active(it);
-                break;
-            }
-        }
+        location_entry.signal_location_changed().connect(sigc::mem_fun(this, &Priv::on_property_changed));
     }
 
     void got_location(const std::tr1::shared_ptr<Location>& location)
     {
         if (location) {
             g_debug("Got location %s", location->name().c_str());
-            set_active_location(location);
+            location_entry.set_location(location->id(), location->name());
         } else
             g_debug("Unable to get location");
     }
 
-    void got_locations(const Glib::RefPtr<Gio::AsyncResult>& result)
-    {
-        try
-        {
-            GomResourceGroup* locations = repository->get_locations_finish(result);
-            gom_resource_group_fetch_async(locations, 0, gom_resource_group_get_count(locations), &Priv::on_locations_fetched_proxy, this);
-        }
-        catch (const Glib::Error& e)
-        {
-            g_warning(e.what().c_str());
-            return;
-        }
-    }
-
-    static void on_locations_fetched_proxy(GObject* source,
-                                           GAsyncResult* result,
-                                           gpointer user_data)
-    {
-        GError* error = 0;
-        Priv* self = reinterpret_cast<Priv*>(user_data);
-        GomResourceGroup* locations = GOM_RESOURCE_GROUP(source);
-        if (!gom_resource_group_fetch_finish(locations,
-                                             result,
-                                             &error)) {
-            g_error("%s", error->message);
-            g_clear_error(&error);
-            return;
-        }
-        self->on_locations_fetched(locations);
-    }
-
-    void on_locations_fetched(GomResourceGroup* locations)
-    {
-        location_model->set_resource_group(locations);
-        location_selector.set_model(location_model);
-        location_selector.pack_start(location_model->columns().name);
-
-        recording->get_location_async(sigc::mem_fun(this, &Priv::got_location));
-    }
-
     void on_file_open_clicked()
     {
         Glib::RefPtr<Gio::File> file = recording->file();
@@ -215,10 +158,7 @@ struct RecordingForm::Priv {
     void on_property_changed()
     {
         g_debug("Updating resource: quality=%i, elevation=%g", quality_widget.quality(), elevation_entry.get_value());
-        gint64 location_id = 0;
-        Gtk::TreeModel::iterator active_iter = location_selector.get_active();
-        if (active_iter)
-            location_id = (*active_iter)[location_model->columns().id];
+        gint64 location_id = location_entry.location_id();
         g_object_set(recording->resource(),
                      "remarks",
                      remarks_entry.get_buffer()->get_text().c_str(),
@@ -288,7 +228,7 @@ RecordingForm::RecordingForm(const std::tr1::shared_ptr<Recording>& recording,
     attach_next_to(m_priv->elevation_label, m_priv->quality_label, Gtk::POS_BOTTOM, 1, 1);
     attach_next_to(m_priv->elevation_entry, m_priv->elevation_label, Gtk::POS_RIGHT, 3, 1);
     attach_next_to(m_priv->location_label, m_priv->elevation_label, Gtk::POS_BOTTOM, 1, 1);
-    attach_next_to(m_priv->location_selector, m_priv->location_label, Gtk::POS_RIGHT, 3, 1);
+    attach_next_to(m_priv->location_entry, m_priv->location_label, Gtk::POS_RIGHT, 3, 1);
     attach_next_to(m_priv->remarks_label, m_priv->location_label, Gtk::POS_BOTTOM, 1, 1);
     attach_next_to(m_priv->remarks_scroll, m_priv->remarks_label, Gtk::POS_BOTTOM, 4, 4);
 }
@@ -18,91 +18,489 @@
  * along with SoundCollectio. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
+#include "analysis-job.h"
 #include "application.h"
+#include "bulk-edit-dialog.h"
 #include "GRefPtr.h"
 #include "import-dialog.h"
+#include "keyset-pager.h"
 #include "recording-list.h"
 #include "recording-tree-model.h"
 #include "recording-tree-view.h"
+#include "simple-audio-player.h"
+#include "preview-pool.h"
 #include "recording-window.h"
+#include "startup-trace.h"
 
 namespace SC {
+
+// how many recordings "Find Similar" shows besides the selected one
+static const guint SIMILAR_COUNT = 50;
+// the rows saved for painting the list at the next start, enough to fill a
+// maximized window
+static const guint SNAPSHOT_ROWS = 2 * KeysetPager::PAGE_SIZE;
+
 struct RecordingList::Priv {
     Gtk::ScrolledWindow scroller;
     Glib::RefPtr<RecordingTreeModel> tree_model;
+    std::tr1::shared_ptr<KeysetPager> pager;
     RecordingTreeView tree_view;
     std::tr1::shared_ptr<Repository> repository;
     Gtk::Button import_button;
+    Gtk::Button edit_button;
+    Gtk::Button analyze_button;
+    Gtk::Button similar_button;
+    bool showing_similar;
+    AnalysisVector analyses;
+    // the analyses of the current run, either all of them or only the one
+    // that similarity search needs
+    AnalysisVector running_analyses;
+    guint current_analysis;
+    // files were imported while a run was under way; their analyses run
+    // once it is done
+    bool import_analyses_pending;
+    std::tr1::shared_ptr<AnalysisJob> analysis_job;
+    SimpleAudioPlayer player;
+    Gtk::Scale position_scale;
+    bool scrubbing;
+    Gtk::Box button_box;
     Gtk::Box layout;
+    sigc::connection first_draw_connection;
+    sigc::connection rows_shown_connection;
+    bool rows_shown;
+    sigc::signal<void> signal_rows_shown;
+    sigc::connection closing_connection;
 
     Priv(const std::tr1::shared_ptr<Repository>& repository)
         : tree_model(RecordingTreeModel::create())
         , repository(repository)
         , import_button("Import Recording")
+        , edit_button("Edit Selected")
+        , analyze_button("Analyze Collection")
+        , similar_button("Find Similar")
+        , showing_similar(false)
+        , analyses(collection_analyses())
+        , current_analysis(0)
+        , import_analyses_pending(false)
+        , position_scale(Gtk::ORIENTATION_HORIZONTAL)
+        , scrubbing(false)
+        , button_box(Gtk::ORIENTATION_HORIZONTAL)
         , layout(Gtk::ORIENTATION_VERTICAL)
+        , rows_shown(false)
     {
         scroller.add(tree_view);
         tree_view.signal_row_activated().connect(
             sigc::mem_fun(this, &Priv::on_row_activated));
         scroller.show();
         tree_view.show();
-        refresh_view();
+        // paint what was shown at the last exit while the database is
+        // checked and queried; the rows are replaced once the query is done
+        if (tree_model->load_snapshot(snapshot_path())) {
+            tree_view.set_model(tree_model);
+            trace_first_paint();
+        }
+        closing_connection = repository->signal_closing().connect(
+            sigc::mem_fun(this, &Priv::save_snapshot));
+        // don't query the database until its schema is known to be current
+        repository->run_when_ready(sigc::mem_fun(this, &Priv::refresh_view));
 
         layout.show();
         layout.pack_start(scroller, true, true);
         import_button.show();
-        layout.pack_start(import_button, false, false);
+        edit_button.show();
+        edit_button.set_sensitive(false);
+        analyze_button.show();
+        similar_button.show();
+        similar_button.set_sensitive(false);
+        player.show();
+        button_box.pack_start(player, false, false);
+        position_scale.set_draw_value(false);
+        position_scale.set_range(0, 1);
+        position_scale.set_sensitive(false);
+        position_scale.set_size_request(150, -1);
+        position_scale.show();
+        button_box.pack_start(position_scale, false, false);
+        player.signal_position_changed().connect(
+            sigc::mem_fun(this, &Priv::on_position_changed));
+        position_scale.signal_change_value().connect(
+            sigc::mem_fun(this, &Priv::on_scale_change_value));
+        position_scale.signal_button_release_event().connect(
+            sigc::mem_fun(this, &Priv::on_scale_released), false);
+        button_box.pack_start(import_button, true, true);
+        button_box.pack_start(edit_button, true, true);
+        button_box.pack_start(similar_button, true, true);
+        button_box.pack_start(analyze_button, true, true);
+        button_box.show();
+        layout.pack_start(button_box, false, false);
 
         repository->signal_database_changed().connect(
             sigc::mem_fun(this, &Priv::refresh_view));
 
         import_button.signal_clicked().connect(
             sigc::mem_fun(this, &Priv::on_import_clicked));
+        edit_button.signal_clicked().connect(
+            sigc::mem_fun(this, &Priv::on_edit_clicked));
+        analyze_button.signal_clicked().connect(
+            sigc::mem_fun(this, &Priv::on_analyze_clicked));
+        similar_button.signal_clicked().connect(
+            sigc::mem_fun(this, &Priv::on_similar_clicked));
+        tree_view.get_selection()->signal_changed().connect(
+            sigc::mem_fun(this, &Priv::on_selection_changed));
+    }
+
+    void on_selection_changed()
+    {
+        std::vector<Gtk::TreeModel::Path> rows = tree_view.get_selection()->get_selected_rows();
+        // the rows of a snapshot can't be matched in the database
+        edit_button.set_sensitive(!rows.empty() && tree_model->has_pager());
+        similar_button.set_sensitive(showing_similar || rows.size() == 1);
+        if (rows.size() == 1)
+            update_preview(rows[0][0]);
+        else {
+            player.set_file(Glib::RefPtr<Gio::File>());
+            position_scale.set_sensitive(false);
+        }
+    }
+
+    Glib::RefPtr<Gio::File> file_at(int index) const
+    {
+        Gtk::TreeModel::Path path;
+        path.push_back(index);
+        std::string file = tree_model->peek_file(path);
+        if (file.empty())
+            return Glib::RefPtr<Gio::File>();
+        return Gio::File::create_for_path(file);
+    }
+
+    // Plays the selected row in the player and keeps the rows around it
+    // prerolled, since they're the ones most likely to be auditioned next
+    void update_preview(int index)
+    {
+        std::vector<Glib::RefPtr<Gio::File> > neighbours;
+        const int offsets[] = { 1, -1, 2 };
+        for (guint i = 0; i < G_N_ELEMENTS(offsets); ++i) {
+            Glib::RefPtr<Gio::File> file = file_at(index + offsets[i]);
+            if (file)
+                neighbours.push_back(file);
+        }
+
+        Glib::RefPtr<Gio::File> file = file_at(index);
+        player.set_file(file);
+        PreviewPool::get_default()->prepare(neighbours);
+        position_scale.set_value(0);
+        position_scale.set_sensitive(file ? true : false);
+    }
+
+    void on_position_changed(double position, double duration)
+    {
+        // don't fight with the user while they drag the slider
+        if (scrubbing)
+            return;
+        position_scale.set_range(0, std::max(duration, 0.001));
+        position_scale.set_value(position);
+    }
+
+    bool on_scale_change_value(Gtk::ScrollType scroll, double value)
+    {
+        // fast key unit seeks while dragging, so that scrubbing keeps up
+        scrubbing = true;
+        player.seek(value, false);
+        return false;
+    }
+
+    bool on_scale_released(GdkEventButton* event)
+    {
+        if (scrubbing) {
+            scrubbing = false;
+            player.seek(position_scale.get_value(), true);
+        }
+        return false;
+    }
+
+    void on_bulk_update_done(const Glib::RefPtr<Gio::AsyncResult>& result,
+                             const std::vector<gint64>& loaded_ids,
+                             const PropertyMap& changes)
+    {
+        try
+        {
+            gint64 n = repository->bulk_update_finish(result);
+            g_debug("Updated %" G_GINT64_FORMAT " recordings", n);
+            tree_model->apply_changes(loaded_ids, changes);
+        }
+        catch (const Glib::Error& error)
+        {
+            g_warning("failed to update recordings: %s", error.what().c_str());
+        }
+    }
+
+    void on_edit_clicked()
+    {
+        std::vector<Gtk::TreeModel::Path> rows = tree_view.get_selection()->get_selected_rows();
+        if (rows.empty() || !tree_model->has_pager())
+            return;
+
+        BulkEditDialog dialog(*dynamic_cast<Gtk::Window*>(layout.get_toplevel()),
+                              repository,
+                              rows.size());
+        if (dialog.run() != Gtk::RESPONSE_APPLY)
+            return;
+
+        PropertyMap changes = dialog.get_changes();
+        if (changes.empty())
+            return;
+
+        tree_model->create_filter_for_rows_async(rows,
+                                                 sigc::bind(sigc::mem_fun(this, &Priv::on_rows_filter_created),
+                                                            changes));
+    }
+
+    void on_rows_filter_created(const Glib::RefPtr<Gio::AsyncResult>& result,
+                                const PropertyMap& changes)
+    {
+        std::vector<gint64> loaded_ids;
+        WTF::GRefPtr<GomFilter> filter;
+        try
+        {
+            filter = adoptGRef(tree_model->create_filter_for_rows_finish(result, loaded_ids));
+        }
+        catch (const Glib::Error& error)
+        {
+            g_warning("failed to look up the selected recordings: %s", error.what().c_str());
+            return;
+        }
+        repository->bulk_update_async(SC_TYPE_RECORDING_RESOURCE,
+                                      filter.get(),
+                                      changes,
+                                      sigc::bind(sigc::mem_fun(this, &Priv::on_bulk_update_done),
+                                                 loaded_ids,
+                                                 changes));
+    }
+
+    void on_analyze_clicked()
+    {
+        if (analysis_job) {
+            analysis_job->cancel();
+            analyze_button.set_sensitive(false);
+            return;
+        }
+        run_analyses(analyses);
+    }
+
+    void run_analyses(const AnalysisVector& selection)
+    {
+        running_analyses = selection;
+        current_analysis = 0;
+        start_analysis();
+    }
+
+    // the analyses run one after another, each of them uses all processors
+    void start_analysis()
+    {
+        if (current_analysis >= running_analyses.size() && import_analyses_pending) {
+            import_analyses_pending = false;
+            running_analyses = import_analyses();
+            current_analysis = 0;
+            // even if the previous run was cancelled
+            analyze_button.set_sensitive(true);
+        }
+        if (current_analysis >= running_analyses.size()) {
+            analysis_job.reset();
+            analyze_button.set_label("Analyze Collection");
+            analyze_button.set_sensitive(true);
+            return;
+        }
+        analysis_job.reset(new AnalysisJob(repository, running_analyses[current_analysis]));
+        analysis_job->signal_progress().connect(
+            sigc::mem_fun(this, &Priv::on_analysis_progress));
+        analysis_job->signal_finished().connect(
+            sigc::mem_fun(this, &Priv::on_analysis_finished));
+        analyze_button.set_label("Cancel Analysis");
+        analysis_job->start();
+    }
+
+    void on_analysis_progress(guint done, guint total)
+    {
+        analyze_button.set_label(Glib::ustring::compose("Cancel Analysis (%1/%2)", done, total));
+    }
+
+    void on_analysis_finished()
+    {
+        // don't destroy the job from within its own signal handler
+        Glib::signal_idle().connect_once(sigc::mem_fun(this, &Priv::on_analysis_idle));
+    }
+
+    void on_analysis_idle()
+    {
+        // the loaded rows don't have the levels that were just stored
+        if (running_analyses[current_analysis]->resource_type() == SC_TYPE_RECORDING_RESOURCE)
+            refresh_view();
+        current_analysis++;
+        if (!analyze_button.get_sensitive())
+            current_analysis = running_analyses.size();
+        start_analysis();
+    }
+
+    void on_similar_clicked()
+    {
+        if (showing_similar) {
+            refresh_view();
+            return;
+        }
+
+        std::vector<Gtk::TreeModel::Path> rows = tree_view.get_selection()->get_selected_rows();
+        gint64 id = rows.size() == 1 ? tree_model->peek_id(rows[0]) : 0;
+        if (!id)
+            return;
+        repository->find_similar_async(id,
+                                       SIMILAR_COUNT,
+                                       sigc::bind(sigc::mem_fun(this, &Priv::on_find_similar_done), id));
+    }
+
+    void on_find_similar_done(const Glib::RefPtr<Gio::AsyncResult>& result, gint64 id)
+    {
+        std::vector<gint64> ids;
+        try
+        {
+            ids = repository->find_similar_finish(result);
+        }
+        catch (const Glib::Error& error)
+        {
+            g_warning("failed to find similar recordings: %s", error.what().c_str());
+            return;
+        }
+        if (ids.empty()) {
+            g_debug("no similar recordings for %" G_GINT64_FORMAT ", is the collection analyzed?", id);
+            return;
+        }
+
+        // the recording itself first, then the others from most to least
+        // similar
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+        ids.insert(ids.begin(), id);
+        showing_similar = true;
+        similar_button.set_label("Show All");
+        similar_button.set_sensitive(true);
+        load_recordings(RecordingTreeModel::create_pager(repository->cobj(), ids));
     }
 
     void refresh_view()
     {
-        gom_repository_find_async(repository->cobj(),
-                                  SC_TYPE_RECORDING_RESOURCE,
-                                  0 /*m_priv->filter.get()*/,
-                                  Priv::got_recordings_proxy,
-                                  this);
+        if (showing_similar) {
+            showing_similar = false;
+            similar_button.set_label("Find Similar");
+            similar_button.set_sensitive(tree_view.get_selection()->count_selected_rows() == 1);
+        }
+        startup_trace_begin("recordings-query");
+        load_recordings(RecordingTreeModel::create_pager(repository->cobj()));
     }
 
-    static void got_recordings_proxy(GObject* source,
-                                     GAsyncResult* result,
-                                     gpointer user_data)
+    void load_recordings(const std::tr1::shared_ptr<KeysetPager>& recordings)
     {
-        GomRepository* repository = reinterpret_cast<GomRepository*>(source);
-        Priv* self = reinterpret_cast<Priv*>(user_data);
-        self->got_recordings(repository, result);
+        // a newer query replaces one that is still running
+        pager = recordings;
+        pager->build_async(sigc::bind(sigc::mem_fun(this, &Priv::got_recordings), pager));
     }
 
-    void got_recordings(GomRepository* repository, GAsyncResult* result)
+    void got_recordings(const Glib::RefPtr<Gio::AsyncResult>& result,
+                        std::tr1::shared_ptr<KeysetPager> built)
     {
         g_debug("%s", G_STRFUNC);
-        GError* error = 0;
-        WTF::GRefPtr<GomResourceGroup> results = adoptGRef(gom_repository_find_finish(repository, result, &error));
-        if (error) {
-            g_warning("Unable to find resources: %s", error->message);
-            g_clear_error(&error);
+        startup_trace_end("recordings-query");
+        try
+        {
+            built->build_finish(result);
+        }
+        catch (const Glib::Error& error)
+        {
+            g_warning("Unable to find resources: %s", error.what().c_str());
             return;
         }
+        if (built != pager)
+            return;
 
-        // FIXME: figure out why we need to unset the model before setting it
+        // the pager doesn't announce its rows one by one; the view reads the
+        // row count when the model is set
         tree_view.set_model(Glib::RefPtr<RecordingTreeModel>());
-        g_debug("total results: %i", gom_resource_group_get_count(results.get()));
-        tree_model->set_resource_group(results.get());
+        g_debug("total results: %u", pager->count());
+        tree_model->set_pager(pager);
         tree_view.set_model(tree_model);
+        on_selection_changed();
+
+        trace_first_paint();
+        if (!rows_shown && !rows_shown_connection.connected())
+            rows_shown_connection = tree_view.signal_draw().connect(
+                sigc::mem_fun(this, &Priv::on_draw_rows), true);
+    }
+
+    // the snapshot doesn't count, only rows that came from the database
+    bool on_draw_rows(const Cairo::RefPtr<Cairo::Context>& cr)
+    {
+        if (pager->count() && !pager->peek_row(0))
+            return false;
+        rows_shown_connection.disconnect();
+        rows_shown = true;
+        signal_rows_shown.emit();
+        return false;
+    }
+
+    void trace_first_paint()
+    {
+        if (!startup_trace_is_complete() && !first_draw_connection.connected()) {
+            startup_trace_begin("first-paint");
+            first_draw_connection = tree_view.signal_draw().connect(
+                sigc::mem_fun(this, &Priv::on_first_draw), true);
+        }
+    }
+
+    std::string snapshot_path() const
+    {
+        return Glib::build_filename(Glib::path_get_dirname(repository->audio_dir()->get_path()),
+                                    "recording-list-snapshot");
+    }
+
+    void save_snapshot()
+    {
+        // only the unfiltered list is painted at startup
+        if (showing_similar)
+            return;
+        GError* error = 0;
+        if (!tree_model->save_snapshot(snapshot_path(), SNAPSHOT_ROWS, &error)) {
+            g_warning("Unable to save the recording list: %s", error->message);
+            g_clear_error(&error);
+        }
+    }
+
+    bool on_first_draw(const Cairo::RefPtr<Cairo::Context>& cr)
+    {
+        first_draw_connection.disconnect();
+        startup_trace_end("first-paint");
+        startup_trace_complete();
+        return false;
     }
 
     void on_row_activated(const Gtk::TreeModel::Path& path,
                           Gtk::TreeViewColumn* column)
     {
-        Gtk::TreeModel::iterator iter = tree_model->get_iter(path);
-        ScRecordingResource* resource = (*iter)[tree_model->columns().resource];
-        std::tr1::shared_ptr<Recording> recording = Recording::create(resource);
-        RecordingWindow::display(recording, repository);
+        // the list only holds the columns it displays
+        gint64 id = tree_model->peek_id(path);
+        if (id)
+            repository->get_recording_async(id, sigc::mem_fun(this, &Priv::on_recording_loaded));
+    }
+
+    void on_recording_loaded(const Glib::RefPtr<Gio::AsyncResult>& result)
+    {
+        try
+        {
+            std::tr1::shared_ptr<Recording> recording = repository->get_recording_finish(result);
+            tree_model->track_changes(recording->resource());
+            RecordingWindow::display(recording, repository);
+        }
+        catch (const Glib::Error& error)
+        {
+            g_warning("failed to load recording: %s", error.what().c_str());
+        }
     }
 
     void on_import_file_done(const Glib::RefPtr<Gio::AsyncResult>& result)
@@ -110,6 +508,13 @@ struct RecordingList::Priv {
         try
         {
             repository->import_file_finish(result);
+            // new recordings are analyzed right away so that they can be
+            // found by similarity search, and archived if that is enabled;
+            // the other analyses are only run when asked for
+            if (analysis_job)
+                import_analyses_pending = true;
+            else
+                run_analyses(import_analyses());
         }
         catch (const Glib::Error& error)
         {
@@ -134,6 +539,11 @@ struct RecordingList::Priv {
         chooser->hide();
         delete chooser;
     }
+
+    ~Priv()
+    {
+        closing_connection.disconnect();
+    }
 };
 
 RecordingList::RecordingList(const std::tr1::shared_ptr<Repository>& repository)
@@ -142,4 +552,9 @@ RecordingList::RecordingList(const std::tr1::shared_ptr<Repository>& repository)
 {
     pack_start(m_priv->layout);
 }
+
+sigc::signal<void>& RecordingList::signal_rows_shown()
+{
+    return m_priv->signal_rows_shown;
+}
 }
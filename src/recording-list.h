@@ -33,6 +33,9 @@ class RecordingList : public Gtk::Box {
 public:
     RecordingList(const std::tr1::shared_ptr<Repository>& repository);
 
+    // emitted once, when the first rows from the database have been drawn
+    sigc::signal<void>& signal_rows_shown();
+
 private:
     struct Priv;
     std::tr1::shared_ptr<Priv> m_priv;
@@ -19,6 +19,7 @@
  */
 
 #include "recording-resource.h"
+#include "resource-dirty.h"
 
 #define SC_RECORDING_RESOURCE_GET_PRIVATE(object) \
     (G_TYPE_INSTANCE_GET_PRIVATE(                 \
@@ -34,6 +35,13 @@ struct _ScRecordingResourcePrivate {
     gfloat elevation;
     char* file;
     char* remarks;
+    gint64 parent_id;
+    gfloat peak;
+    gfloat rms;
+    gfloat loudness;
+    gint64 clipped_samples;
+    gfloat dc_offset;
+    gfloat noise_floor;
 };
 
 enum {
@@ -46,7 +54,14 @@ enum {
     PROP_LOCATION_ID,
     PROP_ELEVATION,
     PROP_FILE,
-    PROP_REMARKS
+    PROP_REMARKS,
+    PROP_PARENT_ID,
+    PROP_PEAK,
+    PROP_RMS,
+    PROP_LOUDNESS,
+    PROP_CLIPPED_SAMPLES,
+    PROP_DC_OFFSET,
+    PROP_NOISE_FLOOR
 };
 
 G_DEFINE_TYPE(ScRecordingResource, sc_recording_resource, GOM_TYPE_RESOURCE)
@@ -70,6 +85,8 @@ static void sc_recording_resource_set_property(GObject* obj,
 {
     ScRecordingResource* self = SC_RECORDING_RESOURCE(obj);
 
+    sc_resource_track_change(obj, pspec, value);
+
     switch (property_id) {
     case PROP_ID:
         self->priv->id = g_value_get_int64(value);
@@ -101,6 +118,27 @@ static void sc_recording_resource_set_property(GObject* obj,
         g_free(self->priv->remarks);
         self->priv->remarks = g_value_dup_string(value);
         break;
+    case PROP_PARENT_ID:
+        self->priv->parent_id = g_value_get_int64(value);
+        break;
+    case PROP_PEAK:
+        self->priv->peak = g_value_get_float(value);
+        break;
+    case PROP_RMS:
+        self->priv->rms = g_value_get_float(value);
+        break;
+    case PROP_LOUDNESS:
+        self->priv->loudness = g_value_get_float(value);
+        break;
+    case PROP_CLIPPED_SAMPLES:
+        self->priv->clipped_samples = g_value_get_int64(value);
+        break;
+    case PROP_DC_OFFSET:
+        self->priv->dc_offset = g_value_get_float(value);
+        break;
+    case PROP_NOISE_FLOOR:
+        self->priv->noise_floor = g_value_get_float(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, property_id, pspec);
     }
@@ -141,11 +179,45 @@ static void sc_recording_resource_get_property(GObject* obj,
     case PROP_REMARKS:
         g_value_set_string(value, self->priv->remarks);
         break;
+    case PROP_PARENT_ID:
+        g_value_set_int64(value, self->priv->parent_id);
+        break;
+    case PROP_PEAK:
+        g_value_set_float(value, self->priv->peak);
+        break;
+    case PROP_RMS:
+        g_value_set_float(value, self->priv->rms);
+        break;
+    case PROP_LOUDNESS:
+        g_value_set_float(value, self->priv->loudness);
+        break;
+    case PROP_CLIPPED_SAMPLES:
+        g_value_set_int64(value, self->priv->clipped_samples);
+        break;
+    case PROP_DC_OFFSET:
+        g_value_set_float(value, self->priv->dc_offset);
+        break;
+    case PROP_NOISE_FLOOR:
+        g_value_set_float(value, self->priv->noise_floor);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, property_id, pspec);
     }
 }
 
+static void install_level_property(GObjectClass* object_class,
+                                   guint property_id,
+                                   const char* name)
+{
+    g_object_class_install_property(
+        object_class,
+        property_id,
+        g_param_spec_float(
+            name, NULL, NULL, -G_MAXFLOAT, G_MAXFLOAT, -G_MAXFLOAT, G_PARAM_READWRITE));
+    gom_resource_class_set_property_new_in_version(
+        GOM_RESOURCE_CLASS(object_class), name, 4);
+}
+
 static void sc_recording_resource_class_init(ScRecordingResourceClass* klass)
 {
     GObjectClass* object_class = G_OBJECT_CLASS(klass);
@@ -210,6 +282,34 @@ static void sc_recording_resource_class_init(ScRecordingResourceClass* klass)
         PROP_REMARKS,
         g_param_spec_string("remarks", NULL, NULL, NULL, G_PARAM_READWRITE));
 
+    /* the recording this one was extracted from, or 0 */
+    g_object_class_install_property(
+        object_class,
+        PROP_PARENT_ID,
+        g_param_spec_int64("parent-id", NULL, NULL, 0, G_MAXINT64, 0, G_PARAM_READWRITE));
+    gom_resource_class_set_property_new_in_version(resource_class, "parent-id", 2);
+
+    /* levels measured by the loudness analysis: peak, rms and noise-floor in
+     * dBFS, loudness in LUFS (EBU R128 integrated). -G_MAXFLOAT until the
+     * recording has been analyzed. */
+    install_level_property(object_class, PROP_PEAK, "peak");
+    install_level_property(object_class, PROP_RMS, "rms");
+    install_level_property(object_class, PROP_LOUDNESS, "loudness");
+    install_level_property(object_class, PROP_NOISE_FLOOR, "noise-floor");
+
+    g_object_class_install_property(
+        object_class,
+        PROP_CLIPPED_SAMPLES,
+        g_param_spec_int64("clipped-samples", NULL, NULL, -1, G_MAXINT64, -1, G_PARAM_READWRITE));
+    gom_resource_class_set_property_new_in_version(resource_class, "clipped-samples", 4);
+
+    /* mean sample value as a fraction of full scale */
+    g_object_class_install_property(
+        object_class,
+        PROP_DC_OFFSET,
+        g_param_spec_float("dc-offset", NULL, NULL, -1, 1, 0, G_PARAM_READWRITE));
+    gom_resource_class_set_property_new_in_version(resource_class, "dc-offset", 4);
+
     gom_resource_class_set_table(resource_class, "recordings");
     gom_resource_class_set_primary_key(resource_class, "id");
 }
@@ -217,6 +317,11 @@ static void sc_recording_resource_class_init(ScRecordingResourceClass* klass)
 static void sc_recording_resource_init(ScRecordingResource* self)
 {
     self->priv = SC_RECORDING_RESOURCE_GET_PRIVATE(self);
+    self->priv->peak = -G_MAXFLOAT;
+    self->priv->rms = -G_MAXFLOAT;
+    self->priv->loudness = -G_MAXFLOAT;
+    self->priv->noise_floor = -G_MAXFLOAT;
+    self->priv->clipped_samples = -1;
 }
 
 gint64 sc_recording_resource_get_id(const ScRecordingResource* self)
@@ -264,4 +369,27 @@ gfloat sc_recording_resource_get_duration(const ScRecordingResource* self)
     return self->priv->duration;
 }
 
+gint64 sc_recording_resource_get_parent_id(const ScRecordingResource* self)
+{
+    return self->priv->parent_id;
+}
 
+gfloat sc_recording_resource_get_peak(const ScRecordingResource* self)
+{
+    return self->priv->peak;
+}
+
+gfloat sc_recording_resource_get_loudness(const ScRecordingResource* self)
+{
+    return self->priv->loudness;
+}
+
+gint64 sc_recording_resource_get_clipped_samples(const ScRecordingResource* self)
+{
+    return self->priv->clipped_samples;
+}
+
+gfloat sc_recording_resource_get_noise_floor(const ScRecordingResource* self)
+{
+    return self->priv->noise_floor;
+}
@@ -62,12 +62,17 @@ GType sc_recording_resource_get_type(void) G_GNUC_CONST;
 gint64 sc_recording_resource_get_id(const ScRecordingResource* self);
 const char* sc_recording_resource_get_file(const ScRecordingResource* self);
 gint64 sc_recording_resource_get_location_id(const ScRecordingResource* self);
+gint64 sc_recording_resource_get_parent_id(const ScRecordingResource* self);
 gint sc_recording_resource_get_quality(const ScRecordingResource* self);
 GDateTime* sc_recording_resource_get_date(const ScRecordingResource* self);
 const char* sc_recording_resource_get_recordist(const ScRecordingResource* self);
 gfloat sc_recording_resource_get_elevation(const ScRecordingResource* self);
 const char* sc_recording_resource_get_remarks(const ScRecordingResource* self);
 gfloat sc_recording_resource_get_duration(const ScRecordingResource* self);
+gfloat sc_recording_resource_get_peak(const ScRecordingResource* self);
+gfloat sc_recording_resource_get_loudness(const ScRecordingResource* self);
+gint64 sc_recording_resource_get_clipped_samples(const ScRecordingResource* self);
+gfloat sc_recording_resource_get_noise_floor(const ScRecordingResource* self);
 
 G_END_DECLS
 
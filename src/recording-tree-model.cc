@@ -18,66 +18,81 @@
  * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include "GRefPtr.h"
 #include "recording-tree-model.h"
 
 namespace SC {
 
-static const guint PAGE_SIZE = 30;
-
-// NULL-safe ustring creator
-template <typename T>
-static T make_string(const char* cstr)
-{
-    T str;
-    if (cstr)
-        str = cstr;
-    return str;
-}
-
+// the model columns in the order the pager projects them
 enum {
-    COLUMN_RESOURCE,
     COLUMN_ID,
     COLUMN_DURATION,
     COLUMN_QUALITY,
-    COLUMN_RECORDIST,
-    COLUMN_DATE,
-    COLUMN_ELEVATION,
     COLUMN_FILE,
-    COLUMN_REMARKS
+    COLUMN_PEAK,
+    COLUMN_LOUDNESS,
+    COLUMN_CLIPPED_SAMPLES,
+    N_COLUMNS
+};
+
+// the properties behind the columns after COLUMN_ID
+static const char* projected_properties[] = {
+    "duration",
+    "quality",
+    "file",
+    "peak",
+    "loudness",
+    "clipped-samples"
 };
 
 RecordingModelColumns::RecordingModelColumns()
 {
-    add(resource);
     add(id);
     add(duration);
     add(quality);
-    add(recordist);
-    add(date);
-    add(elevation);
     add(file);
-    add(remarks);
+    add(peak);
+    add(loudness);
+    add(clipped_samples);
 }
 
 static const char* loading = "loading...";
 
 struct RecordingTreeModel::Priv {
     RecordingModelColumns columns;
-    WTF::GRefPtr<GomResourceGroup> recordings;
-    WTF::GRefPtr<ScRecordingResource> empty_recording;
+    std::tr1::shared_ptr<KeysetPager> pager;
+    // only used while there's no pager
+    std::tr1::shared_ptr<ListSnapshot> snapshot;
+    sigc::connection rows_loaded_connection;
+    // shown for rows that haven't been fetched yet
+    ProjectedRow empty_row;
     int stamp;
 
     Priv()
-        : empty_recording(adoptGRef(SC_RECORDING_RESOURCE(
-              g_object_new(SC_TYPE_RECORDING_RESOURCE,
-                           "file",
-                           loading,
-                           "recordist",
-                           loading,
-                           NULL))))
+        : empty_row(N_COLUMNS)
         , stamp(1)
     {
+        // the defaults of the recording resource properties
+        GObject* defaults = G_OBJECT(g_object_new(SC_TYPE_RECORDING_RESOURCE, NULL));
+        empty_row[COLUMN_ID].init(G_TYPE_INT64);
+        for (guint i = 0; i < G_N_ELEMENTS(projected_properties); ++i) {
+            GParamSpec* pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(defaults),
+                                                             projected_properties[i]);
+            empty_row[i + 1].init(G_PARAM_SPEC_VALUE_TYPE(pspec));
+            g_object_get_property(defaults, projected_properties[i], empty_row[i + 1].gobj());
+        }
+        g_object_unref(defaults);
+        g_value_set_static_string(empty_row[COLUMN_FILE].gobj(), loading);
+    }
+
+    std::vector<GType> column_types() const
+    {
+        std::vector<GType> types;
+        for (ProjectedRow::const_iterator it = empty_row.begin(); it != empty_row.end(); ++it)
+            types.push_back(G_VALUE_TYPE(it->gobj()));
+        return types;
     }
 };
 
@@ -91,6 +106,29 @@ Glib::RefPtr<RecordingTreeModel> RecordingTreeModel::create()
     return Glib::RefPtr<RecordingTreeModel>(new RecordingTreeModel());
 }
 
+std::tr1::shared_ptr<KeysetPager> RecordingTreeModel::create_pager(GomRepository* repository,
+                                                                   GomFilter* filter)
+{
+    std::vector<std::string> columns(projected_properties,
+                                     projected_properties + G_N_ELEMENTS(projected_properties));
+    return std::tr1::shared_ptr<KeysetPager>(new KeysetPager(repository,
+                                                             SC_TYPE_RECORDING_RESOURCE,
+                                                             filter,
+                                                             std::string(),
+                                                             columns));
+}
+
+std::tr1::shared_ptr<KeysetPager> RecordingTreeModel::create_pager(GomRepository* repository,
+                                                                   const std::vector<gint64>& ids)
+{
+    std::vector<std::string> columns(projected_properties,
+                                     projected_properties + G_N_ELEMENTS(projected_properties));
+    return std::tr1::shared_ptr<KeysetPager>(new KeysetPager(repository,
+                                                             SC_TYPE_RECORDING_RESOURCE,
+                                                             ids,
+                                                             columns));
+}
+
 RecordingTreeModel::RecordingTreeModel()
     : Glib::ObjectBase(typeid(RecordingTreeModel)) /* register custom GType */
     , Glib::Object() /* the GType is actually registered here */
@@ -99,26 +137,170 @@ RecordingTreeModel::RecordingTreeModel()
 {
 }
 
-bool RecordingTreeModel::path_deleted(const Gtk::TreeModel::Path& path)
+void RecordingTreeModel::set_pager(const std::tr1::shared_ptr<KeysetPager>& pager)
 {
-    row_deleted(path);
-    return false;
+    m_priv->rows_loaded_connection.disconnect();
+    m_priv->pager = pager;
+    m_priv->snapshot.reset();
+    if (pager) {
+        m_priv->stamp++;
+        m_priv->rows_loaded_connection = pager->signal_rows_loaded().connect(
+            sigc::mem_fun(this, &RecordingTreeModel::on_rows_loaded));
+    }
 }
 
-void RecordingTreeModel::set_resource_group(GomResourceGroup* recordings)
+bool RecordingTreeModel::load_snapshot(const std::string& path)
 {
-    foreach_path(sigc::mem_fun(this, &RecordingTreeModel::path_deleted));
-    m_priv->recordings = recordings;
-    if (recordings) {
-        m_priv->stamp++;
-        for (int i = 0; i < gom_resource_group_get_count(recordings); ++i) {
-            Gtk::TreeModel::Path path;
-            path.push_back(i);
-            row_inserted(path, make_iterator(i));
-        }
+    std::tr1::shared_ptr<ListSnapshot> snapshot = ListSnapshot::load(path, m_priv->column_types());
+    if (!snapshot)
+        return false;
+
+    m_priv->rows_loaded_connection.disconnect();
+    m_priv->pager.reset();
+    m_priv->snapshot = snapshot;
+    m_priv->stamp++;
+    return true;
+}
+
+bool RecordingTreeModel::has_pager() const
+{
+    return m_priv->pager;
+}
+
+bool RecordingTreeModel::save_snapshot(const std::string& path, guint max_rows, GError** error) const
+{
+    // a snapshot that was loaded is still current
+    if (!m_priv->pager)
+        return true;
+
+    std::vector<const ProjectedRow*> rows;
+    // pages that were evicted aren't read again just for the snapshot
+    for (guint i = 0; i < std::min(max_rows, m_priv->pager->count()); ++i) {
+        const ProjectedRow* row = m_priv->pager->peek_row(i);
+        if (!row)
+            break;
+        rows.push_back(row);
+    }
+    return ListSnapshot::save(path, m_priv->column_types(), m_priv->pager->count(), rows, error);
+}
+
+void RecordingTreeModel::on_rows_loaded(guint first, guint count)
+{
+    for (guint i = first; i < first + count; ++i) {
+        Gtk::TreeModel::Path path;
+        path.push_back(i);
+        row_changed(path, make_iterator(i));
     }
 }
 
+const ProjectedRow* RecordingTreeModel::peek_row(const Gtk::TreeModel::Path& path) const
+{
+    if (path.size() != 1 || path[0] < 0)
+        return 0;
+    if (m_priv->pager)
+        return m_priv->pager->peek_row(path[0]);
+    if (m_priv->snapshot && static_cast<guint>(path[0]) < m_priv->snapshot->n_rows())
+        return &m_priv->snapshot->row(path[0]);
+    return 0;
+}
+
+gint64 RecordingTreeModel::peek_id(const Gtk::TreeModel::Path& path) const
+{
+    const ProjectedRow* row = peek_row(path);
+    return row ? g_value_get_int64((*row)[COLUMN_ID].gobj()) : 0;
+}
+
+std::string RecordingTreeModel::peek_file(const Gtk::TreeModel::Path& path) const
+{
+    const ProjectedRow* row = peek_row(path);
+    const char* file = row ? g_value_get_string((*row)[COLUMN_FILE].gobj()) : 0;
+    return file ? file : std::string();
+}
+
+void RecordingTreeModel::create_filter_for_rows_async(const std::vector<Gtk::TreeModel::Path>& rows,
+                                                     const Gio::SlotAsyncReady& slot) const
+{
+    std::vector<guint> indices;
+    for (std::vector<Gtk::TreeModel::Path>::const_iterator it = rows.begin(); it != rows.end(); ++it) {
+        if (it->size() == 1)
+            indices.push_back((*it)[0]);
+    }
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+    if (!m_priv->pager) {
+        // nothing to match; finish() returns an empty filter for a null result
+        Glib::signal_idle().connect_once(sigc::bind(slot, Glib::RefPtr<Gio::AsyncResult>()));
+        return;
+    }
+    m_priv->pager->create_filter_for_rows_async(indices, slot);
+}
+
+GomFilter* RecordingTreeModel::create_filter_for_rows_finish(const Glib::RefPtr<Gio::AsyncResult>& result,
+                                                            std::vector<gint64>& loaded_ids) const
+{
+    if (!result || !m_priv->pager)
+        return gom_filter_new_sql("0", NULL);
+    return m_priv->pager->create_filter_for_rows_finish(result, loaded_ids);
+}
+
+void RecordingTreeModel::apply_changes(const std::vector<gint64>& ids,
+                                       const PropertyMap& changes)
+{
+    if (!m_priv->pager)
+        return;
+
+    // only look at rows that have been loaded; the others will be read with
+    // the new values when they are fetched
+    std::set<gint64> id_set(ids.begin(), ids.end());
+    m_priv->pager->foreach_loaded_row(sigc::bind(sigc::mem_fun(this, &RecordingTreeModel::apply_changes_to_row),
+                                                 sigc::ref(id_set),
+                                                 sigc::ref(changes)));
+}
+
+void RecordingTreeModel::apply_changes_to_row(guint index,
+                                              ProjectedRow& row,
+                                              const std::set<gint64>& ids,
+                                              const PropertyMap& changes)
+{
+    if (!ids.count(g_value_get_int64(row[COLUMN_ID].gobj())))
+        return;
+
+    bool changed = false;
+    for (PropertyMap::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+        // changes to columns that aren't displayed don't matter here
+        int column = m_priv->pager->column_index(it->first);
+        if (column > 0 && g_value_transform(it->second.gobj(), row[column].gobj()))
+            changed = true;
+    }
+    if (!changed)
+        return;
+
+    Gtk::TreeModel::Path path;
+    path.push_back(index);
+    row_changed(path, make_iterator(index));
+}
+
+static void recording_notify(GObject* resource, GParamSpec* pspec, gpointer user_data)
+{
+    RecordingTreeModel* self = dynamic_cast<RecordingTreeModel*>(
+        Glib::ObjectBase::_get_current_wrapper(G_OBJECT(user_data)));
+    if (!self)
+        return;
+
+    PropertyMap changes;
+    changes[pspec->name].init(G_PARAM_SPEC_VALUE_TYPE(pspec));
+    g_object_get_property(resource, pspec->name, changes[pspec->name].gobj());
+    self->apply_changes(std::vector<gint64>(1, sc_recording_resource_get_id(SC_RECORDING_RESOURCE(resource))),
+                        changes);
+}
+
+void RecordingTreeModel::track_changes(ScRecordingResource* recording)
+{
+    // disconnected automatically when either object goes away
+    g_signal_connect_object(recording, "notify", G_CALLBACK(recording_notify), gobj(), GConnectFlags(0));
+}
+
 Gtk::TreeModelFlags RecordingTreeModel::get_flags_vfunc(void) const
 {
     return Gtk::TreeModelFlags(Gtk::TREE_MODEL_LIST_ONLY);
@@ -146,76 +328,61 @@ static void iter_set_index(Gtk::TreeModel::iterator& iter, guint index)
     iter.gobj()->user_data = GINT_TO_POINTER(index);
 }
 
-#define SETUP_VALUE(T, ValBase, Val)                 \
-    G_STMT_START                                     \
-    {                                                \
-        T::ValueType _local_val;                     \
-        _local_val.init(T::ValueType::value_type()); \
-        _local_val.set(Val);                         \
-        ValBase.init(T::ValueType::value_type());    \
-        ValBase = _local_val;                        \
-    }                                                \
-    G_STMT_END
-
 void RecordingTreeModel::get_value_vfunc(const iterator& iter,
                                          int column,
                                          Glib::ValueBase& value) const
 {
     if (!iter)
         return;
-    guint index = iter_get_index(iter);
-    ScRecordingResource* recording = get_recording(index);
-    switch (column) {
-    case COLUMN_RESOURCE:
-        SETUP_VALUE(Gtk::TreeModelColumn<ScRecordingResource*>,
-                    value,
-                    recording);
-        break;
-    case COLUMN_ID:
-        SETUP_VALUE(Gtk::TreeModelColumn<guint64>,
-                    value,
-                    sc_recording_resource_get_id(recording));
-        break;
-    case COLUMN_DURATION:
-        SETUP_VALUE(Gtk::TreeModelColumn<float>,
-                    value,
-                    sc_recording_resource_get_duration(recording));
-        break;
-    case COLUMN_QUALITY:
-        SETUP_VALUE(Gtk::TreeModelColumn<int>,
-                    value,
-                    sc_recording_resource_get_quality(recording));
-        break;
-    case COLUMN_RECORDIST:
-        SETUP_VALUE(Gtk::TreeModelColumn<Glib::ustring>,
-                    value,
-                    make_string<Glib::ustring>(sc_recording_resource_get_recordist(recording)));
-        break;
-    case COLUMN_DATE: {
-        GDateTime* gdate = 0;
-        g_object_get(recording, "date", &gdate, NULL);
-        Glib::DateTime date = Glib::wrap(gdate);
-        SETUP_VALUE(Gtk::TreeModelColumn<Glib::DateTime>, value, date);
-        break;
-    } break;
-    case COLUMN_ELEVATION:
-        SETUP_VALUE(Gtk::TreeModelColumn<float>,
-                    value,
-                    sc_recording_resource_get_elevation(recording));
-        break;
-    case COLUMN_FILE:
-        SETUP_VALUE(Gtk::TreeModelColumn<std::string>,
-                    value,
-                    make_string<std::string>(sc_recording_resource_get_file(recording)));
-        break;
-    case COLUMN_REMARKS:
-        SETUP_VALUE(Gtk::TreeModelColumn<std::string>,
-                    value,
-                    make_string<std::string>(sc_recording_resource_get_remarks(recording)));
-        break;
-    default:
+    if (column < 0 || column >= N_COLUMNS) {
         g_warning("Invalid column %i", column);
+        return;
     }
+    const GValue* cell = get_row(iter_get_index(iter))[column].gobj();
+    value.init(G_VALUE_TYPE(cell));
+    // strings are duplicated: callers may keep the value after the page of
+    // the row was evicted. get_cell() reads without copying.
+    g_value_copy(cell, value.gobj());
+}
+
+const GValue* RecordingTreeModel::get_cell(const Gtk::TreeModel::const_iterator& iter, int column) const
+{
+    return get_row(GPOINTER_TO_INT(iter.gobj()->user_data))[column].gobj();
+}
+
+gint64 RecordingTreeModel::get_id(const Gtk::TreeModel::const_iterator& iter) const
+{
+    return g_value_get_int64(get_cell(iter, COLUMN_ID));
+}
+
+const char* RecordingTreeModel::get_file(const Gtk::TreeModel::const_iterator& iter) const
+{
+    return g_value_get_string(get_cell(iter, COLUMN_FILE));
+}
+
+float RecordingTreeModel::get_duration(const Gtk::TreeModel::const_iterator& iter) const
+{
+    return g_value_get_float(get_cell(iter, COLUMN_DURATION));
+}
+
+int RecordingTreeModel::get_quality(const Gtk::TreeModel::const_iterator& iter) const
+{
+    return g_value_get_int(get_cell(iter, COLUMN_QUALITY));
+}
+
+float RecordingTreeModel::get_peak(const Gtk::TreeModel::const_iterator& iter) const
+{
+    return g_value_get_float(get_cell(iter, COLUMN_PEAK));
+}
+
+float RecordingTreeModel::get_loudness(const Gtk::TreeModel::const_iterator& iter) const
+{
+    return g_value_get_float(get_cell(iter, COLUMN_LOUDNESS));
+}
+
+gint64 RecordingTreeModel::get_clipped_samples(const Gtk::TreeModel::const_iterator& iter) const
+{
+    return g_value_get_int64(get_cell(iter, COLUMN_CLIPPED_SAMPLES));
 }
 
 bool RecordingTreeModel::iter_next_vfunc(const iterator& iter,
@@ -245,10 +412,7 @@ int RecordingTreeModel::iter_n_children_vfunc(const iterator& iter) const
 
 int RecordingTreeModel::iter_n_root_children_vfunc(void) const
 {
-    if (!m_priv->recordings)
-        return 0;
-
-    return gom_resource_group_get_count(m_priv->recordings.get());
+    return count();
 }
 
 bool RecordingTreeModel::iter_nth_child_vfunc(const iterator& parent,
@@ -300,84 +464,39 @@ bool RecordingTreeModel::iter_is_valid(const iterator& iter) const
     return (iter.get_stamp() == m_priv->stamp);
 }
 
-ScRecordingResource* RecordingTreeModel::get_recording(guint index) const
+const ProjectedRow& RecordingTreeModel::get_row(guint index) const
 {
-    if (!m_priv->recordings)
-        return 0;
-    ScRecordingResource* recording = SC_RECORDING_RESOURCE(
-        gom_resource_group_get_index(m_priv->recordings.get(), index));
+    if (!m_priv->pager) {
+        // the rows after the snapshot's can't be fetched before there's a pager
+        if (m_priv->snapshot && index < m_priv->snapshot->n_rows())
+            return m_priv->snapshot->row(index);
+        return m_priv->empty_row;
+    }
 
-    if (recording) {
-        return recording;
+    const ProjectedRow* row = m_priv->pager->peek_row(index);
+    if (row) {
+        return *row;
     }
-    //g_debug("recording %u not fetched, fetching...", index);
-    fetch_recording(index);
-    return m_priv->empty_recording.get();
+    m_priv->pager->fetch(index);
+    return m_priv->empty_row;
+}
+
+guint RecordingTreeModel::count() const
+{
+    if (m_priv->pager)
+        return m_priv->pager->count();
+    if (m_priv->snapshot)
+        return m_priv->snapshot->count();
+    return 0;
 }
 
 Gtk::TreeModel::iterator RecordingTreeModel::make_iterator(guint index) const
 {
     iterator iter;
-    if (m_priv->recordings
-        && index < gom_resource_group_get_count(m_priv->recordings.get())) {
+    if (index < count()) {
         iter.set_stamp(m_priv->stamp);
         iter_set_index(iter, index);
     }
     return iter;
 }
-
-struct FetchRecordingData {
-    RecordingTreeModel* self;
-    guint index;
-    guint count;
-
-    FetchRecordingData(RecordingTreeModel* self, guint index, guint count)
-        : self(self)
-        , index(index)
-        , count(count)
-    {
-    }
-};
-
-void RecordingTreeModel::recording_fetch_done_proxy(GObject* source,
-                                                    GAsyncResult* result,
-                                                    gpointer user_data)
-{
-    FetchRecordingData* data = reinterpret_cast<FetchRecordingData*>(user_data);
-    GomResourceGroup* recordings = reinterpret_cast<GomResourceGroup*>(source);
-    data->self->recording_fetch_done(recordings,
-                                     result,
-                                     data->index,
-                                     data->count);
-    delete data;
-}
-
-void RecordingTreeModel::recording_fetch_done(GomResourceGroup* recordings,
-                                              GAsyncResult* result,
-                                              guint index,
-                                              guint count)
-{
-    GError* error = 0;
-    if (!gom_resource_group_fetch_finish(recordings, result, &error)) {
-        g_warning("Failed to fetch recording %i: %s", index, error->message);
-        g_clear_error(&error);
-        return;
-    }
-
-    //g_debug("Recording %i fetched. signaling changed...", index);
-    Gtk::TreeModel::Path path;
-    path.push_back(index);
-    row_changed(path, make_iterator(index));
-}
-
-void RecordingTreeModel::fetch_recording(guint index) const
-{
-    gom_resource_group_fetch_async(GOM_RESOURCE_GROUP(m_priv->recordings.get()),
-                                   index,
-                                   1,
-                                   RecordingTreeModel::recording_fetch_done_proxy,
-                                   new FetchRecordingData(const_cast<SC::RecordingTreeModel*>(this),
-                                                          index,
-                                                          1));
-}
 }
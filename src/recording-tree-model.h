@@ -24,20 +24,26 @@
 #include <gom/gom.h>
 #include <gtkmm.h>
 #include <tr1/memory>
+#include <set>
+#include <vector>
+#include "keyset-pager.h"
+#include "list-snapshot.h"
 #include "recording-resource.h"
+#include "repository.h"
 
 namespace SC {
 
+// Only the columns that the list displays; the rows are read-only
+// projections of the recordings table, use Repository::get_recording_async()
+// to load the full resource of a row
 struct RecordingModelColumns : public Gtk::TreeModel::ColumnRecord {
-    Gtk::TreeModelColumn<ScRecordingResource*> resource;
     Gtk::TreeModelColumn<gint64> id;
     Gtk::TreeModelColumn<float> duration;
     Gtk::TreeModelColumn<int> quality;
-    Gtk::TreeModelColumn<Glib::ustring> recordist;
-    Gtk::TreeModelColumn<Glib::DateTime> date;
-    Gtk::TreeModelColumn<float> elevation;
     Gtk::TreeModelColumn<std::string> file;
-    Gtk::TreeModelColumn<Glib::ustring> remarks;
+    Gtk::TreeModelColumn<float> peak;
+    Gtk::TreeModelColumn<float> loudness;
+    Gtk::TreeModelColumn<gint64> clipped_samples;
 
     RecordingModelColumns();
 };
@@ -46,8 +52,56 @@ class RecordingTreeModel : public Gtk::TreeModel,
                            public Glib::Object {
 public:
     static Glib::RefPtr<RecordingTreeModel> create();
-    void set_resource_group(GomResourceGroup* recordings);
+    // Creates a pager that reads the columns of the model
+    static std::tr1::shared_ptr<KeysetPager> create_pager(GomRepository* repository,
+                                                          GomFilter* filter = 0);
+    // ... for the recordings with the given ids, in that order
+    static std::tr1::shared_ptr<KeysetPager> create_pager(GomRepository* repository,
+                                                          const std::vector<gint64>& ids);
+    // @pager must have been created by create_pager() and already be built.
+    // No rows are announced, so the model has to be detached from its views
+    // while the pager is replaced; they read the row count when the model is
+    // set again.
+    void set_pager(const std::tr1::shared_ptr<KeysetPager>& pager);
+    // Shows the rows of a snapshot saved by save_snapshot() until a pager is
+    // set, e.g. while the database is still being opened. Like set_pager(),
+    // this doesn't announce any rows. Returns false if there's no usable
+    // snapshot at @path.
+    bool load_snapshot(const std::string& path);
+    // false while only a snapshot is shown
+    bool has_pager() const;
+    // Saves the total row count and the first @max_rows rows, as far as they
+    // are loaded. Does nothing while there's no pager.
+    bool save_snapshot(const std::string& path, guint max_rows, GError** error) const;
     const RecordingModelColumns& columns() const;
+    // Return the id (0 if unknown) and file of the recording at @path if it
+    // has been loaded, without fetching it
+    gint64 peek_id(const Gtk::TreeModel::Path& path) const;
+    std::string peek_file(const Gtk::TreeModel::Path& path) const;
+    // Allocation-free access to the values of a row for cell data functions,
+    // which would otherwise copy every value into a GValue. The file name is
+    // borrowed from the model and stays valid until the main loop runs again.
+    gint64 get_id(const Gtk::TreeModel::const_iterator& iter) const;
+    const char* get_file(const Gtk::TreeModel::const_iterator& iter) const;
+    float get_duration(const Gtk::TreeModel::const_iterator& iter) const;
+    int get_quality(const Gtk::TreeModel::const_iterator& iter) const;
+    float get_peak(const Gtk::TreeModel::const_iterator& iter) const;
+    float get_loudness(const Gtk::TreeModel::const_iterator& iter) const;
+    gint64 get_clipped_samples(const Gtk::TreeModel::const_iterator& iter) const;
+    // Creates a filter matching the recordings at the given rows without
+    // loading them. The ids of the rows that are already loaded are returned
+    // in @loaded_ids.
+    void create_filter_for_rows_async(const std::vector<Gtk::TreeModel::Path>& rows,
+                                      const Gio::SlotAsyncReady& slot) const;
+    GomFilter* create_filter_for_rows_finish(const Glib::RefPtr<Gio::AsyncResult>& result,
+                                             std::vector<gint64>& loaded_ids) const;
+    // Applies changes that were already written to the database (e.g. by
+    // Repository::bulk_update_async()) to the rows that are loaded, without
+    // re-reading them
+    void apply_changes(const std::vector<gint64>& ids, const PropertyMap& changes);
+    // Keeps the row of @recording up to date with the edits made to the
+    // resource, e.g. in a RecordingWindow
+    void track_changes(ScRecordingResource* recording);
 
 private:
     RecordingTreeModel();
@@ -69,19 +123,17 @@ private:
     virtual bool get_iter_vfunc(const Path& path, iterator& iter) const;
     virtual bool iter_is_valid(const iterator& iter) const;
 
-    ScRecordingResource* get_recording(guint index) const;
-    void fetch_recording(guint index) const;
+    const ProjectedRow* peek_row(const Gtk::TreeModel::Path& path) const;
+    const ProjectedRow& get_row(guint index) const;
+    const GValue* get_cell(const Gtk::TreeModel::const_iterator& iter, int column) const;
+    guint count() const;
     void invalidate_all();
     iterator make_iterator(guint index) const;
-    bool path_deleted(const Gtk::TreeModel::Path& path);
-
-    static void recording_fetch_done_proxy(GObject* source,
-                                           GAsyncResult* result,
-                                           gpointer user_data);
-    void recording_fetch_done(GomResourceGroup* recordings,
-                              GAsyncResult* result,
-                              guint index,
-                              guint count);
+    void on_rows_loaded(guint first, guint count);
+    void apply_changes_to_row(guint index,
+                              ProjectedRow& row,
+                              const std::set<gint64>& ids,
+                              const PropertyMap& changes);
 
     struct Priv;
     std::tr1::shared_ptr<Priv> m_priv;
@@ -18,49 +18,79 @@
  * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "quality-cell-renderer.h"
 #include "recording-tree-view.h"
 #include "util.h"
 
 namespace SC {
 
-static void duration_data_func(Gtk::CellRenderer* renderer, const Gtk::TreeModel::const_iterator& iter, const Glib::RefPtr<RecordingTreeModel>& model)
+// The data functions read the rows through the model's accessors and set the
+// renderer properties on the C objects, so that drawing a cell doesn't copy
+// its value through GValues and temporary strings more than once.
+
+static void id_data_func(Gtk::CellRenderer* renderer, const Gtk::TreeModel::const_iterator& iter, const Glib::RefPtr<RecordingTreeModel>& model)
+{
+    gchar text[32];
+    g_snprintf(text, sizeof(text), "%" G_GINT64_FORMAT, model->get_id(iter));
+    g_object_set(renderer->gobj(), "text", text, NULL);
+}
+
+static void file_data_func(Gtk::CellRenderer* renderer, const Gtk::TreeModel::const_iterator& iter, const Glib::RefPtr<RecordingTreeModel>& model)
+{
+    g_object_set(renderer->gobj(), "text", model->get_file(iter), NULL);
+}
+
+static void duration_data_func(Gtk::CellRenderer* renderer, const Gtk::TreeModel::const_iterator& iter, const Glib::RefPtr<RecordingTreeModel>& model, char* buffer)
 {
-    float duration = iter->get_value(model->columns().duration);
-    Gtk::CellRendererText* crt = dynamic_cast<Gtk::CellRendererText*>(renderer);
+    g_object_set(renderer->gobj(), "text", format_duration(model->get_duration(iter), buffer, DURATION_BUFFER_SIZE), NULL);
+}
 
-    crt->property_text() = format_duration(duration);
+static void quality_data_func(Gtk::CellRenderer* renderer, const Gtk::TreeModel::const_iterator& iter, const Glib::RefPtr<RecordingTreeModel>& model)
+{
+    g_object_set(renderer->gobj(), "quality", model->get_quality(iter), NULL);
 }
 
-static void quality_data_func(Gtk::CellRenderer* renderer, const Gtk::TreeModel::const_iterator& iter, const Glib::RefPtr<RecordingTreeModel>& model, int q)
+static void level_data_func(Gtk::CellRenderer* renderer, const Gtk::TreeModel::const_iterator& iter, const Glib::RefPtr<RecordingTreeModel>& model)
 {
-    float quality = iter->get_value(model->columns().quality);
-    Gtk::CellRendererPixbuf* crp = dynamic_cast<Gtk::CellRendererPixbuf*>(renderer);
+    float loudness = model->get_loudness(iter);
+    float peak = model->get_peak(iter);
+    gint64 clipped = model->get_clipped_samples(iter);
 
-    if (!quality)
-        crp->property_icon_name() = "";
-    else
-        crp->property_icon_name() = quality >= q ? "starred" : "non-starred";
+    // not analyzed yet
+    if (peak == -G_MAXFLOAT) {
+        g_object_set(renderer->gobj(), "text", "", NULL);
+        return;
+    }
+    gchar text[64];
+    gsize length = loudness == -G_MAXFLOAT
+        ? g_strlcpy(text, "silent", sizeof(text))
+        : g_snprintf(text, sizeof(text), "%.1f LUFS", loudness);
+    if (clipped > 0 && length < sizeof(text))
+        g_snprintf(text + length, sizeof(text) - length, " (%" G_GINT64_FORMAT " clipped)", clipped);
+    g_object_set(renderer->gobj(), "text", text, NULL);
 }
 
 struct RecordingTreeView::Priv {
     Glib::RefPtr<RecordingTreeModel> model;
     Gtk::TreeViewColumn id;
+    Gtk::CellRendererText id_renderer;
     Gtk::TreeViewColumn file;
     Gtk::CellRendererText file_renderer;
     Gtk::CellRendererText duration_renderer;
     Gtk::TreeViewColumn duration;
-    Gtk::CellRendererPixbuf quality_renderer1;
-    Gtk::CellRendererPixbuf quality_renderer2;
-    Gtk::CellRendererPixbuf quality_renderer3;
-    Gtk::CellRendererPixbuf quality_renderer4;
-    Gtk::CellRendererPixbuf quality_renderer5;
+    // reused by every call of duration_data_func()
+    char duration_buffer[DURATION_BUFFER_SIZE];
+    QualityCellRenderer quality_renderer;
     Gtk::TreeViewColumn quality;
+    Gtk::CellRendererText level_renderer;
+    Gtk::TreeViewColumn level;
 
     Priv()
         : id("ID")
         , file("File")
         , duration("Duration")
         , quality("Quality")
+        , level("Level")
     {
         id.set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
         id.set_fixed_width(40);
@@ -75,12 +105,9 @@ struct RecordingTreeView::Priv {
         quality.set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
         quality.set_fixed_width(100);
         quality.set_resizable(true);
-
-        quality_renderer1.set_alignment(0.0, 0.5);
-        quality_renderer2.set_alignment(0.0, 0.5);
-        quality_renderer3.set_alignment(0.0, 0.5);
-        quality_renderer4.set_alignment(0.0, 0.5);
-        quality_renderer5.set_alignment(0.0, 0.5);
+        level.set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
+        level.set_fixed_width(160);
+        level.set_resizable(true);
     }
 };
 
@@ -88,10 +115,12 @@ RecordingTreeView::RecordingTreeView()
     : m_priv(new Priv())
 {
     set_fixed_height_mode(true);
+    get_selection()->set_mode(Gtk::SELECTION_MULTIPLE);
     append_column(m_priv->id);
     append_column(m_priv->file);
     append_column(m_priv->duration);
     append_column(m_priv->quality);
+    append_column(m_priv->level);
 }
 
 void RecordingTreeView::set_model(const Glib::RefPtr<RecordingTreeModel>& model)
@@ -101,26 +130,22 @@ void RecordingTreeView::set_model(const Glib::RefPtr<RecordingTreeModel>& model)
     m_priv->id.clear();
     m_priv->file.clear();
     m_priv->duration.clear();
+    m_priv->quality.clear();
+    m_priv->level.clear();
 
     if (!model) {
         return;
     }
 
-    m_priv->id.pack_start(model->columns().id);
+    m_priv->id.pack_start(m_priv->id_renderer);
+    m_priv->id.set_cell_data_func(m_priv->id_renderer, sigc::bind(sigc::ptr_fun(&id_data_func), sigc::ref(model)));
     m_priv->file.pack_start(m_priv->file_renderer);
-    m_priv->file.set_renderer(m_priv->file_renderer, model->columns().file);
+    m_priv->file.set_cell_data_func(m_priv->file_renderer, sigc::bind(sigc::ptr_fun(&file_data_func), sigc::ref(model)));
     m_priv->duration.pack_start(m_priv->duration_renderer);
-    m_priv->duration.set_renderer(m_priv->duration_renderer, model->columns().duration);
-    m_priv->duration.set_cell_data_func(m_priv->duration_renderer, sigc::bind(sigc::ptr_fun(&duration_data_func), sigc::ref(model)));
-    m_priv->quality.pack_start(m_priv->quality_renderer1, false);
-    m_priv->quality.pack_start(m_priv->quality_renderer2, false);
-    m_priv->quality.pack_start(m_priv->quality_renderer3, false);
-    m_priv->quality.pack_start(m_priv->quality_renderer4, false);
-    m_priv->quality.pack_start(m_priv->quality_renderer5, false);
-    m_priv->quality.set_cell_data_func(m_priv->quality_renderer1, sigc::bind(sigc::ptr_fun(&quality_data_func), sigc::ref(model), 1));
-    m_priv->quality.set_cell_data_func(m_priv->quality_renderer2, sigc::bind(sigc::ptr_fun(&quality_data_func), sigc::ref(model), 2));
-    m_priv->quality.set_cell_data_func(m_priv->quality_renderer3, sigc::bind(sigc::ptr_fun(&quality_data_func), sigc::ref(model), 3));
-    m_priv->quality.set_cell_data_func(m_priv->quality_renderer4, sigc::bind(sigc::ptr_fun(&quality_data_func), sigc::ref(model), 4));
-    m_priv->quality.set_cell_data_func(m_priv->quality_renderer5, sigc::bind(sigc::ptr_fun(&quality_data_func), sigc::ref(model), 5));
+    m_priv->duration.set_cell_data_func(m_priv->duration_renderer, sigc::bind(sigc::ptr_fun(&duration_data_func), sigc::ref(model), &m_priv->duration_buffer[0]));
+    m_priv->quality.pack_start(m_priv->quality_renderer);
+    m_priv->quality.set_cell_data_func(m_priv->quality_renderer, sigc::bind(sigc::ptr_fun(&quality_data_func), sigc::ref(model)));
+    m_priv->level.pack_start(m_priv->level_renderer);
+    m_priv->level.set_cell_data_func(m_priv->level_renderer, sigc::bind(sigc::ptr_fun(&level_data_func), sigc::ref(model)));
 }
 }
@@ -21,7 +21,9 @@
 #include <gst/gst.h>
 #include <gom/gom.h>
 #include "GRefPtr.h"
+#include "media-init.h"
 #include "recording.h"
+#include "resource-dirty.h"
 #include "task.h"
 
 namespace SC {
@@ -96,6 +98,7 @@ struct Recording::Priv {
     {
         g_return_if_fail(file);
         CalculateDurationTask* task = new CalculateDurationTask(slot, this);
+        media_ensure_initialized();
         task->playbin = gst_element_factory_make("playbin", "playbin");
         g_object_set(task->playbin, "uri", file->get_uri().c_str(), NULL);
         gst_element_set_state(task->playbin, GST_STATE_PAUSED);
@@ -179,8 +182,10 @@ void Recording::got_location(GomRepository* repository, GAsyncResult* result, Lo
     }
 
     g_warn_if_fail(resource.get());
-    if (resource)
+    if (resource) {
+        sc_resource_clear_dirty(G_OBJECT(resource.get()));
         m_priv->location = Location::create(SC_LOCATION_RESOURCE(resource.get()));
+    }
 
     slot(m_priv->location);
 }
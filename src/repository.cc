@@ -18,19 +18,30 @@
  * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <glib/gstdio.h>
 #include <gom/gom.h>
 #include <iomanip>
+#include <vector>
 
+#include "analysis.h"
+#include "annotation-resource.h"
+#include "clip-extract.h"
+#include "embedding.h"
 #include "equipment-resource.h"
 #include "GRefPtr.h"
 #include "identification-resource.h"
 #include "location-resource.h"
+#include "read-pool.h"
 #include "recording.h"
 #include "recording-resource.h"
-#include "recording-resource.h"
 #include "repository.h"
+#include "resource-dirty.h"
+#include "similarity-index.h"
 #include "species-resource.h"
+#include "startup-trace.h"
 #include "task.h"
+#include "util.h"
 
 namespace SC {
 
@@ -38,20 +49,222 @@ static GType repository_types[] = { SC_TYPE_RECORDING_RESOURCE,
                                     SC_TYPE_SPECIES_RESOURCE,
                                     SC_TYPE_IDENTIFICATION_RESOURCE,
                                     SC_TYPE_LOCATION_RESOURCE,
-                                    SC_TYPE_EQUIPMENT_RESOURCE };
+                                    SC_TYPE_EQUIPMENT_RESOURCE,
+                                    SC_TYPE_ANNOTATION_RESOURCE };
+
+#define REPOSITORY_VERSION 4
+// bumped whenever finish_migration_proxy() starts filling in more columns, so
+// that databases that were already migrated get them too
+#define BACKFILL_VERSION 1
+
+// Describes everything that automatic migration, install_stats_schema() and
+// install_analysis_schema() create, so that a database whose stored fingerprint matches doesn't need
+// to be introspected at startup.
+static std::string compute_schema_fingerprint()
+{
+    std::string description = Glib::ustring::compose("version=%1;stats=%2;analysis=%3;backfill=%4;",
+                                                     REPOSITORY_VERSION,
+                                                     STATS_SCHEMA_VERSION,
+                                                     ANALYSIS_SCHEMA_VERSION,
+                                                     BACKFILL_VERSION);
+    for (guint i = 0; i < G_N_ELEMENTS(repository_types); i++) {
+        GomResourceClass* klass = GOM_RESOURCE_CLASS(g_type_class_ref(repository_types[i]));
+        guint n_pspecs = 0;
+        GParamSpec** pspecs = g_object_class_list_properties(G_OBJECT_CLASS(klass), &n_pspecs);
+        std::vector<std::string> columns;
+        for (guint j = 0; j < n_pspecs; j++) {
+            if (pspecs[j]->owner_type == GOM_TYPE_RESOURCE)
+                continue;
+            columns.push_back(Glib::ustring::compose("%1:%2",
+                                                     pspecs[j]->name,
+                                                     g_type_name(G_PARAM_SPEC_VALUE_TYPE(pspecs[j]))));
+        }
+        g_free(pspecs);
+        // property listing order isn't guaranteed
+        std::sort(columns.begin(), columns.end());
+
+        description += Glib::ustring::compose("%1[%2](", klass->table, klass->primary_key);
+        for (std::vector<std::string>::const_iterator it = columns.begin(); it != columns.end(); ++it)
+            description += *it + ",";
+        description += ");";
+        g_type_class_unref(klass);
+    }
 
-#define REPOSITORY_VERSION 1
+    gchar* checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, description.c_str(), -1);
+    std::string fingerprint(checksum);
+    g_free(checksum);
+    return fingerprint;
+}
+
+struct SchemaTask : public Task {
+    std::string fingerprint;
+    bool up_to_date;
+
+    SchemaTask(const std::string& fingerprint, const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , fingerprint(fingerprint)
+        , up_to_date(false)
+    {
+    }
+};
+
+// runs in the adapter thread
+static void check_schema_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    SchemaTask* task = reinterpret_cast<SchemaTask*>(user_data);
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "SELECT \"fingerprint\" FROM \"schema_fingerprint\" LIMIT 1",
+                     NULL)));
+    GomCursor* cursor = 0;
+    // a missing table just means that the schema was never recorded
+    if (gom_command_execute(command.get(), &cursor, NULL) && gom_cursor_next(cursor)) {
+        const gchar* stored = gom_cursor_get_column_string(cursor, 0);
+        task->up_to_date = stored && task->fingerprint == stored;
+    }
+    if (cursor)
+        g_object_unref(cursor);
+    g_task_return_boolean(task->task(), true);
+}
+
+// gom adds the columns of new properties without a DEFAULT, so rows that
+// existed before get NULL, which reads back as 0. Give them the properties'
+// defaults instead, which mark the levels as not measured yet.
+static bool backfill_recording_levels(GomAdapter* adapter, GError** error)
+{
+    static const char* levels[] = { "peak", "rms", "loudness", "noise-floor" };
+    for (guint i = 0; i < G_N_ELEMENTS(levels); ++i) {
+        GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+            g_object_new(GOM_TYPE_COMMAND,
+                         "adapter", adapter,
+                         "sql", Glib::ustring::compose("UPDATE \"recordings\" SET \"%1\" = ? WHERE \"%1\" IS NULL",
+                                                       levels[i]).c_str(),
+                         NULL)));
+        gom_command_set_param_double(command.get(), 0, -G_MAXFLOAT);
+        if (!gom_command_execute(command.get(), NULL, error))
+            return false;
+    }
+    return gom_adapter_execute_sql(adapter,
+                                   "UPDATE \"recordings\" SET \"clipped-samples\" = -1 "
+                                   "WHERE \"clipped-samples\" IS NULL",
+                                   error);
+}
+
+// runs in the adapter thread
+static void finish_migration_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    SchemaTask* task = reinterpret_cast<SchemaTask*>(user_data);
+    GError* error = 0;
+    // the aggregate tables reference the migrated tables, so they can only be
+    // set up once migration is done
+    if (!backfill_recording_levels(adapter, &error)
+        || !install_stats_schema(adapter, &error)
+        || !install_analysis_schema(adapter, &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+
+    if (!gom_adapter_execute_sql(adapter,
+                                 "CREATE TABLE IF NOT EXISTS \"schema_fingerprint\" (\"fingerprint\" TEXT)",
+                                 &error)
+        || !gom_adapter_execute_sql(adapter, "DELETE FROM \"schema_fingerprint\"", &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter", adapter,
+                     "sql", "INSERT INTO \"schema_fingerprint\" (\"fingerprint\") VALUES (?)",
+                     NULL)));
+    gom_command_set_param_string(command.get(), 0, task->fingerprint.c_str());
+    if (!gom_command_execute(command.get(), NULL, &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    task->up_to_date = true;
+    g_task_return_boolean(task->task(), true);
+}
+
+// The similarity index is brought up to date and searched from the read
+// connections, which run concurrently, so it is only used with the mutex held
+struct SharedSimilarityIndex {
+    SimilarityIndex index;
+    std::string path;
+    GMutex mutex;
+
+    SharedSimilarityIndex(const std::string& path)
+        : index(EMBEDDING_SIZE)
+        , path(path)
+    {
+        g_mutex_init(&mutex);
+    }
+
+    ~SharedSimilarityIndex()
+    {
+        g_mutex_clear(&mutex);
+    }
+};
 
 struct Repository::Priv {
     WTF::GRefPtr<GomRepository> repository;
     mutable sigc::signal<void> signal_database_changed;
+    mutable sigc::signal<void, GType> signal_resources_changed;
+    mutable sigc::signal<void> signal_closing;
     Glib::RefPtr<Gio::File> audio_dir;
+    std::string fingerprint;
+    bool ready;
+    std::vector<sigc::slot<void> > pending;
+    std::tr1::shared_ptr<SharedSimilarityIndex> similarity_index;
+    // for queries that don't load resources
+    std::tr1::shared_ptr<ReadPool> read_pool;
 
     Priv(GomAdapter* adapter, const Glib::ustring& audio_path)
         : audio_dir(Gio::File::create_for_path(audio_path))
+        , fingerprint(compute_schema_fingerprint())
+        , ready(false)
+        , similarity_index(new SharedSimilarityIndex(Glib::build_filename(Glib::path_get_dirname(audio_path),
+                                                                          "similarity-index")))
     {
         repository = adoptGRef(gom_repository_new(adapter));
+        read_pool = ReadPool::get(repository.get());
+
+        // Checking a single stored value is much cheaper than letting gom
+        // introspect every table, so only migrate when the schema changed
+        startup_trace_begin("schema-check");
+        SchemaTask* task = new SchemaTask(fingerprint,
+                                          sigc::mem_fun(this, &Priv::on_schema_checked));
+        gom_adapter_queue_read(adapter, check_schema_proxy, task);
+    }
+
+    GomAdapter* adapter() const
+    {
+        return gom_repository_get_adapter(repository.get());
+    }
+
+    static bool schema_task_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+    {
+        GTask* gtask = G_TASK(result->gobj());
+        GError* error = 0;
+        SchemaTask* task = reinterpret_cast<SchemaTask*>(g_task_get_task_data(gtask));
+        g_task_propagate_boolean(gtask, &error);
+        if (error)
+            throw Glib::Error(error);
+        return task->up_to_date;
+    }
 
+    void on_schema_checked(const Glib::RefPtr<Gio::AsyncResult>& result)
+    {
+        startup_trace_end("schema-check");
+        if (schema_task_finish(result)) {
+            g_debug("Database schema is up to date");
+            set_ready();
+            return;
+        }
+
+        g_debug("Database schema changed, migrating...");
+        startup_trace_begin("migration");
         GList* types = 0;
         for (int i = 0; i < G_N_ELEMENTS(repository_types); i++) {
             types = g_list_prepend(types, GINT_TO_POINTER(repository_types[i]));
@@ -63,6 +276,31 @@ struct Repository::Priv {
             Repository::repository_migrate_finished_proxy,
             this);
     }
+
+    void on_migration_finished(const Glib::RefPtr<Gio::AsyncResult>& result)
+    {
+        startup_trace_end("migration");
+        try
+        {
+            schema_task_finish(result);
+        }
+        catch (const Glib::Error& error)
+        {
+            // the repository is still usable, but the schema will be
+            // migrated again on the next start
+            g_warning("Unable to finish migration: %s", error.what().c_str());
+        }
+        set_ready();
+    }
+
+    void set_ready()
+    {
+        ready = true;
+        std::vector<sigc::slot<void> > slots;
+        slots.swap(pending);
+        for (std::vector<sigc::slot<void> >::iterator it = slots.begin(); it != slots.end(); ++it)
+            (*it)();
+    }
 };
 
 Repository::Repository(GomAdapter* adapter,
@@ -76,74 +314,96 @@ GomRepository* Repository::cobj()
     return m_priv->repository.get();
 }
 
-struct GetLocationsTask : public Task {
-    Repository* repository;
+bool Repository::is_ready() const
+{
+    return m_priv->ready;
+}
+
+void Repository::run_when_ready(const sigc::slot<void>& slot)
+{
+    if (m_priv->ready)
+        slot();
+    else
+        m_priv->pending.push_back(slot);
+}
 
-    GetLocationsTask(Repository* repository, const Gio::SlotAsyncReady& slot)
+struct GetRecordingTask : public Task {
+    GetRecordingTask(const Gio::SlotAsyncReady& slot)
         : Task(slot)
-        , repository(repository)
     {
     }
 };
 
-void found_locations(GObject* src,
-                     GAsyncResult* result,
-                     gpointer user_data)
+static void found_recording(GObject* src,
+                            GAsyncResult* result,
+                            gpointer user_data)
 {
     GError* error = 0;
-    GetLocationsTask* task = reinterpret_cast<GetLocationsTask*>(user_data);
-    GomResourceGroup* resources = gom_repository_find_finish(GOM_REPOSITORY(src),
-                                                             result,
-                                                             &error);
+    GetRecordingTask* task = reinterpret_cast<GetRecordingTask*>(user_data);
+    GomResource* resource = gom_repository_find_one_finish(GOM_REPOSITORY(src),
+                                                           result,
+                                                           &error);
     if (error) {
-        g_warning("Couldn't find locations: %s", error->message);
         g_task_return_error(task->task(), error);
         return;
     }
 
-    g_task_return_pointer(task->task(), resources, g_object_unref);
+    g_task_return_pointer(task->task(), resource, g_object_unref);
 }
 
-void Repository::get_locations_async(const Gio::SlotAsyncReady& slot)
+void Repository::get_recording_async(gint64 id, const Gio::SlotAsyncReady& slot)
 {
-    GetLocationsTask* task = new GetLocationsTask(this, slot);
-    gom_repository_find_async(m_priv->repository.get(),
-                              SC_TYPE_LOCATION_RESOURCE,
-                              NULL,
-                              found_locations,
-                              task);
+    if (!is_ready()) {
+        run_when_ready(sigc::bind(sigc::mem_fun(this, &Repository::get_recording_async), id, slot));
+        return;
+    }
+
+    GValue id_value = G_VALUE_INIT;
+    g_value_init(&id_value, G_TYPE_INT64);
+    g_value_set_int64(&id_value, id);
+    GRefPtr<GomFilter> filter = adoptGRef(gom_filter_new_eq(SC_TYPE_RECORDING_RESOURCE, "id", &id_value));
+    g_value_unset(&id_value);
+
+    GetRecordingTask* task = new GetRecordingTask(slot);
+    gom_repository_find_one_async(m_priv->repository.get(),
+                                  SC_TYPE_RECORDING_RESOURCE,
+                                  filter.get(),
+                                  found_recording,
+                                  task);
 }
 
-GomResourceGroup* Repository::get_locations_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+std::tr1::shared_ptr<Recording> Repository::get_recording_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
 {
     GTask* task = G_TASK(result->gobj());
     GError* error = 0;
-    gpointer resources = g_task_propagate_pointer(task, &error);
+    GRefPtr<GomResource> resource = adoptGRef(GOM_RESOURCE(g_task_propagate_pointer(task, &error)));
     if (error)
         throw Glib::Error(error);
+    if (!resource)
+        throw Glib::Error(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No such recording");
 
-    return GOM_RESOURCE_GROUP(resources);
+    // establish the baseline for tracking changes to the resource
+    sc_resource_clear_dirty(G_OBJECT(resource.get()));
+    return Recording::create(SC_RECORDING_RESOURCE(resource.get()));
 }
 
 void Repository::repository_migrate_finished_proxy(GObject* source_object,
                                                    GAsyncResult* res,
                                                    gpointer user_data)
 {
-    Repository* self = static_cast<Repository*>(user_data);
+    Repository::Priv* priv = static_cast<Repository::Priv*>(user_data);
     GomRepository* repository = reinterpret_cast<GomRepository*>(source_object);
-    self->repository_migrate_finished(repository, res);
-}
-
-void Repository::repository_migrate_finished(GomRepository* repository,
-                                             GAsyncResult* res)
-{
-    g_debug("%s", G_STRFUNC);
     GError* error = 0;
     if (!gom_repository_automatic_migrate_finish(repository, res, &error)) {
         g_error("failed to migrate repository: %s", error->message);
         g_error_free(error);
-    } else
-        g_debug("Repository migrated");
+        return;
+    }
+
+    g_debug("Repository migrated");
+    SchemaTask* task = new SchemaTask(priv->fingerprint,
+                                      sigc::mem_fun(priv, &Repository::Priv::on_migration_finished));
+    gom_adapter_queue_write(priv->adapter(), finish_migration_proxy, task);
 }
 
 sigc::signal<void>& Repository::signal_database_changed() const
@@ -151,6 +411,16 @@ sigc::signal<void>& Repository::signal_database_changed() const
     return m_priv->signal_database_changed;
 }
 
+sigc::signal<void, GType>& Repository::signal_resources_changed() const
+{
+    return m_priv->signal_resources_changed;
+}
+
+sigc::signal<void>& Repository::signal_closing() const
+{
+    return m_priv->signal_closing;
+}
+
 struct ImportFileTask : public Task {
     Repository* repository;
     std::tr1::shared_ptr<Recording> recording;
@@ -186,6 +456,7 @@ void resource_save_again_ready_proxy(GObject* source,
         g_task_return_error(task->task(), error);
         return;
     }
+    sc_resource_clear_dirty(G_OBJECT(resource));
     g_debug("updated resource %i", task->recording->id());
     g_task_return_boolean(task->task(), true);
 }
@@ -229,6 +500,7 @@ void resource_save_ready_proxy(GObject* source,
         g_task_return_error(task->task(), error);
         return;
     }
+    sc_resource_clear_dirty(G_OBJECT(resource));
 
     std::string filename = task->recording->file()->get_path();
     std::string extension;
@@ -276,6 +548,11 @@ void on_calculate_duration_ready(const Glib::RefPtr<Gio::AsyncResult>& result,
 void Repository::import_file_async(const Glib::RefPtr<Gio::File>& file,
                                    const Gio::SlotAsyncReady& slot)
 {
+    if (!is_ready()) {
+        run_when_ready(sigc::bind(sigc::mem_fun(this, &Repository::import_file_async), file, slot));
+        return;
+    }
+
     ImportFileTask* task = new ImportFileTask(this, slot);
     if (file->query_file_type() != Gio::FILE_TYPE_REGULAR) {
         g_task_return_new_error(task->task(),
@@ -304,4 +581,437 @@ Glib::RefPtr<Gio::File> Repository::audio_dir() const
 {
     return m_priv->audio_dir;
 }
+
+struct ExtractClipTask : public Task {
+    Repository* repository;
+    std::tr1::shared_ptr<Recording> parent;
+    std::string source;
+    std::string dest;
+    double start;
+    double end;
+    double duration;
+    std::tr1::shared_ptr<Recording> clip;
+
+    ExtractClipTask(Repository* repository, const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , repository(repository)
+        , start(0)
+        , end(0)
+        , duration(0)
+    {
+    }
+};
+
+// runs in a worker thread
+static void extract_clip_thread(GTask* worker,
+                                gpointer source_object,
+                                gpointer task_data,
+                                GCancellable* cancellable)
+{
+    ExtractClipTask* task = reinterpret_cast<ExtractClipTask*>(task_data);
+    GError* error = 0;
+    if (!extract_clip(task->source, task->dest, task->start, task->end, &task->duration, &error))
+        g_task_return_error(worker, error);
+    else
+        g_task_return_boolean(worker, true);
+}
+
+static void clip_saved_proxy(GObject* source,
+                             GAsyncResult* result,
+                             gpointer user_data)
+{
+    ExtractClipTask* task = reinterpret_cast<ExtractClipTask*>(user_data);
+    GError* error = 0;
+    GomResource* resource = GOM_RESOURCE(source);
+    if (!gom_resource_save_finish(resource, result, &error)) {
+        g_unlink(task->dest.c_str());
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    sc_resource_clear_dirty(G_OBJECT(resource));
+    task->clip = Recording::create(SC_RECORDING_RESOURCE(resource));
+    g_debug("saved clip %" G_GINT64_FORMAT " of recording %" G_GINT64_FORMAT,
+            task->clip->id(), task->parent->id());
+    g_task_return_boolean(task->task(), true);
+}
+
+static void clip_written_proxy(GObject* source,
+                               GAsyncResult* result,
+                               gpointer user_data)
+{
+    ExtractClipTask* task = reinterpret_cast<ExtractClipTask*>(user_data);
+    GError* error = 0;
+    if (!g_task_propagate_boolean(G_TASK(result), &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+
+    // the clip inherits what is known about where and by whom it was recorded
+    ScRecordingResource* parent = task->parent->resource();
+    GDateTime* date = sc_recording_resource_get_date(parent);
+    Glib::ustring remarks = Glib::ustring::compose("%1 - %2 of %3",
+                                                   format_duration(task->start),
+                                                   format_duration(task->start + task->duration),
+                                                   task->parent->file()->get_basename());
+    WTF::GRefPtr<ScRecordingResource> resource = adoptGRef(SC_RECORDING_RESOURCE(
+        g_object_new(SC_TYPE_RECORDING_RESOURCE,
+                     "repository", task->repository->cobj(),
+                     "file", task->dest.c_str(),
+                     "duration", static_cast<float>(task->duration),
+                     "parent-id", task->parent->id(),
+                     "recordist", sc_recording_resource_get_recordist(parent),
+                     "location-id", sc_recording_resource_get_location_id(parent),
+                     "elevation", sc_recording_resource_get_elevation(parent),
+                     "quality", sc_recording_resource_get_quality(parent),
+                     "remarks", remarks.c_str(),
+                     NULL)));
+    if (date)
+        g_object_set(resource.get(), "date", date, NULL);
+    gom_resource_save_async(GOM_RESOURCE(resource.get()), clip_saved_proxy, task);
+}
+
+void Repository::extract_clip_async(const std::tr1::shared_ptr<Recording>& parent,
+                                    double start,
+                                    double end,
+                                    const Gio::SlotAsyncReady& slot)
+{
+    if (!is_ready()) {
+        run_when_ready(sigc::bind(sigc::mem_fun(this, &Repository::extract_clip_async),
+                                  parent, start, end, slot));
+        return;
+    }
+
+    ExtractClipTask* task = new ExtractClipTask(this, slot);
+    task->parent = parent;
+    task->source = parent->file()->get_path();
+    task->start = start;
+    task->end = end;
+
+    // find an unused name next to the parent's, e.g. SC000012-clip-0003500.wav
+    std::string base = Glib::ustring::compose("SC%1-clip-%2",
+                                              Glib::ustring::format(std::setfill(L'0'), std::setw(6), parent->id()),
+                                              Glib::ustring::format(std::setfill(L'0'), std::setw(7), static_cast<gint64>(start * 1000)));
+    Glib::RefPtr<Gio::File> dest = audio_dir()->get_child(base + ".wav");
+    for (int i = 1; dest->query_exists(); ++i)
+        dest = audio_dir()->get_child(Glib::ustring::compose("%1-%2.wav", base, i));
+    task->dest = dest->get_path();
+
+    GTask* worker = g_task_new(NULL, NULL, clip_written_proxy, task);
+    g_task_set_task_data(worker, task, NULL);
+    g_task_run_in_thread(worker, extract_clip_thread);
+    g_object_unref(worker);
+}
+
+std::tr1::shared_ptr<Recording> Repository::extract_clip_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    ExtractClipTask* task = reinterpret_cast<ExtractClipTask*>(g_task_get_task_data(gtask));
+    g_task_propagate_boolean(gtask, &error);
+    if (error)
+        throw Glib::Error(error);
+
+    signal_database_changed().emit();
+    return task->clip;
+}
+
+std::tr1::shared_ptr<SaveQueue> Repository::save_queue()
+{
+    return SaveQueue::get(m_priv->repository.get());
+}
+
+struct GetStatsTask : public Task {
+    StatsGrouping grouping;
+    StatsVector stats;
+
+    GetStatsTask(StatsGrouping grouping, const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , grouping(grouping)
+    {
+    }
+};
+
+// runs in the adapter thread
+static void query_stats_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    GetStatsTask* task = reinterpret_cast<GetStatsTask*>(user_data);
+    GError* error = 0;
+    if (!query_stats(adapter, task->grouping, task->stats, &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    g_task_return_boolean(task->task(), true);
+}
+
+void Repository::get_stats_async(StatsGrouping grouping,
+                                 const Gio::SlotAsyncReady& slot)
+{
+    GetStatsTask* task = new GetStatsTask(grouping, slot);
+    run_when_ready(sigc::bind(sigc::mem_fun(*m_priv->read_pool, &ReadPool::queue_read),
+                              query_stats_proxy,
+                              task));
+}
+
+StatsVector Repository::get_stats_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    GetStatsTask* task = reinterpret_cast<GetStatsTask*>(g_task_get_task_data(gtask));
+    g_task_propagate_boolean(gtask, &error);
+    if (error)
+        throw Glib::Error(error);
+
+    return task->stats;
+}
+
+// time-aligned landmarks needed to call two recordings duplicates; chance
+// matches between unrelated recordings rarely line up this often
+static const guint MIN_DUPLICATE_MATCHES = 10;
+
+struct FindDuplicatesTask : public Task {
+    gint64 recording_id;
+    DuplicateVector duplicates;
+
+    FindDuplicatesTask(gint64 recording_id, const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , recording_id(recording_id)
+    {
+    }
+};
+
+// runs in the adapter thread
+static void find_duplicates_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    FindDuplicatesTask* task = reinterpret_cast<FindDuplicatesTask*>(user_data);
+    GError* error = 0;
+    if (!query_duplicates(adapter,
+                          task->recording_id,
+                          MIN_DUPLICATE_MATCHES,
+                          task->duplicates,
+                          &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    g_task_return_boolean(task->task(), true);
+}
+
+void Repository::find_duplicates_async(gint64 recording_id,
+                                       const Gio::SlotAsyncReady& slot)
+{
+    FindDuplicatesTask* task = new FindDuplicatesTask(recording_id, slot);
+    run_when_ready(sigc::bind(sigc::mem_fun(*m_priv->read_pool, &ReadPool::queue_read),
+                              find_duplicates_proxy,
+                              task));
+}
+
+DuplicateVector Repository::find_duplicates_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    FindDuplicatesTask* task = reinterpret_cast<FindDuplicatesTask*>(g_task_get_task_data(gtask));
+    g_task_propagate_boolean(gtask, &error);
+    if (error)
+        throw Glib::Error(error);
+
+    return task->duplicates;
+}
+
+struct FindSimilarTask : public Task {
+    std::tr1::shared_ptr<SharedSimilarityIndex> index;
+    gint64 recording_id;
+    guint count;
+    std::vector<gint64> similar;
+
+    FindSimilarTask(const std::tr1::shared_ptr<SharedSimilarityIndex>& index,
+                    gint64 recording_id,
+                    guint count,
+                    const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , index(index)
+        , recording_id(recording_id)
+        , count(count)
+    {
+    }
+};
+
+// runs in the thread of a read connection
+static void find_similar_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    FindSimilarTask* task = reinterpret_cast<FindSimilarTask*>(user_data);
+    GError* error = 0;
+    Embedding query;
+    if (!query_embedding(adapter, task->recording_id, query, &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+
+    g_mutex_lock(&task->index->mutex);
+    bool updated = update_similarity_index(adapter, task->index->index, task->index->path, &error);
+    if (updated && !query.empty())
+        task->similar = task->index->index.search(&query[0], task->count, task->recording_id);
+    g_mutex_unlock(&task->index->mutex);
+
+    if (!updated) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    g_task_return_boolean(task->task(), true);
+}
+
+void Repository::find_similar_async(gint64 recording_id,
+                                    guint count,
+                                    const Gio::SlotAsyncReady& slot)
+{
+    FindSimilarTask* task = new FindSimilarTask(m_priv->similarity_index,
+                                                recording_id,
+                                                count,
+                                                slot);
+    run_when_ready(sigc::bind(sigc::mem_fun(*m_priv->read_pool, &ReadPool::queue_read),
+                              find_similar_proxy,
+                              task));
+}
+
+std::vector<gint64> Repository::find_similar_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    FindSimilarTask* task = reinterpret_cast<FindSimilarTask*>(g_task_get_task_data(gtask));
+    g_task_propagate_boolean(gtask, &error);
+    if (error)
+        throw Glib::Error(error);
+
+    return task->similar;
+}
+
+struct BulkUpdateTask : public Task {
+    GType type;
+    std::string sql;
+    GArray* values;
+    gint64 changed;
+
+    BulkUpdateTask(GType type, const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+        , type(type)
+        , values(g_array_new(FALSE, TRUE, sizeof(GValue)))
+        , changed(0)
+    {
+        g_array_set_clear_func(values, reinterpret_cast<GDestroyNotify>(g_value_unset));
+    }
+
+    ~BulkUpdateTask()
+    {
+        g_array_unref(values);
+    }
+
+    void append_value(const GValue* value)
+    {
+        GValue copy = G_VALUE_INIT;
+        g_value_init(&copy, G_VALUE_TYPE(value));
+        g_value_copy(value, &copy);
+        g_array_append_val(values, copy);
+    }
+};
+
+// runs in the adapter thread
+static void bulk_update_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    BulkUpdateTask* task = reinterpret_cast<BulkUpdateTask*>(user_data);
+    GError* error = 0;
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND, "adapter", adapter, "sql", task->sql.c_str(), NULL)));
+    for (guint i = 0; i < task->values->len; ++i)
+        gom_command_set_param(command.get(), i, &g_array_index(task->values, GValue, i));
+    if (!gom_command_execute(command.get(), NULL, &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+
+    command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND, "adapter", adapter, "sql", "SELECT changes()", NULL)));
+    GomCursor* cursor = 0;
+    if (gom_command_execute(command.get(), &cursor, NULL) && gom_cursor_next(cursor))
+        task->changed = gom_cursor_get_column_int64(cursor, 0);
+    if (cursor)
+        g_object_unref(cursor);
+
+    g_task_return_boolean(task->task(), true);
+}
+
+void Repository::bulk_update_async(GType type,
+                                   GomFilter* filter,
+                                   const PropertyMap& changes,
+                                   const Gio::SlotAsyncReady& slot)
+{
+    BulkUpdateTask* task = new BulkUpdateTask(type, slot);
+    GomResourceClass* klass = GOM_RESOURCE_CLASS(g_type_class_ref(type));
+
+    std::string assignments;
+    for (PropertyMap::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+        GParamSpec* pspec = g_object_class_find_property(G_OBJECT_CLASS(klass), it->first.c_str());
+        if (!pspec || pspec->owner_type == GOM_TYPE_RESOURCE
+            || g_str_equal(pspec->name, klass->primary_key)) {
+            g_task_return_new_error(task->task(),
+                                    G_IO_ERROR,
+                                    G_IO_ERROR_INVALID_ARGUMENT,
+                                    "Cannot update property '%s' of %s",
+                                    it->first.c_str(),
+                                    g_type_name(type));
+            g_type_class_unref(klass);
+            return;
+        }
+
+        // convert the value to the property type so it is bound correctly
+        GValue value = G_VALUE_INIT;
+        g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(pspec));
+        if (!g_value_transform(it->second.gobj(), &value)) {
+            g_task_return_new_error(task->task(),
+                                    G_IO_ERROR,
+                                    G_IO_ERROR_INVALID_ARGUMENT,
+                                    "Invalid value for property '%s'",
+                                    pspec->name);
+            g_value_unset(&value);
+            g_type_class_unref(klass);
+            return;
+        }
+        task->append_value(&value);
+        g_value_unset(&value);
+
+        if (!assignments.empty())
+            assignments += ", ";
+        assignments += Glib::ustring::compose("\"%1\" = ?", pspec->name);
+    }
+
+    task->sql = Glib::ustring::compose("UPDATE \"%1\" SET %2", klass->table, assignments);
+    if (filter) {
+        gchar* where = gom_filter_get_sql(filter, NULL);
+        task->sql += Glib::ustring::compose(" WHERE %1", where);
+        g_free(where);
+
+        GArray* filter_values = gom_filter_get_values(filter);
+        for (guint i = 0; filter_values && i < filter_values->len; ++i)
+            task->append_value(&g_array_index(filter_values, GValue, i));
+        if (filter_values)
+            g_array_unref(filter_values);
+    }
+    g_type_class_unref(klass);
+
+    g_debug("Bulk update: %s", task->sql.c_str());
+    run_when_ready(sigc::bind(sigc::ptr_fun(&gom_adapter_queue_write),
+                              m_priv->adapter(),
+                              bulk_update_proxy,
+                              task));
+}
+
+gint64 Repository::bulk_update_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* gtask = G_TASK(result->gobj());
+    GError* error = 0;
+    BulkUpdateTask* task = reinterpret_cast<BulkUpdateTask*>(g_task_get_task_data(gtask));
+    g_task_propagate_boolean(gtask, &error);
+    if (error)
+        throw Glib::Error(error);
+
+    signal_resources_changed().emit(task->type);
+    return task->changed;
+}
 }
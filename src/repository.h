@@ -24,28 +24,78 @@
 #include <giomm.h>
 #include <gom/gom.h>
 #include <glibmm.h>
+#include <map>
 #include <tr1/memory>
+#include <vector>
+
+#include "collection-stats.h"
+#include "fingerprint.h"
+#include "recording.h"
+#include "save-queue.h"
 
 namespace SC {
+
+typedef std::map<std::string, Glib::ValueBase> PropertyMap;
+
 class Repository {
 public:
     Repository(GomAdapter* adapter, const Glib::ustring& audio_path);
 
-    void get_locations_async(const Gio::SlotAsyncReady& slot);
-    GomResourceGroup* get_locations_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
+    // Loads the full resource of a single recording, e.g. for a row of a
+    // list that only holds the columns it displays
+    void get_recording_async(gint64 id, const Gio::SlotAsyncReady& slot);
+    std::tr1::shared_ptr<Recording> get_recording_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
     GomRepository* cobj();
+    // true once the database schema is known to be up to date; queries made
+    // before that are deferred until it is
+    bool is_ready() const;
+    void run_when_ready(const sigc::slot<void>& slot);
     sigc::signal<void>& signal_database_changed() const;
+    // emitted after resources of the given type were modified in place,
+    // e.g. by bulk_update_async()
+    sigc::signal<void, GType>& signal_resources_changed() const;
+    // emitted by the application before the database is closed at exit, for
+    // saving state that should be available early on the next start
+    sigc::signal<void>& signal_closing() const;
     void import_file_async(const Glib::RefPtr<Gio::File>& file,
                            const Gio::SlotAsyncReady& slot);
     bool import_file_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
     Glib::RefPtr<Gio::File> audio_dir() const;
+    // Copies the audio between @start and @end seconds of @parent into a new
+    // file in the collection and adds it as a recording derived from @parent
+    void extract_clip_async(const std::tr1::shared_ptr<Recording>& parent,
+                            double start,
+                            double end,
+                            const Gio::SlotAsyncReady& slot);
+    std::tr1::shared_ptr<Recording> extract_clip_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
+    std::tr1::shared_ptr<SaveQueue> save_queue();
+    void bulk_update_async(GType type,
+                           GomFilter* filter,
+                           const PropertyMap& changes,
+                           const Gio::SlotAsyncReady& slot);
+    gint64 bulk_update_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
+    void get_stats_async(StatsGrouping grouping,
+                         const Gio::SlotAsyncReady& slot);
+    StatsVector get_stats_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
+    // Finds recordings that contain the same audio as @recording_id, e.g.
+    // transcoded copies or overlapping excerpts. Only recordings that were
+    // fingerprinted by an AnalysisJob are considered.
+    void find_duplicates_async(gint64 recording_id,
+                               const Gio::SlotAsyncReady& slot);
+    DuplicateVector find_duplicates_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
+    // Finds the (approximately) @count recordings that sound most like
+    // @recording_id, most similar first. The similarity index in the
+    // collection directory is brought up to date first if recordings were
+    // analyzed since it was last used.
+    void find_similar_async(gint64 recording_id,
+                            guint count,
+                            const Gio::SlotAsyncReady& slot);
+    std::vector<gint64> find_similar_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
 
 private:
     static void repository_migrate_finished_proxy(GObject* source_object,
                                                   GAsyncResult* res,
                                                   gpointer user_data);
-    void repository_migrate_finished(GomRepository* repository,
-                                     GAsyncResult* res);
 
     struct Priv;
     std::tr1::shared_ptr<Priv> m_priv;
@@ -0,0 +1,117 @@
+/*
+ * resource-dirty.c
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gom/gom.h>
+#include "resource-dirty.h"
+
+/* bit 0 is never used by a property (PROP_0), so it marks the baseline */
+#define TRACKED_BIT G_GUINT64_CONSTANT(1)
+
+static GQuark sc_resource_dirty_quark(void)
+{
+    static GQuark quark = 0;
+    if (G_UNLIKELY(!quark))
+        quark = g_quark_from_static_string("sc-resource-dirty");
+    return quark;
+}
+
+static guint64* get_mask(GObject* object, gboolean create)
+{
+    guint64* mask = g_object_get_qdata(object, sc_resource_dirty_quark());
+    if (!mask && create) {
+        mask = g_new0(guint64, 1);
+        g_object_set_qdata_full(object, sc_resource_dirty_quark(), mask, g_free);
+    }
+    return mask;
+}
+
+static guint64 property_bit(GParamSpec* pspec)
+{
+    g_return_val_if_fail(pspec->param_id > 0 && pspec->param_id < 64, 0);
+    return G_GUINT64_CONSTANT(1) << pspec->param_id;
+}
+
+void sc_resource_track_change(GObject* object,
+                              GParamSpec* pspec,
+                              const GValue* value)
+{
+    guint64* mask = get_mask(object, TRUE);
+    GValue old_value = G_VALUE_INIT;
+
+    if (*mask & property_bit(pspec))
+        return;
+
+    /* the primary key identifies the row and is never written as a column */
+    if (GOM_IS_RESOURCE(object)
+        && g_strcmp0(pspec->name, GOM_RESOURCE_GET_CLASS(object)->primary_key) == 0)
+        return;
+
+    g_value_init(&old_value, G_PARAM_SPEC_VALUE_TYPE(pspec));
+    g_object_get_property(object, pspec->name, &old_value);
+    if (g_param_values_cmp(pspec, &old_value, value) != 0)
+        *mask |= property_bit(pspec);
+    g_value_unset(&old_value);
+}
+
+gboolean sc_resource_is_tracked(GObject* object)
+{
+    guint64* mask = get_mask(object, FALSE);
+    return mask && (*mask & TRACKED_BIT);
+}
+
+gboolean sc_resource_is_dirty(GObject* object, GParamSpec* pspec)
+{
+    guint64* mask = get_mask(object, FALSE);
+    if (!mask || !(*mask & TRACKED_BIT))
+        return TRUE;
+    return (*mask & property_bit(pspec)) != 0;
+}
+
+gboolean sc_resource_has_changes(GObject* object)
+{
+    guint64* mask = get_mask(object, FALSE);
+    if (!mask || !(*mask & TRACKED_BIT))
+        return TRUE;
+    return (*mask & ~TRACKED_BIT) != 0;
+}
+
+/* Returns the current set of dirty properties and resets it, so that changes
+ * made while a save is in progress are not lost. Pass the result to
+ * sc_resource_restore_dirty() if the save fails. */
+guint64 sc_resource_steal_dirty(GObject* object)
+{
+    guint64* mask = get_mask(object, TRUE);
+    guint64 dirty = *mask;
+    *mask = TRACKED_BIT;
+    return dirty;
+}
+
+void sc_resource_restore_dirty(GObject* object, guint64 dirty)
+{
+    guint64* mask = get_mask(object, TRUE);
+    if (!(dirty & TRACKED_BIT))
+        *mask &= ~TRACKED_BIT;
+    *mask |= dirty & ~TRACKED_BIT;
+}
+
+void sc_resource_clear_dirty(GObject* object)
+{
+    *get_mask(object, TRUE) = TRACKED_BIT;
+}
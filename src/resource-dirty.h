@@ -0,0 +1,50 @@
+/*
+ * resource-dirty.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SC_RESOURCE_DIRTY_H__
+#define __SC_RESOURCE_DIRTY_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Per-property dirty tracking for the resource classes. Each resource's
+ * set_property() implementation calls sc_resource_track_change() so that
+ * properties whose value actually changes are recorded.
+ *
+ * Tracking only becomes meaningful once a baseline has been established with
+ * sc_resource_clear_dirty(), typically right after the resource was loaded from
+ * or written to the database. Until then every property has to be considered
+ * modified, and sc_resource_is_tracked() returns FALSE.
+ */
+void sc_resource_track_change(GObject* object,
+                              GParamSpec* pspec,
+                              const GValue* value);
+gboolean sc_resource_is_tracked(GObject* object);
+gboolean sc_resource_is_dirty(GObject* object, GParamSpec* pspec);
+gboolean sc_resource_has_changes(GObject* object);
+guint64 sc_resource_steal_dirty(GObject* object);
+void sc_resource_restore_dirty(GObject* object, guint64 dirty);
+void sc_resource_clear_dirty(GObject* object);
+
+G_END_DECLS
+
+#endif /* __SC_RESOURCE_DIRTY_H__ */
@@ -18,6 +18,7 @@
  * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "GRefPtr.h"
 #include "resource-edit-window.h"
 
 namespace SC {
@@ -62,25 +63,22 @@ void ResourceEditWindow::add_form(ResourceEditForm& form)
     form.show();
 }
 
-void ResourceEditWindow::on_resource_save_proxy(GObject* source, GAsyncResult* result, gpointer user_data)
-{
-    ResourceEditWindow* self = reinterpret_cast<ResourceEditWindow*>(user_data);
-    self->on_resource_save(GOM_RESOURCE(source), result);
-}
-
-void ResourceEditWindow::on_resource_save(GomResource* resource, GAsyncResult* result)
+void ResourceEditWindow::on_resource_save(const Glib::RefPtr<Gio::AsyncResult>& result,
+                                          const std::tr1::shared_ptr<SaveQueue>& queue)
 {
     m_priv->spinner.stop();
     m_priv->spinner.hide();
-    GError* error = 0;
 
-    if (!gom_resource_save_finish(resource, result, &error)) {
-        m_priv->infobar.set_message_type(Gtk::MESSAGE_ERROR);
-        m_priv->info_label.set_text(Glib::ustring::compose("Failed to save resource: %1", error->message));
-        g_clear_error(&error);
-    } else {
+    try
+    {
+        queue->flush_finish(result);
         m_priv->info_label.set_text("Saved");
     }
+    catch (const Glib::Error& error)
+    {
+        m_priv->infobar.set_message_type(Gtk::MESSAGE_ERROR);
+        m_priv->info_label.set_text(Glib::ustring::compose("Failed to save resource: %1", error.what()));
+    }
     Glib::signal_timeout().connect_seconds_once(sigc::mem_fun(this, &Gtk::Widget::hide), 1);
 }
 
@@ -94,7 +92,15 @@ void ResourceEditWindow::on_response(int response_id)
         m_priv->spinner.start();
         m_priv->spinner.show();
         m_priv->infobar.show();
-        gom_resource_save_async(m_priv->form->resource(), on_resource_save_proxy, this);
+        // the form only changes the resource in memory; it is handed to the
+        // repository's save queue here, so that cancelling discards the edits
+        GomResource* resource = m_priv->form->resource();
+        GRefPtr<GomRepository> repository;
+        g_object_get(resource, "repository", &repository.outPtr(), NULL);
+        std::tr1::shared_ptr<SaveQueue> queue = SaveQueue::get(repository.get());
+        queue->queue(resource);
+        // written with the next batch, together with edits from other windows
+        queue->wait_async(sigc::bind(sigc::mem_fun(this, &ResourceEditWindow::on_resource_save), queue));
         return;
     }
 
@@ -25,6 +25,7 @@
 #include <tr1/memory>
 
 #include "resource-edit-form.h"
+#include "save-queue.h"
 
 namespace SC {
 
@@ -36,8 +37,8 @@ public:
 
 private:
     void on_response(int response_id);
-    static void on_resource_save_proxy(GObject* soruce, GAsyncResult* result, gpointer user_data);
-    void on_resource_save(GomResource* resource, GAsyncResult* result);
+    void on_resource_save(const Glib::RefPtr<Gio::AsyncResult>& result,
+                          const std::tr1::shared_ptr<SaveQueue>& queue);
 
     struct Priv;
     std::tr1::shared_ptr<Priv> m_priv;
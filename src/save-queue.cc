@@ -0,0 +1,477 @@
+/*
+ * save-queue.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <vector>
+
+#include "GRefPtr.h"
+#include "resource-dirty.h"
+#include "save-queue.h"
+#include "task.h"
+
+namespace SC {
+
+static const guint DEFAULT_DELAY = 500; // ms
+// even when edits keep arriving, don't hold on to them longer than this
+static const guint MAX_DELAY_FACTOR = 10;
+
+static const char* SAVE_QUEUE_KEY = "sc-save-queue";
+
+struct FlushTask : public Task {
+    FlushTask(const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+    {
+    }
+};
+
+typedef std::vector<FlushTask*> FlushTaskVector;
+
+static void return_all(FlushTaskVector& tasks, const GError* error)
+{
+    for (FlushTaskVector::iterator it = tasks.begin(); it != tasks.end(); ++it) {
+        if (error)
+            g_task_return_error((*it)->task(), g_error_copy(error));
+        else
+            g_task_return_boolean((*it)->task(), true);
+    }
+    tasks.clear();
+}
+
+// The statement that writes a queued resource: an INSERT for a resource
+// that is not in the database yet, otherwise an UPDATE of the columns whose
+// properties changed since the last save (all of them if that isn't known)
+struct ResourceWrite {
+    GRefPtr<GomResource> resource;
+    guint64 dirty;
+    std::string sql;
+    GArray* values;
+    bool insert;
+    gint64 inserted_id;
+
+    ResourceWrite(GomResource* resource)
+        : resource(resource)
+        , dirty(0)
+        , values(g_array_new(FALSE, TRUE, sizeof(GValue)))
+        , insert(false)
+        , inserted_id(0)
+    {
+        g_array_set_clear_func(values, reinterpret_cast<GDestroyNotify>(g_value_unset));
+    }
+
+    ~ResourceWrite()
+    {
+        g_array_unref(values);
+    }
+
+    void add_value(GObject* object, GParamSpec* pspec)
+    {
+        GValue value = G_VALUE_INIT;
+        g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(pspec));
+        g_object_get_property(object, pspec->name, &value);
+        g_array_append_val(values, value);
+    }
+};
+
+typedef std::vector<std::tr1::shared_ptr<ResourceWrite> > ResourceWriteVector;
+
+static bool has_primary_key(GomResource* resource)
+{
+    GomResourceClass* klass = GOM_RESOURCE_GET_CLASS(resource);
+    GParamSpec* pspec = g_object_class_find_property(G_OBJECT_CLASS(klass), klass->primary_key);
+    g_return_val_if_fail(pspec, false);
+
+    GValue value = G_VALUE_INIT;
+    GValue id = G_VALUE_INIT;
+    g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(pspec));
+    g_value_init(&id, G_TYPE_INT64);
+    g_object_get_property(G_OBJECT(resource), pspec->name, &value);
+    bool has_key = g_value_transform(&value, &id) && g_value_get_int64(&id) != 0;
+    g_value_unset(&value);
+    g_value_unset(&id);
+    return has_key;
+}
+
+// Returns a write without SQL if nothing but the primary key changed
+static std::tr1::shared_ptr<ResourceWrite> build_write(GomResource* resource)
+{
+    GObject* object = G_OBJECT(resource);
+    std::tr1::shared_ptr<ResourceWrite> write(new ResourceWrite(resource));
+    write->insert = !has_primary_key(resource);
+    GomResourceClass* klass = GOM_RESOURCE_GET_CLASS(resource);
+    std::string columns;
+    std::string placeholders;
+    guint n_pspecs = 0;
+    GParamSpec** pspecs = g_object_class_list_properties(G_OBJECT_CLASS(klass), &n_pspecs);
+    for (guint i = 0; i < n_pspecs; ++i) {
+        // skip GomResource's own properties and the primary key; untracked
+        // resources report every property as dirty
+        if (pspecs[i]->owner_type == GOM_TYPE_RESOURCE
+            || g_str_equal(pspecs[i]->name, klass->primary_key)
+            || (!write->insert && !sc_resource_is_dirty(object, pspecs[i])))
+            continue;
+        if (!columns.empty()) {
+            columns += ", ";
+            placeholders += ", ";
+        }
+        columns += Glib::ustring::compose(write->insert ? "\"%1\"" : "\"%1\" = ?", pspecs[i]->name);
+        placeholders += "?";
+        write->add_value(object, pspecs[i]);
+    }
+    g_free(pspecs);
+    write->dirty = sc_resource_steal_dirty(object);
+
+    if (write->insert) {
+        write->sql = Glib::ustring::compose("INSERT INTO \"%1\" (%2) VALUES (%3)",
+                                            klass->table,
+                                            columns,
+                                            placeholders);
+    } else if (!columns.empty()) {
+        write->sql = Glib::ustring::compose("UPDATE \"%1\" SET %2 WHERE \"%3\" = ?",
+                                            klass->table,
+                                            columns,
+                                            klass->primary_key);
+        write->add_value(object, g_object_class_find_property(G_OBJECT_CLASS(klass), klass->primary_key));
+    }
+    return write;
+}
+
+// all writes of one batch, done in one transaction
+struct WriteTask : public Task {
+    ResourceWriteVector writes;
+
+    WriteTask(const Gio::SlotAsyncReady& slot)
+        : Task(slot)
+    {
+    }
+};
+
+static bool execute_write(GomAdapter* adapter,
+                          ResourceWrite& write,
+                          GError** error)
+{
+    GRefPtr<GomCommand> command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND,
+                     "adapter",
+                     adapter,
+                     "sql",
+                     write.sql.c_str(),
+                     NULL)));
+    for (guint i = 0; i < write.values->len; ++i)
+        gom_command_set_param(command.get(), i, &g_array_index(write.values, GValue, i));
+    if (!gom_command_execute(command.get(), NULL, error))
+        return false;
+    if (!write.insert)
+        return true;
+
+    command = adoptGRef(GOM_COMMAND(
+        g_object_new(GOM_TYPE_COMMAND, "adapter", adapter, "sql", "SELECT last_insert_rowid()", NULL)));
+    GomCursor* cursor = 0;
+    if (!gom_command_execute(command.get(), &cursor, error))
+        return false;
+    if (cursor && gom_cursor_next(cursor))
+        write.inserted_id = gom_cursor_get_column_int64(cursor, 0);
+    if (cursor)
+        g_object_unref(cursor);
+    return true;
+}
+
+// runs in the adapter thread
+static void write_batch(GomAdapter* adapter, gpointer user_data)
+{
+    WriteTask* task = reinterpret_cast<WriteTask*>(user_data);
+    GError* error = 0;
+    if (!gom_adapter_execute_sql(adapter, "BEGIN", &error)) {
+        g_task_return_error(task->task(), error);
+        return;
+    }
+
+    for (ResourceWriteVector::const_iterator it = task->writes.begin();
+         it != task->writes.end();
+         ++it) {
+        if (!execute_write(adapter, **it, &error)) {
+            gom_adapter_execute_sql(adapter, "ROLLBACK", NULL);
+            g_task_return_error(task->task(), error);
+            return;
+        }
+    }
+
+    if (!gom_adapter_execute_sql(adapter, "COMMIT", &error)) {
+        gom_adapter_execute_sql(adapter, "ROLLBACK", NULL);
+        g_task_return_error(task->task(), error);
+        return;
+    }
+    g_task_return_boolean(task->task(), true);
+}
+
+// gives a resource that was just inserted the id it got in the database
+static void set_primary_key(GomResource* resource, gint64 id)
+{
+    GomResourceClass* klass = GOM_RESOURCE_GET_CLASS(resource);
+    GParamSpec* pspec = g_object_class_find_property(G_OBJECT_CLASS(klass), klass->primary_key);
+    GValue value = G_VALUE_INIT;
+    GValue key = G_VALUE_INIT;
+    g_value_init(&value, G_TYPE_INT64);
+    g_value_set_int64(&value, id);
+    g_value_init(&key, G_PARAM_SPEC_VALUE_TYPE(pspec));
+    if (g_value_transform(&value, &key))
+        g_object_set_property(G_OBJECT(resource), pspec->name, &key);
+    g_value_unset(&value);
+    g_value_unset(&key);
+}
+
+struct SaveQueue::Priv {
+    typedef std::map<GomResource*, GRefPtr<GomResource> > ResourceMap;
+
+    GomRepository* repository; // weak ref; the repository owns us
+    ResourceMap pending;
+    FlushTaskVector waiters; // waiting for the pending resources to be written
+    // set by flush_async(); wait_async() leaves the timing to the timer
+    bool flush_requested;
+    WriteTask* in_flight;
+    FlushTaskVector in_flight_waiters;
+    guint delay;
+    gint64 first_queued;
+    sigc::connection timeout;
+    sigc::signal<void> signal_flushed;
+
+    Priv(GomRepository* repository)
+        : repository(repository)
+        , flush_requested(false)
+        , in_flight(0)
+        , delay(DEFAULT_DELAY)
+        , first_queued(0)
+    {
+    }
+
+    ~Priv()
+    {
+        timeout.disconnect();
+        if (!pending.empty())
+            g_warning("Discarding %u unsaved resources", static_cast<guint>(pending.size()));
+    }
+
+    void queue(GomResource* resource)
+    {
+        gint64 now = g_get_monotonic_time();
+        if (pending.empty())
+            first_queued = now;
+        pending[resource] = resource;
+
+        // debounce: restart the timer on every edit, unless the oldest pending
+        // edit has already waited long enough
+        if (timeout.connected()
+            && (now - first_queued) / 1000 >= delay * MAX_DELAY_FACTOR)
+            return;
+        timeout.disconnect();
+        timeout = Glib::signal_timeout().connect(sigc::mem_fun(this, &Priv::on_timeout), delay);
+    }
+
+    bool on_timeout()
+    {
+        flush();
+        return false;
+    }
+
+    void flush()
+    {
+        timeout.disconnect();
+
+        // the current batch needs to finish first; we'll get called again
+        if (in_flight)
+            return;
+        flush_requested = false;
+
+        WriteTask* task = new WriteTask(sigc::mem_fun(this, &Priv::batch_done));
+        for (ResourceMap::iterator it = pending.begin(); it != pending.end(); ++it) {
+            GomResource* resource = it->second.get();
+            if (!sc_resource_has_changes(G_OBJECT(resource)))
+                continue;
+            std::tr1::shared_ptr<ResourceWrite> write = build_write(resource);
+            if (!write->sql.empty())
+                task->writes.push_back(write);
+        }
+        pending.clear();
+        in_flight = task;
+        in_flight_waiters.swap(waiters);
+
+        g_debug("Writing %u queued resources", static_cast<guint>(task->writes.size()));
+        // an empty batch still goes through the writer, so that waiters are
+        // answered in order
+        gom_adapter_queue_write(gom_repository_get_adapter(repository), write_batch, task);
+    }
+
+    void batch_done(const Glib::RefPtr<Gio::AsyncResult>& result)
+    {
+        GError* error = 0;
+        ResourceWriteVector& writes = in_flight->writes;
+        if (!g_task_propagate_boolean(G_TASK(result->gobj()), &error)) {
+            g_warning("Failed to write queued resources: %s", error->message);
+            for (ResourceWriteVector::iterator it = writes.begin(); it != writes.end(); ++it)
+                sc_resource_restore_dirty(G_OBJECT((*it)->resource.get()), (*it)->dirty);
+        } else {
+            for (ResourceWriteVector::iterator it = writes.begin(); it != writes.end(); ++it) {
+                if ((*it)->insert)
+                    set_primary_key((*it)->resource.get(), (*it)->inserted_id);
+            }
+        }
+
+        // the task is freed once this returns
+        in_flight = 0;
+        FlushTaskVector done;
+        done.swap(in_flight_waiters);
+        return_all(done, error);
+        g_clear_error(&error);
+
+        signal_flushed.emit();
+
+        // somebody asked for a flush while we were busy
+        if (flush_requested)
+            flush();
+        else if (!pending.empty() && !timeout.connected())
+            timeout = Glib::signal_timeout().connect(sigc::mem_fun(this, &Priv::on_timeout), delay);
+    }
+
+    void flush_async(FlushTask* task)
+    {
+        if (pending.empty() && in_flight) {
+            // nothing new to write, just wait for the current batch
+            in_flight_waiters.push_back(task);
+            return;
+        }
+        waiters.push_back(task);
+        flush_requested = true;
+        flush();
+    }
+
+    void wait_async(FlushTask* task)
+    {
+        if (!pending.empty())
+            waiters.push_back(task);
+        else if (in_flight)
+            in_flight_waiters.push_back(task);
+        else
+            g_task_return_boolean(task->task(), true);
+    }
+};
+
+static void delete_save_queue(gpointer data)
+{
+    delete reinterpret_cast<std::tr1::shared_ptr<SaveQueue>*>(data);
+}
+
+std::tr1::shared_ptr<SaveQueue> SaveQueue::get(GomRepository* repository)
+{
+    g_return_val_if_fail(GOM_IS_REPOSITORY(repository), std::tr1::shared_ptr<SaveQueue>());
+
+    std::tr1::shared_ptr<SaveQueue>* queue = reinterpret_cast<std::tr1::shared_ptr<SaveQueue>*>(
+        g_object_get_data(G_OBJECT(repository), SAVE_QUEUE_KEY));
+    if (!queue) {
+        queue = new std::tr1::shared_ptr<SaveQueue>(new SaveQueue(repository));
+        g_object_set_data_full(G_OBJECT(repository), SAVE_QUEUE_KEY, queue, delete_save_queue);
+    }
+    return *queue;
+}
+
+SaveQueue::SaveQueue(GomRepository* repository)
+    : m_priv(new Priv(repository))
+{
+}
+
+void SaveQueue::queue(GomResource* resource)
+{
+    g_return_if_fail(GOM_IS_RESOURCE(resource));
+    m_priv->queue(resource);
+}
+
+bool SaveQueue::is_pending(GomResource* resource) const
+{
+    return m_priv->pending.find(resource) != m_priv->pending.end();
+}
+
+void SaveQueue::set_delay(guint milliseconds)
+{
+    m_priv->delay = milliseconds;
+}
+
+void SaveQueue::flush_async(const Gio::SlotAsyncReady& slot)
+{
+    m_priv->flush_async(new FlushTask(slot));
+}
+
+void SaveQueue::wait_async(const Gio::SlotAsyncReady& slot)
+{
+    m_priv->wait_async(new FlushTask(slot));
+}
+
+bool SaveQueue::flush_finish(const Glib::RefPtr<Gio::AsyncResult>& result)
+{
+    GTask* task = G_TASK(result->gobj());
+    GError* error = 0;
+    bool status = g_task_propagate_boolean(task, &error);
+    if (error)
+        throw Glib::Error(error);
+
+    return status;
+}
+
+struct FlushSyncData {
+    GMainLoop* loop;
+    GError* error;
+};
+
+static void flush_sync_done(const Glib::RefPtr<Gio::AsyncResult>& result,
+                            SaveQueue* queue,
+                            FlushSyncData* data)
+{
+    try
+    {
+        queue->flush_finish(result);
+    }
+    catch (const Glib::Error& error)
+    {
+        data->error = g_error_copy(error.gobj());
+    }
+    g_main_loop_quit(data->loop);
+}
+
+bool SaveQueue::flush_sync(GError** error)
+{
+    if (m_priv->pending.empty() && !m_priv->in_flight)
+        return true;
+
+    FlushSyncData data;
+    data.loop = g_main_loop_new(0, FALSE);
+    data.error = 0;
+    flush_async(sigc::bind(sigc::ptr_fun(flush_sync_done), this, &data));
+    g_main_loop_run(data.loop);
+    g_main_loop_unref(data.loop);
+
+    if (data.error) {
+        g_propagate_error(error, data.error);
+        return false;
+    }
+    return true;
+}
+
+sigc::signal<void>& SaveQueue::signal_flushed()
+{
+    return m_priv->signal_flushed;
+}
+}
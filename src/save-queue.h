@@ -0,0 +1,71 @@
+/*
+ * save-queue.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SAVE_QUEUE_H
+#define _SAVE_QUEUE_H
+
+#include <giomm.h>
+#include <gom/gom.h>
+#include <tr1/memory>
+
+namespace SC {
+
+/*
+ * Write-behind queue for modified resources. Queueing the same resource
+ * several times before it is written results in a single save, and all
+ * resources that are pending when the debounce timer fires (or when a flush is
+ * requested) are written together in one transaction in the adapter thread.
+ * There is one queue per GomRepository so that edits from all open windows end
+ * up in the same batch.
+ *
+ * Resources that are already in the database and have a dirty-tracking
+ * baseline (see resource-dirty.h) are written with UPDATE statements that only
+ * touch the columns that changed. Untracked ones have all of their columns
+ * updated, and resources that aren't in the database yet are inserted.
+ */
+class SaveQueue {
+public:
+    static std::tr1::shared_ptr<SaveQueue> get(GomRepository* repository);
+
+    void queue(GomResource* resource);
+    bool is_pending(GomResource* resource) const;
+    void set_delay(guint milliseconds);
+
+    // writes the pending resources right away
+    void flush_async(const Gio::SlotAsyncReady& slot);
+    // completes once the resources that are pending now have been written,
+    // leaving it to the debounce timer when that happens
+    void wait_async(const Gio::SlotAsyncReady& slot);
+    // finishes flush_async() and wait_async()
+    bool flush_finish(const Glib::RefPtr<Gio::AsyncResult>& result);
+    // iterates the main context until all pending resources are written
+    bool flush_sync(GError** error);
+
+    sigc::signal<void>& signal_flushed();
+
+private:
+    SaveQueue(GomRepository* repository);
+
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _SAVE_QUEUE_H */
@@ -0,0 +1,357 @@
+/*
+ * similarity-index.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <gio/gio.h>
+#include <set>
+
+#include "similarity-index.h"
+
+namespace SC {
+
+static const char MAGIC[8] = { 'S', 'C', 'I', 'V', 'F', '0', '0', '1' };
+static const guint MAX_LISTS = 1024;
+static const guint KMEANS_ITERATIONS = 10;
+// lists scanned per query; more lists give better recall at a higher cost
+static const guint PROBES = 8;
+
+static float squared_distance(const float* a, const float* b, guint dimension)
+{
+    float sum = 0;
+    for (guint i = 0; i < dimension; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+struct SimilarityIndex::Priv {
+    guint dimension;
+    guint trained;
+    gint64 last_rowid;
+    std::vector<float> mean;
+    std::vector<float> scale;
+    // nlists * dimension
+    std::vector<float> centroids;
+    std::vector<std::vector<gint64> > list_ids;
+    std::vector<std::vector<float> > list_vectors;
+    std::set<gint64> ids;
+
+    Priv(guint dimension)
+        : dimension(dimension)
+        , trained(0)
+        , last_rowid(0)
+        , mean(dimension, 0.0f)
+        , scale(dimension, 1.0f)
+    {
+    }
+
+    guint n_lists() const
+    {
+        return list_ids.size();
+    }
+
+    void standardize(const float* vector, float* out) const
+    {
+        for (guint i = 0; i < dimension; ++i)
+            out[i] = (vector[i] - mean[i]) * scale[i];
+    }
+
+    guint nearest_list(const float* vector) const
+    {
+        guint best = 0;
+        float best_distance = G_MAXFLOAT;
+        for (guint i = 0; i < n_lists(); ++i) {
+            float d = squared_distance(vector, &centroids[i * dimension], dimension);
+            if (d < best_distance) {
+                best_distance = d;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void compute_scaling(const std::vector<float>& vectors, guint n)
+    {
+        std::vector<double> sum(dimension, 0.0);
+        std::vector<double> sum_squares(dimension, 0.0);
+        for (guint i = 0; i < n; ++i) {
+            const float* v = &vectors[i * dimension];
+            for (guint j = 0; j < dimension; ++j) {
+                sum[j] += v[j];
+                sum_squares[j] += v[j] * v[j];
+            }
+        }
+        for (guint j = 0; j < dimension; ++j) {
+            double m = n ? sum[j] / n : 0;
+            double variance = n ? sum_squares[j] / n - m * m : 0;
+            mean[j] = m;
+            scale[j] = variance > 1e-12 ? 1.0 / std::sqrt(variance) : 1.0;
+        }
+    }
+
+    // Lloyd's algorithm, seeded with vectors spread evenly over the input
+    void train(const std::vector<float>& vectors, guint n)
+    {
+        guint k = std::max(1u, std::min(MAX_LISTS, static_cast<guint>(std::sqrt(static_cast<double>(n)))));
+        centroids.assign(k * dimension, 0.0f);
+        for (guint i = 0; i < k && n; ++i) {
+            const float* seed = &vectors[(static_cast<guint64>(i) * n / k) * dimension];
+            std::copy(seed, seed + dimension, centroids.begin() + i * dimension);
+        }
+        list_ids.assign(k, std::vector<gint64>());
+
+        std::vector<guint> assignment(n, 0);
+        std::vector<float> sums(k * dimension);
+        std::vector<guint> counts(k);
+        for (guint iteration = 0; iteration < KMEANS_ITERATIONS; ++iteration) {
+            std::fill(sums.begin(), sums.end(), 0.0f);
+            std::fill(counts.begin(), counts.end(), 0);
+            for (guint i = 0; i < n; ++i) {
+                const float* v = &vectors[i * dimension];
+                assignment[i] = nearest_list(v);
+                float* sum = &sums[assignment[i] * dimension];
+                for (guint j = 0; j < dimension; ++j)
+                    sum[j] += v[j];
+                counts[assignment[i]]++;
+            }
+            // empty clusters keep their previous centroid
+            for (guint c = 0; c < k; ++c) {
+                if (!counts[c])
+                    continue;
+                for (guint j = 0; j < dimension; ++j)
+                    centroids[c * dimension + j] = sums[c * dimension + j] / counts[c];
+            }
+        }
+    }
+
+    void insert(gint64 id, const float* standardized)
+    {
+        guint list = nearest_list(standardized);
+        list_ids[list].push_back(id);
+        list_vectors[list].insert(list_vectors[list].end(), standardized, standardized + dimension);
+        ids.insert(id);
+    }
+};
+
+SimilarityIndex::SimilarityIndex(guint dimension)
+    : m_priv(new Priv(dimension))
+{
+}
+
+guint SimilarityIndex::dimension() const
+{
+    return m_priv->dimension;
+}
+
+guint SimilarityIndex::size() const
+{
+    return m_priv->ids.size();
+}
+
+bool SimilarityIndex::contains(gint64 id) const
+{
+    return m_priv->ids.count(id);
+}
+
+guint SimilarityIndex::trained_size() const
+{
+    return m_priv->trained;
+}
+
+gint64 SimilarityIndex::last_rowid() const
+{
+    return m_priv->last_rowid;
+}
+
+void SimilarityIndex::set_last_rowid(gint64 rowid)
+{
+    m_priv->last_rowid = rowid;
+}
+
+void SimilarityIndex::build(const std::vector<gint64>& ids, const std::vector<float>& vectors)
+{
+    guint n = ids.size();
+    guint dimension = m_priv->dimension;
+    g_return_if_fail(vectors.size() == n * dimension);
+
+    m_priv->compute_scaling(vectors, n);
+    std::vector<float> standardized(vectors.size());
+    for (guint i = 0; i < n; ++i)
+        m_priv->standardize(&vectors[i * dimension], &standardized[i * dimension]);
+
+    m_priv->train(standardized, n);
+    m_priv->list_vectors.assign(m_priv->n_lists(), std::vector<float>());
+    m_priv->ids.clear();
+    for (guint i = 0; i < n; ++i)
+        m_priv->insert(ids[i], &standardized[i * dimension]);
+    m_priv->trained = n;
+}
+
+void SimilarityIndex::add(gint64 id, const float* vector)
+{
+    g_return_if_fail(!contains(id));
+    if (!m_priv->n_lists()) {
+        build(std::vector<gint64>(1, id), std::vector<float>(vector, vector + m_priv->dimension));
+        return;
+    }
+    std::vector<float> standardized(m_priv->dimension);
+    m_priv->standardize(vector, &standardized[0]);
+    m_priv->insert(id, &standardized[0]);
+}
+
+std::vector<gint64> SimilarityIndex::search(const float* query, guint k, gint64 exclude_id) const
+{
+    guint dimension = m_priv->dimension;
+    std::vector<gint64> results;
+    if (!size())
+        return results;
+
+    std::vector<float> q(dimension);
+    m_priv->standardize(query, &q[0]);
+
+    std::vector<std::pair<float, guint> > lists;
+    for (guint i = 0; i < m_priv->n_lists(); ++i)
+        lists.push_back(std::make_pair(squared_distance(&q[0], &m_priv->centroids[i * dimension], dimension), i));
+    guint probes = std::min<guint>(PROBES, lists.size());
+    std::partial_sort(lists.begin(), lists.begin() + probes, lists.end());
+
+    std::vector<std::pair<float, gint64> > candidates;
+    for (guint p = 0; p < probes; ++p) {
+        const std::vector<gint64>& ids = m_priv->list_ids[lists[p].second];
+        const std::vector<float>& vectors = m_priv->list_vectors[lists[p].second];
+        for (guint i = 0; i < ids.size(); ++i) {
+            if (ids[i] == exclude_id)
+                continue;
+            candidates.push_back(std::make_pair(squared_distance(&q[0], &vectors[i * dimension], dimension), ids[i]));
+        }
+    }
+
+    guint n = std::min<guint>(k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end());
+    for (guint i = 0; i < n; ++i)
+        results.push_back(candidates[i].second);
+    return results;
+}
+
+template <typename T>
+static void append(std::string& data, const T& value)
+{
+    data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static void append_array(std::string& data, const std::vector<T>& values)
+{
+    if (!values.empty())
+        data.append(reinterpret_cast<const char*>(&values[0]), values.size() * sizeof(T));
+}
+
+// The file is a cache that can always be rebuilt from the database, so it is
+// written in native byte order
+bool SimilarityIndex::save(const std::string& path, GError** error) const
+{
+    std::string data(MAGIC, sizeof(MAGIC));
+    append(data, static_cast<guint32>(m_priv->dimension));
+    append(data, static_cast<guint32>(m_priv->n_lists()));
+    append(data, static_cast<guint32>(m_priv->trained));
+    append(data, m_priv->last_rowid);
+    append_array(data, m_priv->mean);
+    append_array(data, m_priv->scale);
+    append_array(data, m_priv->centroids);
+    for (guint i = 0; i < m_priv->n_lists(); ++i) {
+        append(data, static_cast<guint32>(m_priv->list_ids[i].size()));
+        append_array(data, m_priv->list_ids[i]);
+        append_array(data, m_priv->list_vectors[i]);
+    }
+    return g_file_set_contents(path.c_str(), data.data(), data.size(), error);
+}
+
+struct Reader {
+    const char* data;
+    gsize remaining;
+
+    template <typename T>
+    bool read(T& value)
+    {
+        if (remaining < sizeof(T))
+            return false;
+        memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        remaining -= sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool read_array(std::vector<T>& values, gsize n)
+    {
+        if (remaining / sizeof(T) < n)
+            return false;
+        values.resize(n);
+        if (n)
+            memcpy(&values[0], data, n * sizeof(T));
+        data += n * sizeof(T);
+        remaining -= n * sizeof(T);
+        return true;
+    }
+};
+
+bool SimilarityIndex::load(const std::string& path, GError** error)
+{
+    gchar* contents = 0;
+    gsize length = 0;
+    if (!g_file_get_contents(path.c_str(), &contents, &length, error))
+        return false;
+
+    Priv loaded(m_priv->dimension);
+    Reader reader = { contents, length };
+    guint32 dimension = 0, n_lists = 0, trained = 0;
+    bool valid = length >= sizeof(MAGIC) && !memcmp(contents, MAGIC, sizeof(MAGIC));
+    reader.data += sizeof(MAGIC);
+    reader.remaining -= std::min(length, sizeof(MAGIC));
+    valid = valid && reader.read(dimension) && dimension == m_priv->dimension
+            && reader.read(n_lists) && n_lists <= MAX_LISTS
+            && reader.read(trained) && reader.read(loaded.last_rowid)
+            && reader.read_array(loaded.mean, dimension)
+            && reader.read_array(loaded.scale, dimension)
+            && reader.read_array(loaded.centroids, n_lists * dimension);
+    loaded.list_ids.resize(n_lists);
+    loaded.list_vectors.resize(n_lists);
+    for (guint i = 0; valid && i < n_lists; ++i) {
+        guint32 n = 0;
+        valid = reader.read(n)
+                && reader.read_array(loaded.list_ids[i], n)
+                && reader.read_array(loaded.list_vectors[i], n * dimension);
+        loaded.ids.insert(loaded.list_ids[i].begin(), loaded.list_ids[i].end());
+    }
+    g_free(contents);
+
+    if (!valid) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s is not a valid similarity index", path.c_str());
+        return false;
+    }
+    loaded.trained = trained;
+    *m_priv = loaded;
+    return true;
+}
+}
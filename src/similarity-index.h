@@ -0,0 +1,63 @@
+/*
+ * similarity-index.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SIMILARITY_INDEX_H
+#define _SIMILARITY_INDEX_H
+
+#include <glib.h>
+#include <string>
+#include <tr1/memory>
+#include <vector>
+
+namespace SC {
+// An inverted file (IVF) index for approximate nearest neighbour search.
+// Vectors are standardized per dimension and assigned to the nearest of
+// about sqrt(n) k-means centroids; a search only scans the lists of the
+// centroids closest to the query.
+class SimilarityIndex {
+public:
+    explicit SimilarityIndex(guint dimension);
+
+    guint dimension() const;
+    guint size() const;
+    bool contains(gint64 id) const;
+    // number of vectors the centroids were trained on
+    guint trained_size() const;
+    // the embeddings table rowid the index is up to date with
+    gint64 last_rowid() const;
+    void set_last_rowid(gint64 rowid);
+
+    // Replaces the contents of the index; @vectors holds ids.size() vectors
+    void build(const std::vector<gint64>& ids, const std::vector<float>& vectors);
+    // Adds a vector without retraining. @id must not be in the index yet.
+    void add(gint64 id, const float* vector);
+    // ids of the (approximately) @k nearest vectors, nearest first
+    std::vector<gint64> search(const float* query, guint k, gint64 exclude_id = -1) const;
+
+    bool save(const std::string& path, GError** error) const;
+    bool load(const std::string& path, GError** error);
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _SIMILARITY_INDEX_H */
@@ -18,42 +18,181 @@
  * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
+#include "preview-pool.h"
 #include "simple-audio-player.h"
 
 namespace SC {
 
+// how often the position is reported while playing
+static const guint POSITION_INTERVAL_MS = 100;
+
 struct SimpleAudioPlayer::Priv {
     Glib::RefPtr<Gio::File> file;
-    GstElement* pipeline;
     GstElement* playbin;
+    std::tr1::shared_ptr<PreviewPool> pool;
+    gulong message_handler;
+    // the last state the pipeline reported; it's never queried synchronously
+    GstState state;
+    // a flushing seek was sent and the pipeline hasn't prerolled again yet
+    bool seeking;
+    bool has_pending_seek;
+    double pending_seek;
+    bool pending_seek_accurate;
+    mutable gint64 duration;
+    sigc::connection position_timer;
+    sigc::signal<void, double, double> signal_position_changed;
 
-    Priv(const Glib::RefPtr<Gio::File>& f)
-        : playbin(gst_element_factory_make("playbin", "playbin"))
+    Priv()
+        : playbin(0)
+        , pool(PreviewPool::get_default())
+        , message_handler(0)
+        , state(GST_STATE_NULL)
+        , seeking(false)
+        , has_pending_seek(false)
+        , pending_seek(0)
+        , pending_seek_accurate(false)
+        , duration(GST_CLOCK_TIME_NONE)
     {
-        set_file(f);
     }
 
     ~Priv()
     {
-        gst_element_set_state(playbin, GST_STATE_NULL);
-        gst_object_unref(playbin);
+        release_pipeline();
     }
 
-    void set_file(const Glib::RefPtr<Gio::File>& f)
+    void release_pipeline()
     {
-        file = f;
-        gst_element_set_state(playbin, GST_STATE_NULL);
-        g_object_set(playbin, "uri", f->get_uri().c_str(), NULL);
-        gst_element_set_state(playbin, GST_STATE_PAUSED);
+        position_timer.disconnect();
+        if (!playbin)
+            return;
+        GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(playbin));
+        g_signal_handler_disconnect(bus, message_handler);
+        gst_bus_remove_signal_watch(bus);
+        gst_object_unref(bus);
+        // hand it back so that going back to this file is fast as well
+        pool->release(playbin);
+        playbin = 0;
+        message_handler = 0;
+        state = GST_STATE_NULL;
+        seeking = false;
+        has_pending_seek = false;
+        duration = GST_CLOCK_TIME_NONE;
+    }
+
+    void do_seek(double seconds, bool accurate)
+    {
+        GstSeekFlags flags = GST_SEEK_FLAG_FLUSH;
+        if (accurate)
+            flags = GstSeekFlags(flags | GST_SEEK_FLAG_ACCURATE);
+        else
+            flags = GstSeekFlags(flags | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_NEAREST);
+
+        gint64 position = static_cast<gint64>(std::max(seconds, 0.0) * GST_SECOND);
+        if (gst_element_seek_simple(playbin, GST_FORMAT_TIME, flags, position))
+            seeking = true;
     }
 };
 
+SimpleAudioPlayer::SimpleAudioPlayer()
+    : m_priv(new Priv())
+{
+    set_sensitive(false);
+    set_image_from_icon_name("media-playback-start");
+}
+
 SimpleAudioPlayer::SimpleAudioPlayer(const Glib::RefPtr<Gio::File>& file)
-    : m_priv(new Priv(file))
+    : m_priv(new Priv())
+{
+    set_image_from_icon_name("media-playback-start");
+    set_file(file);
+}
+
+void SimpleAudioPlayer::set_file(const Glib::RefPtr<Gio::File>& file)
 {
+    bool was_playing = is_playing();
+    m_priv->release_pipeline();
+
+    m_priv->file = file;
+    if (!file) {
+        pipeline_state_changed();
+        return;
+    }
+
+    m_priv->playbin = m_priv->pool->acquire(file);
     GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(m_priv->playbin));
     gst_bus_add_signal_watch(bus);
-    g_signal_connect(bus, "message", G_CALLBACK(SimpleAudioPlayer::on_pipeline_message_proxy), this);
+    m_priv->message_handler = g_signal_connect(bus,
+                                               "message",
+                                               G_CALLBACK(SimpleAudioPlayer::on_pipeline_message_proxy),
+                                               this);
+    gst_object_unref(bus);
+
+    // a pipeline from the pool may have finished prerolling already; a zero
+    // timeout just reads the current state without waiting
+    gst_element_get_state(m_priv->playbin, &m_priv->state, NULL, 0);
+    if (was_playing)
+        gst_element_set_state(m_priv->playbin, GST_STATE_PLAYING);
+    pipeline_state_changed();
+}
+
+bool SimpleAudioPlayer::is_playing() const
+{
+    return m_priv->state == GST_STATE_PLAYING;
+}
+
+void SimpleAudioPlayer::seek(double seconds, bool accurate)
+{
+    if (!m_priv->playbin)
+        return;
+
+    if (m_priv->seeking) {
+        m_priv->has_pending_seek = true;
+        m_priv->pending_seek = seconds;
+        m_priv->pending_seek_accurate = accurate;
+        return;
+    }
+    m_priv->do_seek(seconds, accurate);
+}
+
+bool SimpleAudioPlayer::query_position(double& seconds) const
+{
+    gint64 position = 0;
+    if (!m_priv->playbin
+        || !gst_element_query_position(m_priv->playbin, GST_FORMAT_TIME, &position))
+        return false;
+    seconds = static_cast<double>(position) / GST_SECOND;
+    return true;
+}
+
+bool SimpleAudioPlayer::query_duration(double& seconds) const
+{
+    if (!m_priv->playbin)
+        return false;
+    if (!GST_CLOCK_TIME_IS_VALID(m_priv->duration)
+        && !gst_element_query_duration(m_priv->playbin, GST_FORMAT_TIME, &m_priv->duration))
+        return false;
+    seconds = static_cast<double>(m_priv->duration) / GST_SECOND;
+    return true;
+}
+
+sigc::signal<void, double, double>& SimpleAudioPlayer::signal_position_changed()
+{
+    return m_priv->signal_position_changed;
+}
+
+void SimpleAudioPlayer::emit_position()
+{
+    double position = 0, duration = 0;
+    if (query_position(position) && query_duration(duration))
+        m_priv->signal_position_changed.emit(position, duration);
+}
+
+bool SimpleAudioPlayer::on_position_timeout()
+{
+    emit_position();
+    return true;
 }
 
 void SimpleAudioPlayer::on_pipeline_message_proxy(GstBus* bus, GstMessage* message, gpointer user_data)
@@ -66,16 +205,48 @@ void SimpleAudioPlayer::on_pipeline_message(GstBus* bus, GstMessage* message)
 {
     switch (message->type) {
     case GST_MESSAGE_STATE_CHANGED:
-        pipeline_state_changed();
+        // only the pipeline itself matters, not its elements
+        if (GST_MESSAGE_SRC(message) == GST_OBJECT(m_priv->playbin)) {
+            gst_message_parse_state_changed(message, NULL, &m_priv->state, NULL);
+            pipeline_state_changed();
+        }
+        break;
+    case GST_MESSAGE_ASYNC_DONE:
+        // the pipeline prerolled after a seek; send the seek that was
+        // requested in the meantime, if any
+        m_priv->seeking = false;
+        if (m_priv->has_pending_seek) {
+            m_priv->has_pending_seek = false;
+            m_priv->do_seek(m_priv->pending_seek, m_priv->pending_seek_accurate);
+        }
+        emit_position();
+        break;
+    case GST_MESSAGE_DURATION_CHANGED:
+        m_priv->duration = GST_CLOCK_TIME_NONE;
+        break;
+    case GST_MESSAGE_EOS:
+        // rewind so that the file can be played again
+        gst_element_set_state(m_priv->playbin, GST_STATE_PAUSED);
+        m_priv->do_seek(0, true);
+        break;
+    default:
         break;
     }
 }
 
 void SimpleAudioPlayer::pipeline_state_changed()
 {
-    GstState state = GST_STATE_VOID_PENDING;
-    gst_element_get_state(m_priv->playbin, &state, 0, 100 * GST_MSECOND);
-    switch (state) {
+    // only poll the position while it is actually moving
+    if (m_priv->state == GST_STATE_PLAYING) {
+        if (!m_priv->position_timer.connected())
+            m_priv->position_timer = Glib::signal_timeout().connect(
+                sigc::mem_fun(this, &SimpleAudioPlayer::on_position_timeout),
+                POSITION_INTERVAL_MS);
+    } else {
+        m_priv->position_timer.disconnect();
+    }
+
+    switch (m_priv->state) {
     case GST_STATE_PLAYING:
         set_sensitive(true);
         set_image_from_icon_name("media-playback-pause");
@@ -91,9 +262,9 @@ void SimpleAudioPlayer::pipeline_state_changed()
 
 void SimpleAudioPlayer::on_clicked()
 {
-    GstState state = GST_STATE_VOID_PENDING;
-    gst_element_get_state(m_priv->playbin, &state, 0, 100 * GST_MSECOND);
-    if (state == GST_STATE_PLAYING)
+    if (!m_priv->playbin)
+        return;
+    if (is_playing())
         gst_element_set_state(m_priv->playbin, GST_STATE_PAUSED);
     else
         gst_element_set_state(m_priv->playbin, GST_STATE_PLAYING);
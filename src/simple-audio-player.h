@@ -28,13 +28,29 @@
 namespace SC {
 class SimpleAudioPlayer : public Gtk::Button {
 public:
+    SimpleAudioPlayer();
     SimpleAudioPlayer(const Glib::RefPtr<Gio::File>& file);
+    // switches to @file, continuing playback if the previous file was
+    // playing; prerolled pipelines from the PreviewPool are used if available
     void set_file(const Glib::RefPtr<Gio::File>& file);
+    bool is_playing() const;
+
+    // Seeks to @seconds. Fast seeks go to the nearest key unit, which is
+    // what scrubbing wants; accurate seeks land on the exact position.
+    // While a seek is still being processed, only the latest request is kept.
+    void seek(double seconds, bool accurate = true);
+    bool query_position(double& seconds) const;
+    bool query_duration(double& seconds) const;
+    // (position, duration) in seconds; emitted periodically while playing
+    // and whenever a seek completes
+    sigc::signal<void, double, double>& signal_position_changed();
 
 private:
     static void on_pipeline_message_proxy(GstBus* bus, GstMessage* message, gpointer user_data);
     void on_pipeline_message(GstBus* bus, GstMessage* message);
     void pipeline_state_changed();
+    bool on_position_timeout();
+    void emit_position();
     virtual void on_clicked();
 
     struct Priv;
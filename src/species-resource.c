@@ -21,6 +21,7 @@
 #include <glib.h>
 
 #include "species-resource.h"
+#include "resource-dirty.h"
 
 #define SC_SPECIES_RESOURCE_GET_PRIVATE(object) \
     (G_TYPE_INSTANCE_GET_PRIVATE(               \
@@ -66,6 +67,8 @@ static void sc_species_resource_set_property(GObject* obj,
 {
     ScSpeciesResource* self = SC_SPECIES_RESOURCE(obj);
 
+    sc_resource_track_change(obj, pspec, value);
+
     switch (property_id) {
     case PROP_ID:
         self->priv->id = g_value_get_int64(value);
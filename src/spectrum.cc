@@ -0,0 +1,135 @@
+/*
+ * spectrum.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "spectrum.h"
+
+namespace SC {
+
+struct Spectrum::Priv {
+    guint size;
+    std::vector<float> window;
+    std::vector<guint> bit_reverse;
+    std::vector<float> cos_table;
+    std::vector<float> sin_table;
+    std::vector<float> real;
+    std::vector<float> imag;
+    std::vector<float> magnitudes;
+
+    Priv(guint size)
+        : size(size)
+        , window(size)
+        , bit_reverse(size)
+        , cos_table(size / 2)
+        , sin_table(size / 2)
+        , real(size)
+        , imag(size)
+        , magnitudes(size / 2 + 1)
+    {
+        g_assert((size & (size - 1)) == 0);
+
+        for (guint i = 0; i < size; ++i)
+            window[i] = 0.5f - 0.5f * std::cos(2 * G_PI * i / size);
+
+        guint bits = 0;
+        while ((1u << bits) < size)
+            ++bits;
+        for (guint i = 0; i < size; ++i) {
+            guint reversed = 0;
+            for (guint b = 0; b < bits; ++b)
+                reversed |= ((i >> b) & 1) << (bits - 1 - b);
+            bit_reverse[i] = reversed;
+        }
+
+        for (guint i = 0; i < size / 2; ++i) {
+            cos_table[i] = std::cos(2 * G_PI * i / size);
+            sin_table[i] = -std::sin(2 * G_PI * i / size);
+        }
+    }
+
+    // iterative radix-2 decimation in time
+    void transform()
+    {
+        for (guint len = 2; len <= size; len <<= 1) {
+            guint half = len / 2;
+            guint step = size / len;
+            for (guint i = 0; i < size; i += len) {
+                for (guint j = 0; j < half; ++j) {
+                    float wr = cos_table[j * step];
+                    float wi = sin_table[j * step];
+                    guint a = i + j;
+                    guint b = a + half;
+                    float tr = real[b] * wr - imag[b] * wi;
+                    float ti = real[b] * wi + imag[b] * wr;
+                    real[b] = real[a] - tr;
+                    imag[b] = imag[a] - ti;
+                    real[a] += tr;
+                    imag[a] += ti;
+                }
+            }
+        }
+    }
+};
+
+Spectrum::Spectrum(guint size)
+    : m_priv(new Priv(size))
+{
+}
+
+guint Spectrum::size() const
+{
+    return m_priv->size;
+}
+
+guint Spectrum::bins() const
+{
+    return m_priv->size / 2 + 1;
+}
+
+double Spectrum::bin_frequency(guint bin, guint size, int rate)
+{
+    return static_cast<double>(bin) * rate / size;
+}
+
+const float* Spectrum::compute(const float* frame)
+{
+    Priv* p = m_priv.get();
+    const guint n = p->size;
+    const float* window = &p->window[0];
+    float* real = &p->real[0];
+    float* imag = &p->imag[0];
+    const guint* reverse = &p->bit_reverse[0];
+
+    for (guint i = 0; i < n; ++i) {
+        real[reverse[i]] = frame[i] * window[i];
+        imag[i] = 0;
+    }
+    p->transform();
+
+    float* magnitudes = &p->magnitudes[0];
+    const guint bins = n / 2 + 1;
+    const float scale = 2.0f / n;
+    for (guint i = 0; i < bins; ++i)
+        magnitudes[i] = std::sqrt(real[i] * real[i] + imag[i] * imag[i]) * scale;
+    return magnitudes;
+}
+}
@@ -0,0 +1,53 @@
+/*
+ * spectrum.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPECTRUM_H
+#define _SPECTRUM_H
+
+#include <glib.h>
+#include <tr1/memory>
+
+namespace SC {
+// Magnitude spectrum of fixed size, Hann-windowed frames. The inner loops
+// are plain loops over contiguous float arrays so that the compiler can
+// vectorize them (libcore is built with -ftree-vectorize where available).
+// Sums stay scalar, since that would need -ffast-math.
+class Spectrum {
+public:
+    // @size must be a power of two
+    explicit Spectrum(guint size);
+
+    guint size() const;
+    // number of magnitude bins, size / 2 + 1
+    guint bins() const;
+    // center frequency of @bin for audio at @rate
+    static double bin_frequency(guint bin, guint size, int rate);
+
+    // Computes the magnitudes of @frame, which holds size() samples. The
+    // result stays valid until the next call.
+    const float* compute(const float* frame);
+
+private:
+    struct Priv;
+    std::tr1::shared_ptr<Priv> m_priv;
+};
+}
+
+#endif /* _SPECTRUM_H */
@@ -0,0 +1,131 @@
+/*
+ * startup-trace.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <giomm.h>
+#include <vector>
+
+#include "startup-trace.h"
+
+namespace SC {
+
+struct TracePhase {
+    std::string name;
+    gint64 start;
+    gint64 end;
+
+    TracePhase(const std::string& name, gint64 start)
+        : name(name)
+        , start(start)
+        , end(-1)
+    {
+    }
+};
+
+static gint64 trace_origin = -1;
+static gint64 trace_complete = -1;
+static std::vector<TracePhase> trace_phases;
+
+static gint64 trace_now()
+{
+    gint64 now = g_get_monotonic_time();
+    if (trace_origin < 0)
+        trace_origin = now;
+    return now - trace_origin;
+}
+
+void startup_trace_begin(const char* phase)
+{
+    if (trace_complete >= 0)
+        return;
+    trace_phases.push_back(TracePhase(phase, trace_now()));
+}
+
+void startup_trace_end(const char* phase)
+{
+    if (trace_complete >= 0)
+        return;
+    gint64 now = trace_now();
+    for (std::vector<TracePhase>::reverse_iterator it = trace_phases.rbegin(); it != trace_phases.rend(); ++it) {
+        if (it->end < 0 && it->name == phase) {
+            it->end = now;
+            return;
+        }
+    }
+    g_warning("Startup phase '%s' ended without being started", phase);
+}
+
+void startup_trace_complete()
+{
+    if (trace_complete >= 0)
+        return;
+    trace_complete = trace_now();
+    g_debug("Startup completed in %" G_GINT64_FORMAT "us", trace_complete);
+
+    startup_trace_write_default();
+    if (!Glib::getenv("SC_STARTUP_TRACE_QUIT").empty()) {
+        Glib::RefPtr<Gio::Application> app = Gio::Application::get_default();
+        if (app)
+            app->quit();
+    }
+}
+
+bool startup_trace_is_complete()
+{
+    return trace_complete >= 0;
+}
+
+std::string startup_trace_summary()
+{
+    Glib::KeyFile summary;
+    summary.set_boolean("startup", "complete", trace_complete >= 0);
+    if (trace_complete >= 0)
+        summary.set_int64("startup", "total", trace_complete);
+
+    for (std::vector<TracePhase>::const_iterator it = trace_phases.begin(); it != trace_phases.end(); ++it) {
+        Glib::ustring group = "phase " + it->name;
+        summary.set_int64(group, "start", it->start);
+        // phases that never finished are reported without a duration
+        if (it->end >= 0)
+            summary.set_int64(group, "duration", it->end - it->start);
+    }
+    return summary.to_data();
+}
+
+bool startup_trace_write(const std::string& path)
+{
+    try
+    {
+        Glib::file_set_contents(path, startup_trace_summary());
+    }
+    catch (const Glib::Error& error)
+    {
+        g_warning("Unable to write startup trace to %s: %s", path.c_str(), error.what().c_str());
+        return false;
+    }
+    return true;
+}
+
+void startup_trace_write_default()
+{
+    std::string path = Glib::getenv("SC_STARTUP_TRACE");
+    if (!path.empty())
+        startup_trace_write(path);
+}
+}
@@ -0,0 +1,49 @@
+/*
+ * startup-trace.h
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _STARTUP_TRACE_H
+#define _STARTUP_TRACE_H
+
+#include <glibmm.h>
+
+namespace SC {
+
+// Simple timing of the phases of application startup. Times are measured
+// from the first traced event with g_get_monotonic_time() and are only
+// recorded from the main thread.
+//
+// The summary is a GKeyFile with a [startup] group containing the total time
+// and a [phase NAME] group per phase, all in microseconds. It is written to
+// the file named by the SC_STARTUP_TRACE environment variable when startup
+// completes and again at exit. If SC_STARTUP_TRACE_QUIT is set, the default
+// application quits as soon as startup completes.
+void startup_trace_begin(const char* phase);
+void startup_trace_end(const char* phase);
+// records the end of startup, i.e. the first paint of the main view
+void startup_trace_complete();
+bool startup_trace_is_complete();
+
+std::string startup_trace_summary();
+bool startup_trace_write(const std::string& path);
+// writes the summary to the SC_STARTUP_TRACE file, if it is set
+void startup_trace_write_default();
+}
+
+#endif /* _STARTUP_TRACE_H */
@@ -0,0 +1,165 @@
+/*
+ * stats-view.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stats-view.h"
+#include "util.h"
+
+namespace SC {
+
+struct StatsColumns : public Gtk::TreeModel::ColumnRecord {
+    Gtk::TreeModelColumn<Glib::ustring> label;
+    Gtk::TreeModelColumn<Glib::ustring> location;
+    Gtk::TreeModelColumn<gint64> count;
+    Gtk::TreeModelColumn<Glib::ustring> total_duration;
+    Gtk::TreeModelColumn<int> best_quality;
+    Gtk::TreeModelColumn<Glib::ustring> date_range;
+
+    StatsColumns()
+    {
+        add(label);
+        add(location);
+        add(count);
+        add(total_duration);
+        add(best_quality);
+        add(date_range);
+    }
+};
+
+// dates are stored as ISO 8601 strings, only show the date part
+static Glib::ustring format_date(const Glib::ustring& date)
+{
+    return date.substr(0, 10);
+}
+
+static Glib::ustring format_date_range(const StatsEntry& entry)
+{
+    if (entry.first_date.empty())
+        return Glib::ustring();
+    Glib::ustring first = format_date(entry.first_date);
+    Glib::ustring last = format_date(entry.last_date);
+    if (first == last)
+        return first;
+    return Glib::ustring::compose("%1 – %2", first, last);
+}
+
+struct StatsView::Priv {
+    std::tr1::shared_ptr<Repository> repository;
+    StatsColumns columns;
+    Glib::RefPtr<Gtk::ListStore> store;
+    Gtk::ComboBoxText grouping;
+    Gtk::ScrolledWindow scroller;
+    Gtk::TreeView tree_view;
+    Gtk::TreeViewColumn* location_column;
+    bool dirty;
+
+    Priv(const std::tr1::shared_ptr<Repository>& repository)
+        : repository(repository)
+        , store(Gtk::ListStore::create(columns))
+        , tree_view(store)
+        , location_column(0)
+        , dirty(true)
+    {
+        grouping.append("By Species");
+        grouping.append("By Location");
+        grouping.append("By Recordist");
+        grouping.set_active(STATS_BY_SPECIES);
+        grouping.signal_changed().connect(sigc::mem_fun(this, &Priv::refresh));
+        grouping.show();
+
+        tree_view.append_column("Name", columns.label);
+        tree_view.append_column("Location", columns.location);
+        location_column = tree_view.get_column(1);
+        tree_view.append_column("Recordings", columns.count);
+        tree_view.append_column("Total Duration", columns.total_duration);
+        tree_view.append_column("Best Quality", columns.best_quality);
+        tree_view.append_column("Dates", columns.date_range);
+        tree_view.show();
+        scroller.add(tree_view);
+        scroller.show();
+
+        repository->signal_database_changed().connect(
+            sigc::mem_fun(this, &Priv::on_database_changed));
+        repository->signal_resources_changed().connect(
+            sigc::hide(sigc::mem_fun(this, &Priv::on_database_changed)));
+    }
+
+    void on_database_changed()
+    {
+        dirty = true;
+        if (tree_view.get_mapped())
+            refresh();
+    }
+
+    void on_map()
+    {
+        if (dirty)
+            refresh();
+    }
+
+    void refresh()
+    {
+        dirty = false;
+        StatsGrouping g = static_cast<StatsGrouping>(grouping.get_active_row_number());
+        location_column->set_visible(g == STATS_BY_SPECIES);
+        repository->get_stats_async(g, sigc::bind(sigc::mem_fun(this, &Priv::got_stats), g));
+    }
+
+    void got_stats(const Glib::RefPtr<Gio::AsyncResult>& result, StatsGrouping g)
+    {
+        StatsVector stats;
+        try
+        {
+            stats = repository->get_stats_finish(result);
+        }
+        catch (const Glib::Error& error)
+        {
+            g_warning("Unable to get statistics: %s", error.what().c_str());
+            return;
+        }
+
+        // the grouping was changed while this query was in flight
+        if (g != grouping.get_active_row_number())
+            return;
+
+        store->clear();
+        for (StatsVector::const_iterator it = stats.begin(); it != stats.end(); ++it) {
+            Gtk::TreeModel::Row row = *store->append();
+            row[columns.label] = it->label;
+            row[columns.location] = it->location_label;
+            row[columns.count] = it->count;
+            row[columns.total_duration] = format_duration(it->total_duration);
+            row[columns.best_quality] = it->best_quality;
+            row[columns.date_range] = format_date_range(*it);
+        }
+    }
+};
+
+StatsView::StatsView(const std::tr1::shared_ptr<Repository>& repository)
+    : Gtk::Box(Gtk::ORIENTATION_VERTICAL)
+    , m_priv(new Priv(repository))
+{
+    Gtk::Alignment* align = Gtk::manage(new Gtk::Alignment(Gtk::ALIGN_START));
+    align->show();
+    align->add(m_priv->grouping);
+    pack_start(*align, false, true, 6);
+    pack_start(m_priv->scroller, true, true);
+    m_priv->tree_view.signal_map().connect(sigc::mem_fun(m_priv.get(), &Priv::on_map));
+}
+}
@@ -58,4 +58,8 @@ Task::Task(const Gio::SlotAsyncReady& slot)
     : m_priv(new Priv(this, slot))
 {
 }
+
+Task::~Task()
+{
+}
 }
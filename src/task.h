@@ -26,8 +26,12 @@
 
 namespace SC {
 
+// The GTask owns the Task and deletes it through this base class, so
+// subclasses can keep whatever state the operation needs in members.
 class Task {
 public:
+    virtual ~Task();
+
     GTask* task();
 
 protected:
@@ -18,28 +18,29 @@
  * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <iomanip>
-
 #include "util.h"
 
 namespace SC {
 
 Glib::ustring format_duration(double seconds)
+{
+    char buffer[DURATION_BUFFER_SIZE];
+    return format_duration(seconds, buffer, sizeof(buffer));
+}
+
+const char* format_duration(double seconds, char* buffer, gsize size)
 {
     int h = 0, m = 0, s = 0;
 
     h = seconds / (60 * 60);
     m = (seconds - (h * 60 * 60)) / 60;
     s = seconds - (h * 60 * 60) - (m * 60);
-    Glib::ustring formatted;
 
     if (h)
-        formatted += Glib::ustring::compose("%1",
-                                            Glib::ustring::format(std::setfill(L'0'), std::setw(2), h));
-    formatted += Glib::ustring::compose("%1:%2",
-                                        Glib::ustring::format(std::setfill(L'0'), std::setw(h ? 2 : 1), m),
-                                        Glib::ustring::format(std::setfill(L'0'), std::setw(2), s));
+        g_snprintf(buffer, size, "%02d%02d:%02d", h, m, s);
+    else
+        g_snprintf(buffer, size, "%d:%02d", m, s);
 
-    return formatted;
+    return buffer;
 }
 }
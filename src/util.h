@@ -26,6 +26,10 @@
 namespace SC {
 
 Glib::ustring format_duration(double seconds);
+// Formats @seconds like the function above into @buffer, which should hold
+// at least DURATION_BUFFER_SIZE bytes, without allocating.  Returns @buffer.
+static const gsize DURATION_BUFFER_SIZE = 32;
+const char* format_duration(double seconds, char* buffer, gsize size);
 }
 
 #endif /* _UTIL_H */
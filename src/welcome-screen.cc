@@ -18,33 +18,83 @@
  * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "lazy-page.h"
 #include "location-list.h"
 #include "recording-list.h"
+#include "stats-view.h"
 #include "welcome-screen.h"
 
 namespace SC {
 
-struct WelcomeScreen::Priv {
+template <typename T>
+static Gtk::Widget* create_page(std::tr1::shared_ptr<Repository> repository)
+{
+    return Gtk::manage(new T(repository));
+}
+
+struct WelcomeScreen::Priv : public sigc::trackable {
     std::tr1::shared_ptr<Repository> repository;
     Gtk::Stack stack;
     Gtk::StackSwitcher switcher;
-    RecordingList recordings;
-    LocationList locations;
+    LazyPage recordings;
+    LazyPage locations;
+    LazyPage statistics;
+    sigc::connection prefetch_connection;
 
     Priv(const std::tr1::shared_ptr<Repository>& repository)
         : repository(repository)
-        , recordings(repository)
-        , locations(repository)
+        , recordings(sigc::mem_fun(*this, &Priv::create_recording_list))
+        , locations(sigc::bind(sigc::ptr_fun(&create_page<LocationList>), repository))
+        , statistics(sigc::bind(sigc::ptr_fun(&create_page<StatsView>), repository))
     {
         switcher.set_stack(stack);
 
         locations.show();
         recordings.show();
+        statistics.show();
 
         stack.add(recordings, "recordings", "Recordings");
         stack.add(locations, "locations", "Locations");
+        stack.add(statistics, "statistics", "Statistics");
 
         stack.set_visible_child("recordings");
+        // its queries go first
+        recordings.ensure_built();
+    }
+
+    // The other pages are built when they're first shown, or once the
+    // recording list shows its first rows, so that their queries don't
+    // compete with that of the visible page
+    Gtk::Widget* create_recording_list()
+    {
+        RecordingList* list = Gtk::manage(new RecordingList(repository));
+        list->signal_rows_shown().connect(sigc::mem_fun(this, &Priv::start_prefetch));
+        return list;
+    }
+
+    void start_prefetch()
+    {
+        prefetch_connection = Glib::signal_idle().connect(
+            sigc::mem_fun(this, &Priv::prefetch_next), Glib::PRIORITY_LOW);
+    }
+
+    // builds one page per idle callback, so that the main loop gets to run
+    // in between
+    bool prefetch_next()
+    {
+        LazyPage* pages[] = { &locations, &statistics };
+        for (guint i = 0; i < G_N_ELEMENTS(pages); ++i) {
+            if (!pages[i]->is_built()) {
+                pages[i]->ensure_built();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ~Priv()
+    {
+        prefetch_connection.disconnect();
     }
 };
 
@@ -0,0 +1,161 @@
+/*
+ * bench-startup.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Launches sound-collection against a fresh collection, waits for it to
+// report that startup completed and compares each traced phase against the
+// budgets in a key file, e.g.
+//
+//   [budget]
+//   total=2000000
+//   adapter-open=200000
+//
+// All values are in microseconds. The collection is opened twice so that
+// both the first start (which creates the schema) and a regular start are
+// measured; a regular start must not need a migration.
+
+#include <cerrno>
+#include <glib/gstdio.h>
+#include <glibmm.h>
+#include <iostream>
+
+#include "bench-util.h"
+
+// Returns the startup trace of the run, or NULL if the program failed or the
+// trace could not be read
+static Glib::KeyFile* run_once(const std::string& program,
+                               const std::string& collection,
+                               const std::string& trace)
+{
+    std::vector<std::string> argv;
+    argv.push_back(program);
+    std::vector<std::string> envp = Glib::listenv();
+    for (std::vector<std::string>::iterator it = envp.begin(); it != envp.end(); ++it)
+        *it = *it + "=" + Glib::getenv(*it);
+    envp.push_back("COLLECTION_BASE=" + collection);
+    envp.push_back("SC_STARTUP_TRACE=" + trace);
+    envp.push_back("SC_STARTUP_TRACE_QUIT=1");
+
+    // a trace left from the previous run would otherwise pass for this one's
+    if (g_remove(trace.c_str()) != 0 && errno != ENOENT) {
+        std::cout << "Unable to remove the old startup trace " << trace << ": " << g_strerror(errno) << std::endl;
+        return 0;
+    }
+
+    int status = 0;
+    Glib::spawn_sync(Glib::get_current_dir(), argv, envp, Glib::SpawnFlags(0), sigc::slot<void>(), 0, 0, &status);
+    if (status != 0) {
+        std::cout << program << " exited with status " << status << std::endl;
+        return 0;
+    }
+
+    Glib::KeyFile* summary = new Glib::KeyFile();
+    try
+    {
+        summary->load_from_file(trace);
+    }
+    catch (const Glib::Error& error)
+    {
+        std::cout << "Unable to read the startup trace " << trace << ": " << error.what() << std::endl;
+        delete summary;
+        return 0;
+    }
+    return summary;
+}
+
+static int check_budget(const Glib::ustring& label,
+                        Glib::KeyFile* summary,
+                        Glib::KeyFile& budget)
+{
+    int failures = 0;
+    if (!summary) {
+        std::cout << label << ": failed" << std::endl;
+        return 1;
+    }
+    if (!summary->has_key("startup", "complete") || !summary->get_boolean("startup", "complete")) {
+        std::cout << label << ": startup did not complete" << std::endl;
+        return 1;
+    }
+
+    std::vector<Glib::ustring> phases = budget.get_keys("budget");
+    for (std::vector<Glib::ustring>::const_iterator it = phases.begin(); it != phases.end(); ++it) {
+        gint64 allowed = budget.get_int64("budget", *it);
+        gint64 spent = 0;
+        if (*it == "total")
+            spent = summary->get_int64("startup", "total");
+        else if (summary->has_group("phase " + *it) && summary->has_key("phase " + *it, "duration"))
+            spent = summary->get_int64("phase " + *it, "duration");
+        else
+            continue;
+
+        bool ok = spent <= allowed;
+        std::cout << label << ": " << *it << " " << spent << "us (budget " << allowed << "us)"
+                  << (ok ? "" : " OVER BUDGET") << std::endl;
+        if (!ok)
+            failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " BUDGET-FILE SOUND-COLLECTION-BINARY" << std::endl;
+        return 2;
+    }
+
+    Glib::init();
+    Glib::KeyFile budget;
+    try
+    {
+        budget.load_from_file(argv[1]);
+    }
+    catch (const Glib::Error& error)
+    {
+        std::cerr << "Unable to read " << argv[1] << ": " << error.what() << std::endl;
+        return 2;
+    }
+
+    gchar* tmpdir = g_mkdtemp(g_build_filename(g_get_tmp_dir(), "bench-startup-XXXXXX", NULL));
+    if (!tmpdir) {
+        std::cerr << "Unable to create a temporary directory" << std::endl;
+        return 2;
+    }
+    std::string dir(tmpdir);
+    g_free(tmpdir);
+    std::string collection = Glib::build_filename(dir, "collection");
+    std::string trace = Glib::build_filename(dir, "trace.ini");
+
+    int failures = 0;
+    Glib::KeyFile* first = run_once(argv[2], collection, trace);
+    failures += check_budget("first start", first, budget);
+    delete first;
+
+    Glib::KeyFile* second = run_once(argv[2], collection, trace);
+    failures += check_budget("second start", second, budget);
+    if (second && second->has_group("phase migration")) {
+        std::cout << "second start: schema was migrated again" << std::endl;
+        failures++;
+    }
+    delete second;
+
+    remove_tree(dir);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * bench-tree-model.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Measures what drawing the recording list costs per cell. A temporary
+// collection is filled with synthetic recordings, then the list is "scrolled"
+// through from top to bottom a screenful at a time, the way a fast scroll
+// requests the rows, and every cell of every screen is read both through
+// gtk_tree_model_get_value() and through the accessors that the cell data
+// functions use, e.g.
+//
+//   bench-tree-model 200000
+//
+// Only the cell reads are timed; waiting for pages to be fetched isn't.
+
+#include <cstdlib>
+#include <gom/gom.h>
+#include <gtkmm.h>
+#include <iostream>
+
+#include "bench-util.h"
+#include "recording-tree-model.h"
+#include "repository.h"
+
+static const guint VISIBLE_ROWS = 40;
+// values read_accessors() reads per row
+static const guint ACCESSOR_READS = 7;
+// a screen whose pages haven't arrived by then counts as a failed fetch
+static const gint64 PAGE_TIMEOUT = 10 * G_USEC_PER_SEC;
+
+static void fill_proxy(GomAdapter* adapter, gpointer user_data)
+{
+    guint count = GPOINTER_TO_UINT(user_data);
+    GError* error = 0;
+    std::string sql = Glib::ustring::compose(
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < %1) "
+        "INSERT INTO recordings (file, duration, quality, peak, loudness, \"clipped-samples\") "
+        "SELECT '/collection/audio/recording-' || i || '.flac', i % 600, i % 6, "
+        "-(i % 20), -20 - (i % 30), i % 3 FROM n",
+        count);
+    if (!gom_adapter_execute_sql(adapter, sql.c_str(), &error)) {
+        g_error("Unable to fill the collection: %s", error->message);
+        g_clear_error(&error);
+    }
+}
+
+static void set_true(bool& flag)
+{
+    flag = true;
+}
+
+static void store_result(const Glib::RefPtr<Gio::AsyncResult>& result,
+                         Glib::RefPtr<Gio::AsyncResult>& out)
+{
+    out = result;
+}
+
+// reads every cell of @rows rows from @first, returns the time spent in µs
+static gint64 read_values(const Glib::RefPtr<SC::RecordingTreeModel>& model, guint first, guint rows)
+{
+    int columns = model->get_n_columns();
+    gint64 start = g_get_monotonic_time();
+    for (guint i = first; i < first + rows; ++i) {
+        Gtk::TreeModel::Path path;
+        path.push_back(i);
+        Gtk::TreeModel::iterator iter = model->get_iter(path);
+        for (int column = 0; column < columns; ++column) {
+            GValue value = G_VALUE_INIT;
+            gtk_tree_model_get_value(GTK_TREE_MODEL(model->gobj()), iter.gobj(), column, &value);
+            g_value_unset(&value);
+        }
+    }
+    return g_get_monotonic_time() - start;
+}
+
+static gint64 read_accessors(const Glib::RefPtr<SC::RecordingTreeModel>& model, guint first, guint rows)
+{
+    // keeps the compiler from dropping the reads
+    volatile double sink = 0;
+    gint64 start = g_get_monotonic_time();
+    for (guint i = first; i < first + rows; ++i) {
+        Gtk::TreeModel::Path path;
+        path.push_back(i);
+        Gtk::TreeModel::iterator iter = model->get_iter(path);
+        sink = sink + model->get_id(iter) + model->get_duration(iter) + model->get_quality(iter)
+            + model->get_peak(iter) + model->get_loudness(iter) + model->get_clipped_samples(iter)
+            + (model->get_file(iter) ? 1 : 0);
+    }
+    return g_get_monotonic_time() - start;
+}
+
+int main(int argc, char* argv[])
+{
+    guint count = argc > 1 ? atoi(argv[1]) : 100000;
+    Glib::init();
+    Gio::init();
+    Gtk::Main::init_gtkmm_internals();
+
+    gchar* tmpdir = g_mkdtemp(g_build_filename(g_get_tmp_dir(), "bench-tree-model-XXXXXX", NULL));
+    if (!tmpdir) {
+        std::cerr << "Unable to create a temporary directory" << std::endl;
+        return 2;
+    }
+    std::string dir(tmpdir);
+    g_free(tmpdir);
+
+    GomAdapter* adapter = gom_adapter_new();
+    GError* error = 0;
+    std::string uri = Glib::filename_to_uri(Glib::build_filename(dir, "bench.sqlite"));
+    if (!gom_adapter_open_sync(adapter, uri.c_str(), &error)) {
+        std::cerr << "Unable to open adapter: " << error->message << std::endl;
+        g_clear_error(&error);
+        return 2;
+    }
+
+    SC::Repository repository(adapter, dir);
+    bool ready = false;
+    repository.run_when_ready(sigc::bind(sigc::ptr_fun(&set_true), sigc::ref(ready)));
+    while (!ready)
+        g_main_context_iteration(NULL, TRUE);
+
+    gint64 start = g_get_monotonic_time();
+    gom_adapter_queue_write(adapter, fill_proxy, GUINT_TO_POINTER(count));
+    // the read queue runs after the write in the same thread
+    std::tr1::shared_ptr<SC::KeysetPager> pager = SC::RecordingTreeModel::create_pager(repository.cobj());
+    Glib::RefPtr<Gio::AsyncResult> result;
+    pager->build_async(sigc::bind(sigc::ptr_fun(&store_result), sigc::ref(result)));
+    while (!result)
+        g_main_context_iteration(NULL, TRUE);
+    pager->build_finish(result);
+    std::cout << count << " recordings inserted in " << (g_get_monotonic_time() - start) / 1000 << "ms" << std::endl;
+
+    Glib::RefPtr<SC::RecordingTreeModel> model = SC::RecordingTreeModel::create();
+    model->set_pager(pager);
+
+    gint64 value_time = 0;
+    gint64 accessor_time = 0;
+    guint rows = 0;
+    start = g_get_monotonic_time();
+    for (guint first = 0; first + VISIBLE_ROWS <= pager->count(); first += VISIBLE_ROWS) {
+        // the first read requests the pages of the screen
+        read_values(model, first, VISIBLE_ROWS);
+        gint64 deadline = g_get_monotonic_time() + PAGE_TIMEOUT;
+        while (!pager->peek_row(first) || !pager->peek_row(first + VISIBLE_ROWS - 1)) {
+            if (g_get_monotonic_time() > deadline) {
+                std::cerr << "Rows " << first << " to " << first + VISIBLE_ROWS - 1
+                          << " were not loaded" << std::endl;
+                gom_adapter_close_sync(adapter, NULL);
+                g_object_unref(adapter);
+                remove_tree(dir);
+                return 1;
+            }
+            if (!g_main_context_iteration(NULL, FALSE))
+                g_usleep(1000);
+        }
+
+        value_time += read_values(model, first, VISIBLE_ROWS);
+        accessor_time += read_accessors(model, first, VISIBLE_ROWS);
+        rows += VISIBLE_ROWS;
+    }
+    gint64 total = g_get_monotonic_time() - start;
+
+    guint value_cells = rows * model->get_n_columns();
+    guint accessor_cells = rows * ACCESSOR_READS;
+    std::cout << "scrolled through " << rows << " rows in " << total / 1000 << "ms, "
+              << pager->memory_used() / 1024 << "KiB of rows resident" << std::endl;
+    if (rows) {
+        std::cout << "get_value: " << value_time * 1000.0 / value_cells << "ns per cell" << std::endl;
+        std::cout << "accessors: " << accessor_time * 1000.0 / accessor_cells << "ns per cell" << std::endl;
+    }
+
+    gom_adapter_close_sync(adapter, NULL);
+    g_object_unref(adapter);
+    remove_tree(dir);
+    return 0;
+}
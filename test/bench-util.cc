@@ -0,0 +1,52 @@
+/*
+ * bench-util.cc
+ * This file is part of SoundCollection
+ *
+ * Copyright (C) 2014 - Jonathon Jongsma
+ *
+ * SoundCollection is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SoundCollection is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SoundCollection. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <glib/gstdio.h>
+#include <glibmm.h>
+#include <vector>
+
+#include "bench-util.h"
+
+bool remove_tree(const std::string& path)
+{
+    if (Glib::file_test(path, Glib::FILE_TEST_IS_DIR) && !Glib::file_test(path, Glib::FILE_TEST_IS_SYMLINK)) {
+        std::vector<std::string> children;
+        try
+        {
+            Glib::Dir dir(path);
+            children.assign(dir.begin(), dir.end());
+        }
+        catch (const Glib::FileError& error)
+        {
+            g_warning("Unable to list %s: %s", path.c_str(), error.what().c_str());
+            return false;
+        }
+        for (std::vector<std::string>::const_iterator it = children.begin(); it != children.end(); ++it) {
+            if (!remove_tree(Glib::build_filename(path, *it)))
+                return false;
+        }
+    }
+    if (g_remove(path.c_str()) != 0) {
+        g_warning("Unable to remove %s: %s", path.c_str(), g_strerror(errno));
+        return false;
+    }
+    return true;
+}